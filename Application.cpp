@@ -11,12 +11,48 @@ const std::vector<const char*> deviceExtensions =
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+const std::vector<Vertex> defaultVertices =
+{
+	// Triangle
+	{ { 0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+	{ { 0.5f, 0.5f }, { 0.0f, 1.0f, 0.0f } },
+	{ { -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } },
+	// Quad
+	{ { -0.5f, -0.5f }, { 1.0f, 1.0f, 0.0f } },
+	{ { 0.5f, -0.5f }, { 0.0f, 1.0f, 1.0f } },
+	{ { 0.5f, 0.5f }, { 1.0f, 0.0f, 1.0f } },
+	{ { -0.5f, 0.5f }, { 1.0f, 1.0f, 1.0f } }
+};
+
+const std::vector<uint32_t> defaultIndices = { 0, 1, 2, 0, 1, 2, 2, 3, 0 };
+
+const std::vector<MeshRange> defaultMeshes =
+{
+	{ 0, 3, 0 },
+	{ 3, 6, 3 }
+};
+
+// Below this many draws per secondary command buffer the handoff to a worker costs more than it saves
+const uint32_t MIN_DRAWS_PER_JOB = 256;
+
+// Ticks further behind than this are dropped rather than simulated back to back
+const int64_t MAX_CATCH_UP_TICKS = 4;
+
+static bool anyWindowClosing(const std::vector<std::unique_ptr<Window>>& windows)
+{
+	return std::any_of(windows.begin(), windows.end(), [](const auto& window) { return window->shouldClose(); });
+}
+
+static bool allWindowsMinimized(const std::vector<std::unique_ptr<Window>>& windows)
+{
+	return std::all_of(windows.begin(), windows.end(), [](const auto& window) { return window->minimized(); });
+}
 
-Application::Application(const std::string& name, int width, int height):
-	appName(name), windowWidth(width), windowHeight(height)
+Application::Application(const std::string& name, int width, int height, const AppOptions& options):
+	appName(name), windowWidth(width), windowHeight(height), options(options)
 {
-	setupWindow();
+	if (!options.headless)
+		setupWindow();
 	setupVulkan();
 }
 
@@ -27,92 +63,322 @@ Application::~Application()
 
 int Application::run()
 {
-	while (!shouldTerminate && !glfwWindowShouldClose(window))
+	if (options.headless)
+		return runHeadless();
+
+	// Closing any of the windows ends the run
+	if (options.renderThread)
 	{
-		mainLoop();
+		// GLFW has to stay on the main thread, so events and the simulation keep it and the frames move out
+		rendering = true;
+		renderer = std::thread([this]() { renderLoop(); });
+		simulationLoop();
+		rendering = false;
+		renderer.join();
+		if (renderError)
+			std::rethrow_exception(renderError);
+	}
+	else
+	{
+		while (!shouldTerminate && !anyWindowClosing(windows))
+			mainLoop();
 	}
 
 	device.waitIdle();
+	printRecordingReport();
+	printThreadReport();
+	printLatencyReport();
+	if (postProcessing)
+		postProcess.printStats(profiler);
+	exportProfile();
 	return 0;
 }
 
 void Application::setupWindow()
 {
 	glfwInit();
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-	window = glfwCreateWindow(windowWidth, windowHeight, appName.c_str(), nullptr, nullptr);
+
+	// A refresh of any window draws a frame for all of them. A render thread keeps drawing by itself.
+	auto refresh = [this]()
+	{
+		if (!options.renderThread && device && !frameCommands.empty() && !shouldTerminate)
+			drawFrame();
+	};
+
+	uint32_t count = std::max(1u, options.windowCount);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		auto window = std::make_unique<Window>();
+		window->create(i == 0 ? appName : appName + " (" + std::to_string(i + 1) + ")", windowWidth, windowHeight, refresh);
+		windows.push_back(std::move(window));
+	}
 }
 
 void Application::setupVulkan()
 {
+	startTime = std::chrono::steady_clock::now();
+
 	createInstance();
-	createSurface();
+	if (!options.headless)
+		createSurface();
 	selectPhysicalDevice();
 	createLogicalDevice();
-	createSwapchain();
-	createImageViews();
-	createRenderPass();
+	allocator.init(physicalDevice, device);
+	deletions.init(device, allocator);
+	profiler.init(device, physicalDevice, queueFamilies.graphics, options.framesInFlight, options.profiling);
+	pacer.init(&profiler, options.framePacing, options.pacingMarginMs);
+	pipelineCache.load(device, physicalDevice.getProperties(), options.pipelineCachePath);
+	shaders.init(device, options.shaderArchivePath, options.shaderDirectory);
+	pipelines.init(device, shaders, pipelineCache.handle(), options.compileThreads);
+	capturing = !options.captureDirectory.empty();
+	postProcessing = options.postProcess;
+	if (options.headless)
+		createOffscreenTargets();
+	else
+		createSwapchains();
+	if (capturing)
+		capture.init(device, allocator, deletions, options.framesInFlight, options.captureDirectory, options.captureFormat);
+	createRenderGraph();
+	createDescriptors();
+	// The pipelines take their vertex layout from the scene geometry
+	createSceneGeometry();
 	createGraphicsPipeline();
-	createFramebuffers();
 	createCommandPool();
+	createGeometryBuffers();
+	createTextures();
+	createInstanceCulling();
 	createCommandBuffers();
 	createSyncObjects();
+
+	// The first snapshot goes out before any frame, so the renderer always has one to draw
+	tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(1.0 / std::max(1.0, options.simulationRate)));
+	nextTick = std::chrono::steady_clock::now() + tickDuration;
+	snapshots.back() = simulation;
+	snapshots.publish();
+
+	auto setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	std::cout << "[Startup] Vulkan setup took " << setupMs << " ms, " << pipelines.pendingCount() << " of "
+		<< pipelines.variantCount() << " pipelines compiling in the background (" << pipelines.requestCount() << " requested)\n";
 }
 
 void Application::mainLoop()
 {
+	// Nothing can be presented to minimized windows, sleep until one comes back instead of spinning
+	if (allWindowsMinimized(windows))
+	{
+		glfwWaitEvents();
+		return;
+	}
+
+	pacer.waitForFrameStart();
 	glfwPollEvents();
+	updateSimulation();
 	drawFrame();
 }
 
-void Application::cleanUp()
+void Application::simulationLoop()
 {
-	for (auto& semaphore : renderFinishedSemaphores)
-		device.destroySemaphore(semaphore);
-	for (auto& semaphore : imageAvailableSemaphores)
-		device.destroySemaphore(semaphore);
-	for (auto& fence : inFlightFences)
-		device.destroyFence(fence);
+	// Sleeps in the event wait until the next tick is due, so input is still handled the moment it arrives
+	while (!shouldTerminate && !anyWindowClosing(windows))
+	{
+		double wait = std::chrono::duration<double>(nextTick - std::chrono::steady_clock::now()).count();
+		if (wait > 0.0)
+			glfwWaitEventsTimeout(wait);
+		else
+			glfwPollEvents();
+		updateSimulation();
+	}
+}
+
+void Application::renderLoop()
+{
+	try
+	{
+		while (rendering && !shouldTerminate)
+		{
+			// Events belong to the main thread, so minimized windows are polled for instead of waited on
+			if (allWindowsMinimized(windows))
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+
+			pacer.waitForFrameStart();
+			drawFrame();
+		}
+	}
+	catch (...)
+	{
+		renderError = std::current_exception();
+		shouldTerminate = true;
+		glfwPostEmptyEvent();
+	}
+}
 
-	device.destroyCommandPool(commandPool);
+int Application::runHeadless()
+{
+	cpuFrameSeconds = 0.0;
 
-	for (auto framebuffer : swapchainFramebuffers)
-		device.destroyFramebuffer(framebuffer);
+	recordedFrames = 0;
+	std::fill(recordSeconds.begin(), recordSeconds.end(), 0.0);
 
-	device.destroyPipeline(graphicsPipeline);
-	device.destroyPipelineLayout(pipelineLayout);
-	device.destroyRenderPass(renderPass);
+	// Measured frames should draw the full scene, not fallbacks
+	pipelines.waitAll();
 
-	for (auto imageView : swapchainImageViews)
-		device.destroyImageView(imageView);
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < options.headlessFrames; i++)
+	{
+		pacer.waitForFrameStart();
+		updateSimulation();
+		drawOffscreenFrame();
+		pacer.frameSubmitted();
+	}
+	device.waitIdle();
+	auto end = std::chrono::steady_clock::now();
+
+	profiler.resolveAll();
+
+	frameReport.frames = options.headlessFrames;
+	frameReport.seconds = std::chrono::duration<double>(end - start).count();
+	frameReport.framesPerSecond = frameReport.seconds > 0.0 ? frameReport.frames / frameReport.seconds : 0.0;
+	frameReport.cpuMsPerFrame = frameReport.frames ? cpuFrameSeconds * 1000.0 / frameReport.frames : 0.0;
+	frameReport.gpuMsPerFrame = profiler.averageGpuMs("frame");
+
+	double recordTotal = 0.0;
+	for (auto seconds : recordSeconds)
+		recordTotal += seconds;
+	uint32_t drawsPerFrame = (options.instanceCount > 0 ? options.instanceCount : options.drawCount) * static_cast<uint32_t>(targets.size());
+	frameReport.recordNsPerDraw = recordedFrames && drawsPerFrame ? recordTotal * 1e9 / (double(recordedFrames) * drawsPerFrame) : 0.0;
+	frameReport.submitMs = profiler.averageCpuMs(CpuPhase::Submit);
+	frameReport.presentMs = profiler.averageCpuMs(CpuPhase::Present);
+	frameReport.peakDeviceBytes = allocator.stats().peakReservedBytes;
+
+	std::cout << "[Headless] " << frameReport.frames << " frames at "
+		<< offscreenExtent.width << "x" << offscreenExtent.height << " in " << frameReport.seconds << " s\n"
+		<< "\t--FPS: " << frameReport.framesPerSecond << "\n"
+		<< "\t--CPU time per frame: " << frameReport.cpuMsPerFrame << " ms\n";
+	if (profiler.hasGpuTimings())
+		std::cout << "\t--GPU time per frame: " << frameReport.gpuMsPerFrame << " ms\n";
+	else
+		std::cout << "\t--GPU time per frame: unavailable (profiling disabled or no timestamp support)\n";
+	printRecordingReport();
+	printThreadReport();
+	printLatencyReport();
+	allocator.printStats();
+	textures.printStats();
+	graph.printStats();
+	if (postProcessing)
+		postProcess.printStats(profiler);
+	deletions.printStats();
+	exportProfile();
+	return 0;
+}
 
-	device.destroySwapchainKHR(swapchain);
-	device.destroy();
+void Application::cleanUp()
+{
+	// Normally idle already; not if the render thread failed with frames in flight
+	device.waitIdle();
+	workerPool.reset();
 
-	instance.destroySurfaceKHR(surface);
+	// Every device object goes through the queue, behind what frames retired, and is released by the one flush below
+	for (auto& fence : inFlightFences)
+		deletions.destroy(fence);
+	deletions.destroy(frameTimeline);
+	for (auto& frame : frameCommands)
+	{
+		deletions.destroy(frame.primaryPool);
+		for (auto& worker : frame.workers)
+			deletions.destroy(worker.pool);
+	}
+	for (auto& compute : computeCommands)
+	{
+		deletions.destroy(compute.pool);
+		deletions.destroy(compute.finished);
+	}
+
+	deletions.destroy(vertexBuffer);
+	deletions.destroy(indexBuffer);
+	deletions.free(vertexAllocation);
+	deletions.free(indexAllocation);
+	deletions.destroy(materialBuffer);
+	deletions.free(materialAllocation);
+	textures.destroy();
+	deletions.destroy(textureSampler);
+	if (capturing)
+	{
+		capture.destroy();
+		capture.printStats();
+	}
+	culler.destroy(deletions);
+	postProcess.destroy(deletions);
+	uploader.destroy(deletions);
+
+	graph.destroy();
+
+	pipelines.destroy(deletions);
+	pipelineCache.addCompileTime(pipelines.compileMs());
+	pipelineCache.printReport();
+	deletions.destroy(pipelineLayout);
+	frameDescriptors.destroy(deletions);
+	deletions.destroy(frameSetLayout);
+	frameConstants.destroy(deletions);
+	bindless.destroy();
+	pipelineCache.save();
+	pipelineCache.destroy(deletions);
+	shaders.destroy(deletions);
+	profiler.destroy(deletions);
+
+	for (auto imageView : offscreenImageViews)
+		deletions.destroy(imageView);
+	for (auto image : offscreenImages)
+		deletions.destroy(image);
+	for (auto& allocation : offscreenImageAllocations)
+		deletions.free(allocation);
+	for (auto& window : windows)
+		window->retire(deletions);
+	deletions.flush();
+
+	for (auto& window : windows)
+		window->destroy(instance);
+	allocator.destroy();
+	device.destroy();
 	instance.destroy();
 
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (!options.headless)
+		glfwTerminate();
 }
 
 void Application::createInstance()
 {
+	// Timeline semaphores are core in 1.2; older loaders still get a 1.0 instance. A 1.0 loader does not
+	// export vkEnumerateInstanceVersion at all, so it is looked up rather than called directly.
+	uint32_t loaderVersion = VK_API_VERSION_1_0;
+	auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+		vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+	if (enumerateInstanceVersion && enumerateInstanceVersion(&loaderVersion) != VK_SUCCESS)
+		loaderVersion = VK_API_VERSION_1_0;
+	instanceApiVersion = std::min(loaderVersion, static_cast<uint32_t>(VK_API_VERSION_1_2));
+
 	auto appInfo = vk::ApplicationInfo()
 		.setPApplicationName(appName.c_str())
 		.setApplicationVersion(1)
 		.setPEngineName("None")
 		.setEngineVersion(1)
-		.setApiVersion(VK_API_VERSION_1_0);
+		.setApiVersion(instanceApiVersion);
 
 	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	const char** glfwExtensions = nullptr;
 
-	std::cout << "[GLFW Vulkan Extentions]\n";
-	for (uint32_t i = 0; i < glfwExtensionCount; i++)
-		std::cout << "\t--" << glfwExtensions[i] << "\n";
-	std::cout << "\n";
+	if (!options.headless)
+	{
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		std::cout << "[GLFW Vulkan Extentions]\n";
+		for (uint32_t i = 0; i < glfwExtensionCount; i++)
+			std::cout << "\t--" << glfwExtensions[i] << "\n";
+		std::cout << "\n";
+	}
 
 	auto createInfo = vk::InstanceCreateInfo()
 		.setFlags(vk::InstanceCreateFlags())
@@ -134,28 +400,28 @@ void Application::createInstance()
 
 void Application::createSurface()
 {
-	if (glfwCreateWindowSurface((VkInstance)instance, window, nullptr, (VkSurfaceKHR*)&surface) != VK_SUCCESS)
-	{
-		throw std::runtime_error("[Error] Failed to create window surface");
-	}
+	for (auto& window : windows)
+		window->createSurface(instance);
 }
 
 void Application::selectPhysicalDevice()
 {
-	auto devices = instance.enumeratePhysicalDevices();
-	std::cout << "[Number of Physical Devices] " << devices.size() << "\n";
-
-	for (const auto& i : devices)
+	// Offscreen rendering needs no swapchain, so no device extension is required
+	std::vector<const char*> requiredExtensions;
+	if (!options.headless)
+		requiredExtensions = deviceExtensions;
+
+	// The configured preference wins over the environment
+	std::string preference = options.devicePreference;
+	if (preference.empty())
 	{
-		if (isDeviceAvailable(i))
-		{
-			physicalDevice = i;
-			break;
-		}
+		if (auto env = std::getenv("VKTRY_DEVICE"))
+			preference = env;
 	}
-	std::cout << "\n";
-	if (physicalDevice == VK_NULL_HANDLE)
-		throw std::runtime_error("[Error] Failed to find any available physical device");
+
+	// Only the first window's surface is checked, the others are verified against the chosen present family
+	DeviceSelector selector(instance, options.headless ? vk::SurfaceKHR() : windows[0]->surface(), requiredExtensions);
+	physicalDevice = selector.select(preference, options.deviceCachePath);
 }
 
 void Application::createLogicalDevice()
@@ -165,12 +431,16 @@ void Application::createLogicalDevice()
 	{
 		throw std::runtime_error("[Error] Failed to find any available queue family");
 	}
-	uint32_t graphicsFamily = queueFamilyIndices.value().first;
-	uint32_t presentFamily = queueFamilyIndices.value().second;
+	queueFamilies = queueFamilyIndices.value();
+	asyncCulling = options.instanceCount > 0 && queueFamilies.asyncCompute();
+
+	std::cout << "[Queues] graphics " << queueFamilies.graphics << ", present " << queueFamilies.present
+		<< ", compute " << queueFamilies.compute << (queueFamilies.asyncCompute() ? " (async)" : "")
+		<< ", transfer " << queueFamilies.transfer << (queueFamilies.dedicatedTransfer() ? " (dedicated)" : "") << "\n";
 
 	float queuePriority = 1.0f;
 
-	uint32_t uniqueQueueFamilies[] = { graphicsFamily, presentFamily };
+	std::set<uint32_t> uniqueQueueFamilies = { queueFamilies.graphics, queueFamilies.present, queueFamilies.compute, queueFamilies.transfer };
 	std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
 
 	for (auto queueFamily : uniqueQueueFamilies)
@@ -184,14 +454,46 @@ void Application::createLogicalDevice()
 
 	vk::PhysicalDeviceFeatures deviceFeatures;
 
+	apiVersion = std::min(instanceApiVersion, physicalDevice.getProperties().apiVersion);
+	if (apiVersion >= VK_API_VERSION_1_2)
+	{
+		auto supported = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>()
+			.get<vk::PhysicalDeviceVulkan12Features>();
+		features12.setTimelineSemaphore(supported.timelineSemaphore);
+		features12.setDrawIndirectCount(supported.drawIndirectCount);
+
+		// Everything the bindless set relies on, or it is not used at all
+		descriptorIndexingSupported = supported.runtimeDescriptorArray && supported.descriptorBindingPartiallyBound &&
+			supported.descriptorBindingUpdateUnusedWhilePending && supported.descriptorBindingStorageBufferUpdateAfterBind &&
+			supported.descriptorBindingSampledImageUpdateAfterBind;
+		features12.setRuntimeDescriptorArray(descriptorIndexingSupported)
+			.setDescriptorBindingPartiallyBound(descriptorIndexingSupported)
+			.setDescriptorBindingUpdateUnusedWhilePending(descriptorIndexingSupported)
+			.setDescriptorBindingStorageBufferUpdateAfterBind(descriptorIndexingSupported)
+			.setDescriptorBindingSampledImageUpdateAfterBind(descriptorIndexingSupported);
+	}
+	timelineSemaphoreSupported = features12.timelineSemaphore;
+
+	multiDrawIndirectSupported = physicalDevice.getFeatures().multiDrawIndirect;
+	deviceFeatures.setMultiDrawIndirect(multiDrawIndirectSupported);
+	// Compressed textures in formats the device lacks fail to load and keep showing the fallback
+	deviceFeatures.setTextureCompressionBC(physicalDevice.getFeatures().textureCompressionBC);
+	deviceFeatures.setTextureCompressionASTC_LDR(physicalDevice.getFeatures().textureCompressionASTC_LDR);
+
+	// Offscreen rendering needs no swapchain, so no device extension is required
+	uint32_t extensionCount = options.headless ? 0 : static_cast<uint32_t>(deviceExtensions.size());
+
 	auto createInfo = vk::DeviceCreateInfo()
 		.setPQueueCreateInfos(queueCreateInfos.data())
-		.setQueueCreateInfoCount(1)
+		.setQueueCreateInfoCount(static_cast<uint32_t>(queueCreateInfos.size()))
 		.setPEnabledFeatures(&deviceFeatures)
-		.setEnabledExtensionCount(static_cast<uint32_t>(deviceExtensions.size()))
+		.setEnabledExtensionCount(extensionCount)
 		.setPpEnabledExtensionNames(deviceExtensions.data())
 		.setEnabledLayerCount(static_cast<uint32_t>(validationLayers.size()))
 		.setPpEnabledLayerNames(validationLayers.data());
+	// Only chained when queried above, a 1.2 instance on an older device must not pass it
+	if (apiVersion >= VK_API_VERSION_1_2)
+		createInfo.setPNext(&features12);
 	try
 	{
 		device = physicalDevice.createDevice(createInfo);
@@ -202,70 +504,58 @@ void Application::createLogicalDevice()
 		shouldTerminate = true;
 	}
 
-	graphicsQueue = device.getQueue(graphicsFamily, 0);
-	presentQueue = device.getQueue(presentFamily, 0);
-}
-
-void Application::createSwapchain()
-{
-	auto capabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
-	auto formats = physicalDevice.getSurfaceFormatsKHR(surface);
-	auto presentModes = physicalDevice.getSurfacePresentModesKHR(surface);
-
-	auto surfaceFormat = selectSwapchainSurfaceFormat(formats);
-	auto presentMode = selectSwapchainPresentMode(presentModes);
-	auto extent = selectSwapchainExtent(capabilities);
-
-	uint32_t imageCount = capabilities.minImageCount + 1;
-	if (capabilities.maxImageCount > 0)
-		imageCount = std::min(imageCount, capabilities.maxImageCount);
-
-	auto indices = findQueueFamilies(physicalDevice);
-	uint32_t graphicsFamilyIndex = indices.value().first;
-	uint32_t presentFamilyIndex = indices.value().second;
-	uint32_t queueFamilyIndices[] = { graphicsFamilyIndex, presentFamilyIndex };
-	bool identical = (graphicsFamilyIndex == presentFamilyIndex);
-
-	auto createInfo = vk::SwapchainCreateInfoKHR()
-		.setSurface(surface)
-		.setMinImageCount(imageCount)
-		.setImageFormat(surfaceFormat.format)
-		.setImageColorSpace(surfaceFormat.colorSpace)
-		.setImageExtent(extent)
-		.setImageArrayLayers(1)
-		.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment)
-		.setImageSharingMode(identical ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent)
-		.setQueueFamilyIndexCount(identical ? 0 : 2)
-		.setPQueueFamilyIndices(identical ? nullptr : queueFamilyIndices)
-		.setPreTransform(capabilities.currentTransform)
-		.setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
-		.setPresentMode(presentMode)
-		.setClipped(VK_TRUE)
-		.setOldSwapchain(VK_NULL_HANDLE);
-	try
+	graphicsQueue = device.getQueue(queueFamilies.graphics, 0);
+	presentQueue = device.getQueue(queueFamilies.present, 0);
+	computeQueue = device.getQueue(queueFamilies.compute, 0);
+	transferQueue = device.getQueue(queueFamilies.transfer, 0);
+}
+
+void Application::createSwapchains()
+{
+	// Capturing copies the first window's image out, which needs transfer source usage, and post-processing
+	// copies its result in. Later windows have to match the first one's format, the scene passes share its pipelines.
+	for (size_t i = 0; i < windows.size(); i++)
 	{
-		swapchain = device.createSwapchainKHR(createInfo);
+		vk::ImageUsageFlags extraUsage;
+		if (i == 0 && capturing)
+			extraUsage = vk::ImageUsageFlagBits::eTransferSrc;
+		if (postProcessing)
+			extraUsage |= vk::ImageUsageFlagBits::eTransferDst;
+		windows[i]->init(physicalDevice, device, queueFamilies.graphics, queueFamilies.present, options.framesInFlight,
+			requestedPresentMode(), extraUsage, targetFormat);
+		targetFormat = windows[i]->format();
 	}
-	catch (const std::exception& e)
+
+	if (capturing && !(windows[0]->usage() & vk::ImageUsageFlagBits::eTransferSrc))
 	{
-		std::cout << "[Error] " << e.what() << "\n";
-		shouldTerminate = true;
-		return;
+		std::cout << "[Warning] Swapchain images cannot be copied from on this surface, capture disabled\n";
+		capturing = false;
 	}
+	for (const auto& window : windows)
+	{
+		if (postProcessing && !(window->usage() & vk::ImageUsageFlagBits::eTransferDst))
+		{
+			std::cout << "[Warning] Swapchain images cannot be copied into on this surface, post-processing disabled\n";
+			postProcessing = false;
+		}
+	}
+}
 
-	swapchainImageFormat = surfaceFormat.format;
-	swapchainExtent = extent;
-	swapchainImages = device.getSwapchainImagesKHR(swapchain);
+void Application::recreateSwapchain(Window& window)
+{
+	if (!window.recreate(deletions))
+		return;
+	// Retires the framebuffers of the replaced views; transients follow the largest window
+	graph.setExtent(renderExtent());
 }
 
-void Application::createImageViews()
+void Application::createOffscreenTargets()
 {
-	auto components = vk::ComponentMapping()
-		.setR(vk::ComponentSwizzle::eIdentity)
-		.setG(vk::ComponentSwizzle::eIdentity)
-		.setB(vk::ComponentSwizzle::eIdentity)
-		.setA(vk::ComponentSwizzle::eIdentity);
-	
+	targetFormat = vk::Format::eR8G8B8A8Unorm;
+	offscreenExtent = vk::Extent2D()
+		.setWidth(static_cast<uint32_t>(windowWidth))
+		.setHeight(static_cast<uint32_t>(windowHeight));
+
 	auto subresourceRange = vk::ImageSubresourceRange()
 		.setAspectMask(vk::ImageAspectFlagBits::eColor)
 		.setBaseMipLevel(0)
@@ -273,444 +563,1239 @@ void Application::createImageViews()
 		.setBaseArrayLayer(0)
 		.setLayerCount(1);
 
-	for (const auto& image : swapchainImages)
+	for (uint32_t i = 0; i < options.framesInFlight; i++)
 	{
-		auto createInfo = vk::ImageViewCreateInfo()
+		auto imageInfo = vk::ImageCreateInfo()
+			.setImageType(vk::ImageType::e2D)
+			.setFormat(targetFormat)
+			.setExtent(vk::Extent3D(offscreenExtent.width, offscreenExtent.height, 1))
+			.setMipLevels(1)
+			.setArrayLayers(1)
+			.setSamples(vk::SampleCountFlagBits::e1)
+			.setTiling(vk::ImageTiling::eOptimal)
+			.setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst)
+			.setSharingMode(vk::SharingMode::eExclusive)
+			.setInitialLayout(vk::ImageLayout::eUndefined);
+
+		auto image = device.createImage(imageInfo);
+		offscreenImages.push_back(image);
+		offscreenImageAllocations.push_back(allocator.allocateImage(image, vk::MemoryPropertyFlagBits::eDeviceLocal));
+
+		auto viewInfo = vk::ImageViewCreateInfo()
 			.setImage(image)
 			.setViewType(vk::ImageViewType::e2D)
-			.setFormat(swapchainImageFormat)
-			.setComponents(components)
+			.setFormat(targetFormat)
 			.setSubresourceRange(subresourceRange);
 
-		auto imageView = device.createImageView(createInfo);
-		swapchainImageViews.push_back(imageView);
+		offscreenImageViews.push_back(device.createImageView(viewInfo));
 	}
 }
 
-void Application::createRenderPass()
+void Application::createRenderGraph()
 {
-	auto colorAttachment = vk::AttachmentDescription()
-		.setFormat(swapchainImageFormat)
-		.setSamples(vk::SampleCountFlagBits::e1)
-		.setLoadOp(vk::AttachmentLoadOp::eClear)
-		.setStoreOp(vk::AttachmentStoreOp::eStore)
-		.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
-		.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-		.setInitialLayout(vk::ImageLayout::eUndefined)
-		.setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+	graph.init(device, allocator, deletions);
+	graph.setProfiler(&profiler);
+	// The output stage blits the tonemapped image into the targets
+	if (postProcessing)
+	{
+		auto hdrFeatures = physicalDevice.getFormatProperties(PostProcess::HDR_FORMAT).optimalTilingFeatures;
+		auto targetFeatures = physicalDevice.getFormatProperties(targetFormat).optimalTilingFeatures;
+		if (!(hdrFeatures & vk::FormatFeatureFlagBits::eBlitSrc) || !(targetFeatures & vk::FormatFeatureFlagBits::eBlitDst))
+		{
+			std::cout << "[Warning] " << vk::to_string(targetFormat) << " cannot be blitted into from "
+				<< vk::to_string(PostProcess::HDR_FORMAT) << ", post-processing disabled\n";
+			postProcessing = false;
+		}
+	}
+	if (postProcessing)
+	{
+		PostProcess::Settings settings;
+		settings.tiledDownsample = options.tiledDownsample;
+		postProcess.init(device, physicalDevice, apiVersion, allocator, shaders, pipelineCache.handle(), targetFormat, options.framesInFlight, settings);
+	}
 
-	auto colorAttachmentRef = vk::AttachmentReference()
-		.setAttachment(0)
-		.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
+	// Async culling is ordered by the compute semaphore instead, the graph only sees its results on the graphics queue
+	RenderResource culledDraws = INVALID_RESOURCE;
+	if (options.instanceCount > 0 && !asyncCulling)
+	{
+		culledDraws = graph.importBuffer("culled draws");
+		auto cullingPass = graph.addPass("culling", PassType::Compute, [this](vk::CommandBuffer commandBuffer)
+		{
+			culler.recordCulling(commandBuffer, currentFrame, viewProj);
+		});
+		graph.write(cullingPass, culledDraws, ResourceAccess::StorageWrite, true);
+	}
 
-	auto subpass = vk::SubpassDescription()
-		.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
-		.setColorAttachmentCount(1)
-		.setPColorAttachments(&colorAttachmentRef);
+	// A backbuffer and scene pass per target, all culled from the same results. The render passes come out
+	// identical, so pipelines built against the first one are compatible with every other. Post-processed
+	// scenes are drawn into an HDR image of their own instead, its stages end in a copy to the backbuffer.
+	targets.resize(options.headless ? 1 : windows.size());
+	for (uint32_t i = 0; i < targets.size(); i++)
+	{
+		auto& target = targets[i];
+		auto suffix = i == 0 ? std::string() : " " + std::to_string(i + 1);
+		target.extent = options.headless ? offscreenExtent : windows[i]->extent();
 
-	auto dependency = vk::SubpassDependency()
-		.setSrcSubpass(VK_SUBPASS_EXTERNAL)
-		.setDstSubpass(0)
-		.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-		.setSrcAccessMask(vk::AccessFlags())
-		.setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-		.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+		// The acquire semaphore is waited on at color attachment output, the transition out of undefined chains after it
+		target.backbuffer = graph.importImage("backbuffer" + suffix, targetFormat,
+			options.headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR,
+			vk::ImageLayout::eUndefined, vk::PipelineStageFlagBits::eColorAttachmentOutput);
+		graph.markOutput(target.backbuffer);
 
-	auto renderPassInfo = vk::RenderPassCreateInfo()
-		.setAttachmentCount(1)
-		.setPAttachments(&colorAttachment)
-		.setSubpassCount(1)
-		.setPSubpasses(&subpass)
-		.setDependencyCount(1)
-		.setPDependencies(&dependency);
+		target.scenePass = graph.addPass("scene" + suffix, PassType::Graphics, [this, i](vk::CommandBuffer commandBuffer)
+		{
+			commandBuffer.executeCommands(sceneJobCount, frameCommands[currentFrame].secondaries.data() + i * workerPool->size());
+		});
+		auto color = target.backbuffer;
+		if (postProcessing)
+		{
+			TransientImageDesc hdrDesc;
+			hdrDesc.format = PostProcess::HDR_FORMAT;
+			color = graph.createImage("hdr" + suffix, hdrDesc);
+		}
+		graph.write(target.scenePass, color, ResourceAccess::ColorAttachment);
+		graph.setClear(target.scenePass, color, vk::ClearValue().setColor(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }));
+		graph.setSecondaryContents(target.scenePass);
+		if (culledDraws != INVALID_RESOURCE)
+		{
+			graph.read(target.scenePass, culledDraws, ResourceAccess::IndirectRead);
+			graph.read(target.scenePass, culledDraws, ResourceAccess::VertexRead);
+		}
+		if (postProcessing)
+			target.post = postProcess.addTarget(graph, color, target.backbuffer, suffix);
+	}
 
-	renderPass = device.createRenderPass(renderPassInfo);
+	if (capturing)
+	{
+		auto capturePass = graph.addPass("capture", PassType::Transfer, [this](vk::CommandBuffer commandBuffer)
+		{
+			capture.recordCopy(commandBuffer, targets[0].image, targetFormat, targets[0].extent, currentFrame, frameNumber + 1);
+		});
+		graph.read(capturePass, targets[0].backbuffer, ResourceAccess::TransferSrc);
+		// Its readback buffers are outside the graph, nothing would keep it alive
+		graph.setSideEffects(capturePass);
+	}
+
+	graph.compile(renderExtent());
+}
+
+vk::Extent2D Application::renderExtent() const
+{
+	if (options.headless)
+		return offscreenExtent;
+
+	vk::Extent2D extent;
+	for (const auto& window : windows)
+	{
+		extent.width = std::max(extent.width, window->extent().width);
+		extent.height = std::max(extent.height, window->extent().height);
+	}
+	return extent;
 }
 
 void Application::createGraphicsPipeline()
 {
-	auto vsModule = createShaderModule("res/shaders/helloVK_vs.spv");
-	auto fsModule = createShaderModule("res/shaders/helloVK_fs.spv");
+	vk::DescriptorSetLayout setLayouts[] = { bindless.layout(), frameSetLayout };
+	auto pushConstantRange = vk::PushConstantRange()
+		.setStageFlags(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
+		.setOffset(0)
+		.setSize(sizeof(DrawConstants));
 
-	auto vsStageInfo = vk::PipelineShaderStageCreateInfo()
-		.setStage(vk::ShaderStageFlagBits::eVertex)
-		.setModule(vsModule)
-		.setPName("main");
+	auto pipelineLayoutInfo = vk::PipelineLayoutCreateInfo()
+		.setSetLayoutCount(2)
+		.setPSetLayouts(setLayouts)
+		.setPushConstantRangeCount(1)
+		.setPPushConstantRanges(&pushConstantRange);
 
-	auto fsStageInfo = vk::PipelineShaderStageCreateInfo()
-		.setStage(vk::ShaderStageFlagBits::eFragment)
-		.setModule(fsModule)
-		.setPName("main");
+	pipelineLayout = device.createPipelineLayout(pipelineLayoutInfo);
 
-	vk::PipelineShaderStageCreateInfo shaderStages[] = { vsStageInfo, fsStageInfo };
+	// Both shaders share the layout, the fallback one just leaves the bindless set and push constants unused
+	GraphicsPipelineDesc desc;
+	desc.vertexShader = bindless.available() ? "helloVK_bindless_vs.spv" : "helloVK_vs.spv";
+	desc.fragmentShader = bindless.available() ? "helloVK_bindless_fs.spv" : "helloVK_fs.spv";
+	desc.bindings = { sceneVertexBinding, InstanceData::bindingDescription() };
+	desc.attributes = sceneVertexAttributes;
+	for (const auto& attribute : InstanceData::attributeDescriptions())
+		desc.attributes.push_back(attribute);
+	desc.layout = pipelineLayout;
+	desc.renderPass = graph.renderPass(targets[0].scenePass);
+	desc.subpass = 0;
+
+	scenePipeline = pipelines.request(desc);
+
+	// Stand-in materials cycling through raster and blend state; equal combinations collapse to one pipeline
+	materialPipelines = { scenePipeline };
+	for (uint32_t i = 1; i < options.materialCount; i++)
+	{
+		auto material = desc;
+		material.cullMode = (i & 1) ? vk::CullModeFlagBits::eNone : vk::CullModeFlagBits::eBack;
+		material.frontFace = (i & 2) ? vk::FrontFace::eCounterClockwise : vk::FrontFace::eClockwise;
+		material.blendEnable = (i & 4) != 0;
+		material.srcColorBlendFactor = (i & 4) ? vk::BlendFactor::eSrcAlpha : vk::BlendFactor::eOne;
+		material.dstColorBlendFactor = (i & 4) ? vk::BlendFactor::eOneMinusSrcAlpha : vk::BlendFactor::eZero;
+		material.colorWriteMask = (i & 8) ? vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB
+			: desc.colorWriteMask;
+		materialPipelines.push_back(pipelines.request(material, scenePipeline));
+	}
+}
 
-	auto vertexInputInfo = vk::PipelineVertexInputStateCreateInfo()
-		.setVertexBindingDescriptionCount(0)
-		.setPVertexBindingDescriptions(nullptr)
-		.setVertexAttributeDescriptionCount(0)
-		.setPVertexAttributeDescriptions(nullptr);
+void Application::createDescriptors()
+{
+	bindless.init(device, physicalDevice, descriptorIndexingSupported, deletions);
 
-	auto inputAssemblyState = vk::PipelineInputAssemblyStateCreateInfo()
-		.setTopology(vk::PrimitiveTopology::eTriangleList)
-		.setPrimitiveRestartEnable(VK_FALSE);
+	vk::DescriptorSetLayoutBinding frameBindings[] =
+	{
+		vk::DescriptorSetLayoutBinding()
+			.setBinding(0)
+			.setDescriptorType(vk::DescriptorType::eUniformBuffer)
+			.setDescriptorCount(1)
+			.setStageFlags(vk::ShaderStageFlagBits::eVertex),
+		vk::DescriptorSetLayoutBinding()
+			.setBinding(1)
+			.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+			.setDescriptorCount(1)
+			.setStageFlags(vk::ShaderStageFlagBits::eVertex)
+	};
+
+	auto setLayoutInfo = vk::DescriptorSetLayoutCreateInfo()
+		.setBindingCount(2)
+		.setPBindings(frameBindings);
+
+	frameSetLayout = device.createDescriptorSetLayout(setLayoutInfo);
+	frameDescriptors.init(device, options.framesInFlight, { vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, 1),
+		vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 1) });
+
+	// Ring segments start on 256 byte boundaries, which satisfies any minUniformBufferOffsetAlignment;
+	// objects are placed at multiples of the device's alignment so their offsets are valid dynamic offsets
+	auto alignment = physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
+	objectCount = options.instanceCount > 0 ? 1 : std::max(1u, options.drawCount);
+	objectStride = (sizeof(ObjectConstants) + alignment - 1) / alignment * alignment;
+	auto frameConstantsSize = (sizeof(FrameConstants) + alignment - 1) / alignment * alignment;
+	frameConstants.init(allocator, device, frameConstantsSize + objectCount * objectStride, options.framesInFlight, vk::BufferUsageFlagBits::eUniformBuffer);
+}
 
-	auto viewport = vk::Viewport()
-		.setX(0.0f)
-		.setY(0.0f)
-		.setWidth(swapchainExtent.width)
-		.setHeight(swapchainExtent.height)
-		.setMinDepth(0.0f)
-		.setMaxDepth(1.0f);
+void Application::createCommandPool()
+{
+	workerPool = std::make_unique<ThreadPool>(options.recordThreads);
 
-	auto scissor = vk::Rect2D()
-		.setOffset({ 0, 0 })
-		.setExtent(swapchainExtent);
-
-	auto viewportState = vk::PipelineViewportStateCreateInfo()
-		.setViewportCount(1)
-		.setPViewports(&viewport)
-		.setScissorCount(1)
-		.setPScissors(&scissor);
-
-	auto rasterizationState = vk::PipelineRasterizationStateCreateInfo()
-		.setDepthClampEnable(VK_FALSE)
-		.setPolygonMode(vk::PolygonMode::eFill)
-		.setLineWidth(1.0f)
-		.setCullMode(vk::CullModeFlagBits::eBack)
-		.setFrontFace(vk::FrontFace::eClockwise)
-		.setDepthBiasEnable(VK_FALSE)
-		.setDepthBiasConstantFactor(0.0f)
-		.setDepthBiasClamp(0.0f)
-		.setDepthBiasSlopeFactor(0.0f);
-
-	auto multisampleState = vk::PipelineMultisampleStateCreateInfo()
-		.setSampleShadingEnable(VK_FALSE)
-		.setRasterizationSamples(vk::SampleCountFlagBits::e1)
-		.setMinSampleShading(1.0f)
-		.setPSampleMask(nullptr)
-		.setAlphaToCoverageEnable(VK_FALSE)
-		.setAlphaToOneEnable(VK_FALSE);
-
-	// depth / stencil
-
-	auto colorBlendAttachmentState = vk::PipelineColorBlendAttachmentState()
-		.setColorWriteMask(
-			vk::ColorComponentFlagBits::eR |
-			vk::ColorComponentFlagBits::eG |
-			vk::ColorComponentFlagBits::eB |
-			vk::ColorComponentFlagBits::eA)
-		.setBlendEnable(VK_FALSE)
-		.setSrcColorBlendFactor(vk::BlendFactor::eOne)
-		.setDstColorBlendFactor(vk::BlendFactor::eZero)
-		.setColorBlendOp(vk::BlendOp::eAdd)
-		.setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
-		.setDstAlphaBlendFactor(vk::BlendFactor::eZero)
-		.setAlphaBlendOp(vk::BlendOp::eAdd);
-
-	auto colorBlendState = vk::PipelineColorBlendStateCreateInfo()
-		.setLogicOpEnable(VK_FALSE)
-		.setLogicOp(vk::LogicOp::eCopy)
-		.setAttachmentCount(1)
-		.setPAttachments(&colorBlendAttachmentState)
-		.setBlendConstants({ 0.0f, 0.0f, 0.0f, 0.0f });
-
-	vk::DynamicState dynamicStates[] = { vk::DynamicState::eViewport, vk::DynamicState::eLineWidth };
-	auto dynamicState = vk::PipelineDynamicStateCreateInfo()
-		.setDynamicStateCount(2)
-		.setPDynamicStates(dynamicStates);
+	// Primaries get one pool per frame in flight, secondaries one per recording thread and frame in flight,
+	// so a whole frame's command memory can be recycled with a handful of resetCommandPool calls
+	auto commandPoolInfo = vk::CommandPoolCreateInfo()
+		.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+		.setQueueFamilyIndex(queueFamilies.graphics);
 
-	auto pipelineLayoutInfo = vk::PipelineLayoutCreateInfo()
-		.setSetLayoutCount(0)
-		.setPSetLayouts(nullptr)
-		.setPushConstantRangeCount(0)
-		.setPPushConstantRanges(nullptr);
+	frameCommands.resize(options.framesInFlight);
+	for (auto& frame : frameCommands)
+	{
+		frame.primaryPool = device.createCommandPool(commandPoolInfo);
+		frame.workers.resize(workerPool->size());
+		for (auto& worker : frame.workers)
+			worker.pool = device.createCommandPool(commandPoolInfo);
+	}
+	recordSeconds.resize(workerPool->size(), 0.0);
 
-	pipelineLayout = device.createPipelineLayout(pipelineLayoutInfo);
+	if (!asyncCulling)
+		return;
 
-	auto pipelineInfo = vk::GraphicsPipelineCreateInfo()
-		.setStageCount(2)
-		.setPStages(shaderStages)
-		.setPVertexInputState(&vertexInputInfo)
-		.setPInputAssemblyState(&inputAssemblyState)
-		.setPViewportState(&viewportState)
-		.setPRasterizationState(&rasterizationState)
-		.setPMultisampleState(&multisampleState)
-		.setPDepthStencilState(nullptr)
-		.setPColorBlendState(&colorBlendState)
-		.setPDynamicState(nullptr)
-		.setLayout(pipelineLayout)
-		.setRenderPass(renderPass)
-		.setSubpass(0)
-		.setBasePipelineHandle(VK_NULL_HANDLE)
-		.setBasePipelineIndex(-1);
+	auto computePoolInfo = vk::CommandPoolCreateInfo()
+		.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+		.setQueueFamilyIndex(queueFamilies.compute);
 
-	graphicsPipeline = device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineInfo).value;
+	computeCommands.resize(options.framesInFlight);
+	for (auto& compute : computeCommands)
+	{
+		compute.pool = device.createCommandPool(computePoolInfo);
+
+		auto allocInfo = vk::CommandBufferAllocateInfo()
+			.setCommandPool(compute.pool)
+			.setLevel(vk::CommandBufferLevel::ePrimary)
+			.setCommandBufferCount(1);
 
-	device.destroyShaderModule(vsModule);
-	device.destroyShaderModule(fsModule);
+		compute.commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+		compute.finished = device.createSemaphore(vk::SemaphoreCreateInfo());
+	}
 }
 
-void Application::createFramebuffers()
+void Application::createSceneGeometry()
 {
-	for (const auto& imageView : swapchainImageViews)
+	if (!options.meshPath.empty())
+	{
+		sceneMeshFile = std::make_shared<MeshFile>();
+		sceneMeshFile->open(options.meshPath);
+		sceneMeshFile->printStats();
+		for (uint32_t i = 0; i < sceneMeshFile->meshCount(); i++)
+		{
+			const auto& mesh = sceneMeshFile->mesh(i);
+			sceneMeshes.push_back({ mesh.firstIndex, mesh.indexCount, mesh.vertexOffset });
+		}
+		sceneVertexBinding = sceneMeshFile->bindingDescription(0);
+		sceneVertexAttributes = sceneMeshFile->attributeDescriptions(0);
+		sceneIndexType = sceneMeshFile->indexType();
+
+		// Centered on the origin with the larger of x and y spanning the unit square, like the generated meshes
+		const auto& header = sceneMeshFile->header();
+		float fit = 0.5f / std::max(header.positionScale[0], header.positionScale[1]);
+		meshTransform = glm::mat4(1.0f);
+		for (int axis = 0; axis < 3; axis++)
+			meshTransform[axis][axis] = header.positionScale[axis] * fit;
+		return;
+	}
+
+	sceneVertexBinding = Vertex::bindingDescription();
+	for (const auto& attribute : Vertex::attributeDescriptions())
+		sceneVertexAttributes.push_back(attribute);
+
+	if (options.meshTriangles == 0)
+	{
+		sceneVertices = defaultVertices;
+		sceneIndices = defaultIndices;
+		sceneMeshes = defaultMeshes;
+		return;
+	}
+
+	// A fan around a center vertex per mesh, wound like the default triangle
+	const float twoPi = 6.28318530718f;
+	uint32_t triangles = std::max(3u, options.meshTriangles);
+	for (uint32_t mesh = 0; mesh < defaultMeshes.size(); mesh++)
 	{
-		auto framebufferInfo = vk::FramebufferCreateInfo()
-			.setRenderPass(renderPass)
-			.setAttachmentCount(1)
-			.setPAttachments(&imageView)
-			.setWidth(swapchainExtent.width)
-			.setHeight(swapchainExtent.height)
-			.setLayers(1);
+		MeshRange range;
+		range.firstIndex = static_cast<uint32_t>(sceneIndices.size());
+		range.indexCount = 3 * triangles;
+		range.vertexOffset = static_cast<int32_t>(sceneVertices.size());
+		sceneMeshes.push_back(range);
+
+		sceneVertices.push_back({ { 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } });
+		for (uint32_t i = 0; i < triangles; i++)
+		{
+			float angle = twoPi * (float(i) / float(triangles) + 0.125f * float(mesh));
+			glm::vec3 color(0.5f + 0.5f * std::cos(angle), 0.5f + 0.5f * std::sin(angle), mesh ? 1.0f : 0.0f);
+			sceneVertices.push_back({ { 0.5f * std::cos(angle), 0.5f * std::sin(angle) }, color });
 
-		auto framebuffer = device.createFramebuffer(framebufferInfo);
-		swapchainFramebuffers.push_back(framebuffer);
+			sceneIndices.push_back(0);
+			sceneIndices.push_back(1 + i);
+			sceneIndices.push_back(1 + (i + 1) % triangles);
+		}
 	}
 }
 
-void Application::createCommandPool()
+void Application::createGeometryBuffers()
 {
-	auto graphicsFamily = findQueueFamilies(physicalDevice).value().first;
+	// Copies run on the transfer family; the geometry is exclusively owned by graphics and handed over after each copy
+	uploader.init(device, allocator, transferQueue, queueFamilies.transfer, queueFamilies.graphics,
+		options.framesInFlight, options.stagingBufferSize);
+
+	// Cooked meshes are copied from the file mapping into staging as they are; the uploads hold on to the file
+	const void* vertexData = sceneVertices.data();
+	const void* indexData = sceneIndices.data();
+	vk::DeviceSize vertexBytes = sizeof(Vertex) * sceneVertices.size();
+	vk::DeviceSize indexBytes = sizeof(uint32_t) * sceneIndices.size();
+	if (sceneMeshFile)
+	{
+		vertexData = sceneMeshFile->vertexData();
+		indexData = sceneMeshFile->indexData();
+		vertexBytes = sceneMeshFile->vertexBytes();
+		indexBytes = sceneMeshFile->indexBytes();
+	}
 
-	auto commandPoolInfo = vk::CommandPoolCreateInfo()
-		.setQueueFamilyIndex(graphicsFamily);
+	auto vertexBufferInfo = vk::BufferCreateInfo()
+		.setSize(vertexBytes)
+		.setUsage(vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst)
+		.setSharingMode(vk::SharingMode::eExclusive);
+
+	vertexBuffer = device.createBuffer(vertexBufferInfo);
+	vertexAllocation = allocator.allocateBuffer(vertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	auto indexBufferInfo = vk::BufferCreateInfo()
+		.setSize(indexBytes)
+		.setUsage(vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst)
+		.setSharingMode(vk::SharingMode::eExclusive);
+
+	indexBuffer = device.createBuffer(indexBufferInfo);
+	indexAllocation = allocator.allocateBuffer(indexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	// Data is staged and copied as part of the first frame's upload submission
+	uploader.uploadBuffer(vertexBuffer, 0, vertexData, vertexBytes, sceneMeshFile);
+	uploader.uploadBuffer(indexBuffer, 0, indexData, indexBytes, sceneMeshFile);
+	sceneMeshFile.reset();
+
+	// Stand-in material data: a distinct tint per material variant, the first one neutral
+	std::vector<glm::vec4> tints(std::max(1u, options.materialCount), glm::vec4(1.0f));
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> channel(0.5f, 1.0f);
+	for (size_t i = 1; i < tints.size(); i++)
+		tints[i] = glm::vec4(channel(random), channel(random), channel(random), 1.0f);
+
+	auto materialBufferInfo = vk::BufferCreateInfo()
+		.setSize(sizeof(glm::vec4) * tints.size())
+		.setUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst)
+		.setSharingMode(vk::SharingMode::eExclusive);
+
+	materialBuffer = device.createBuffer(materialBufferInfo);
+	materialAllocation = allocator.allocateBuffer(materialBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	uploader.uploadBuffer(materialBuffer, 0, tints.data(), materialBufferInfo.size);
+	materialBufferIndex = bindless.addBuffer(materialBuffer);
+}
 
-	commandPool = device.createCommandPool(commandPoolInfo);
+void Application::createTextures()
+{
+	textures.init(device, physicalDevice, allocator, uploader, bindless, deletions, options.framesInFlight, options.textureBudget);
+
+	// Shown until a material's own texture has a level resident, and used by materials without one
+	uint32_t white = 0xFFFFFFFF;
+	auto fallback = textures.create(1, 1, vk::Format::eR8G8B8A8Unorm, &white, sizeof(white));
+	textures.setFallback(fallback);
+
+	std::vector<TextureHandle> loaded;
+	for (const auto& path : options.texturePaths)
+		loaded.push_back(textures.load(path));
+
+	uint32_t materialCount = std::max(1u, options.materialCount);
+	for (uint32_t i = 0; i < materialCount; i++)
+		materialTextures.push_back(loaded.empty() ? fallback : loaded[i % loaded.size()]);
+	materialTextureIndices.resize(materialCount, 0);
+
+	auto samplerInfo = vk::SamplerCreateInfo()
+		.setMagFilter(vk::Filter::eLinear)
+		.setMinFilter(vk::Filter::eLinear)
+		.setMipmapMode(vk::SamplerMipmapMode::eLinear)
+		.setAddressModeU(vk::SamplerAddressMode::eRepeat)
+		.setAddressModeV(vk::SamplerAddressMode::eRepeat)
+		.setAddressModeW(vk::SamplerAddressMode::eRepeat)
+		.setMinLod(0.0f)
+		.setMaxLod(VK_LOD_CLAMP_NONE);
+
+	textureSampler = device.createSampler(samplerInfo);
+	samplerIndex = bindless.addSampler(textureSampler);
+}
+
+void Application::createInstanceCulling()
+{
+	generateInstances();
+
+	auto cullShader = shaders.get("cull_cs.spv");
+	auto compactShader = shaders.get("compact_draws_cs.spv");
+
+	std::set<uint32_t> families = { queueFamilies.graphics, queueFamilies.transfer };
+	if (asyncCulling)
+		families.insert(queueFamilies.compute);
+
+	culler.init(device, allocator, uploader, instances, sceneMeshes, options.framesInFlight,
+		cullShader, compactShader, pipelineCache.handle(), features12.drawIndirectCount, multiDrawIndirectSupported,
+		std::vector<uint32_t>(families.begin(), families.end()));
+}
+
+void Application::generateInstances()
+{
+	// Without GPU culling a single untransformed instance reproduces the plain triangle
+	if (options.instanceCount == 0)
+	{
+		InstanceData instance = {};
+		instance.positionScale = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		instance.color = glm::vec4(1.0f);
+		instances.push_back(instance);
+		return;
+	}
+
+	// Scattered a little past the viewport so a share of them gets culled
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-1.25f, 1.25f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float scale = std::min(0.5f, 1.5f / std::sqrt(static_cast<float>(options.instanceCount)));
+
+	instances.resize(options.instanceCount);
+	for (uint32_t i = 0; i < options.instanceCount; i++)
+	{
+		auto& instance = instances[i];
+		instance.positionScale = glm::vec4(position(random), position(random), 0.0f, scale * (0.5f + unit(random)));
+		instance.color = glm::vec4(unit(random), unit(random), unit(random), 1.0f);
+		instance.mesh = i % static_cast<uint32_t>(sceneMeshes.size());
+	}
 }
 
 void Application::createCommandBuffers()
 {
-	auto allocInfo = vk::CommandBufferAllocateInfo()
-		.setCommandPool(commandPool)
-		.setLevel(vk::CommandBufferLevel::ePrimary)
-		.setCommandBufferCount(swapchainFramebuffers.size());
+	for (auto& frame : frameCommands)
+	{
+		auto primaryInfo = vk::CommandBufferAllocateInfo()
+			.setCommandPool(frame.primaryPool)
+			.setLevel(vk::CommandBufferLevel::ePrimary)
+			.setCommandBufferCount(1);
+
+		frame.primary = device.allocateCommandBuffers(primaryInfo)[0];
+		frame.secondaries.resize(workerPool->size() * targets.size());
+	}
+}
+
+vk::CommandBuffer Application::recordCommandBuffer()
+{
+	auto& frame = frameCommands[currentFrame];
+
+	// The frame slot has been waited on, nothing recorded from these pools is still executing
+	device.resetCommandPool(frame.primaryPool, vk::CommandPoolResetFlags());
+	for (auto& worker : frame.workers)
+	{
+		device.resetCommandPool(worker.pool, vk::CommandPoolResetFlags());
+		worker.used = 0;
+	}
+
+	updateFrameDescriptors();
+
+	// GPU-driven rendering records a single indirect draw
+	uint32_t workers = workerPool->size();
+	uint32_t jobCount = std::min(workers, std::max(1u, (options.drawCount + MIN_DRAWS_PER_JOB - 1) / MIN_DRAWS_PER_JOB));
+	if (options.instanceCount > 0)
+		jobCount = 1;
+	uint32_t drawsPerJob = (options.drawCount + jobCount - 1) / jobCount;
+	sceneJobCount = jobCount;
 
-	commandBuffers = device.allocateCommandBuffers(allocInfo);
+	// Targets without an image this frame stay unbound and the graph skips their scene passes.
+	// Framebuffers are created here, the recording jobs only read them.
+	std::vector<vk::CommandBufferInheritanceInfo> inheritanceInfos(targets.size());
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		auto& target = targets[i];
+		graph.bindImage(target.backbuffer, target.image, target.view, target.extent);
+		// The scene pass of a post-processed target never touches the backbuffer, so it is skipped explicitly
+		if (postProcessing)
+		{
+			bool bound = static_cast<bool>(target.image);
+			graph.setEnabled(target.scenePass, bound);
+			for (auto pass : postProcess.passes(target.post))
+				graph.setEnabled(pass, bound);
+			postProcess.setRegion(target.post, target.extent);
+		}
+		if (!target.image)
+			continue;
+		inheritanceInfos[i] = vk::CommandBufferInheritanceInfo()
+			.setRenderPass(graph.renderPass(target.scenePass))
+			.setSubpass(0)
+			.setFramebuffer(graph.framebuffer(target.scenePass));
+	}
 
-	for (int i = 0; i < commandBuffers.size(); i++)
+	// Every target's jobs go out in one batch; each runs on a worker thread and records from that thread's pool
+	workerPool->parallelFor(jobCount * static_cast<uint32_t>(targets.size()), [&](uint32_t task, uint32_t worker)
 	{
-		auto& commandBuffer = commandBuffers[i];
-		auto beginInfo = vk::CommandBufferBeginInfo();
-		commandBuffer.begin(beginInfo);
+		uint32_t targetIndex = task / jobCount;
+		uint32_t job = task % jobCount;
+		const auto& target = targets[targetIndex];
+		if (!target.image)
+			return;
+
+		auto start = std::chrono::steady_clock::now();
+		auto& commands = frame.workers[worker];
+		if (commands.used == commands.buffers.size())
+		{
+			auto secondaryInfo = vk::CommandBufferAllocateInfo()
+				.setCommandPool(commands.pool)
+				.setLevel(vk::CommandBufferLevel::eSecondary)
+				.setCommandBufferCount(1);
+
+			commands.buffers.push_back(device.allocateCommandBuffers(secondaryInfo)[0]);
+		}
+		auto secondary = commands.buffers[commands.used++];
+		frame.secondaries[targetIndex * workers + job] = secondary;
+
+		uint32_t first = job * drawsPerJob;
+		uint32_t last = std::min(options.drawCount, first + drawsPerJob);
+		if (options.instanceCount > 0)
+			recordIndirectDraw(secondary, inheritanceInfos[targetIndex], target.extent);
+		else
+			recordDraws(secondary, inheritanceInfos[targetIndex], target.extent, first, last);
+		recordSeconds[worker] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	});
+	recordedFrames++;
+
+	auto& commandBuffer = frame.primary;
+	auto beginInfo = vk::CommandBufferBeginInfo()
+		.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+	commandBuffer.begin(beginInfo);
+
+	profiler.resetQueries(commandBuffer);
+	auto frameSpan = profiler.beginGpuSpan(commandBuffer, "frame");
+
+	uploader.recordAcquire(commandBuffer);
+	textures.recordMipGeneration(commandBuffer);
 
-		auto renderArea = vk::Rect2D()
-			.setOffset({ 0, 0 })
-			.setExtent(swapchainExtent);
+	// The upload semaphore only orders the frame that carried the copies, later frames rely on this
+	auto uploadBarrier = vk::MemoryBarrier()
+		.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+		.setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead);
 
-		auto clearColor = vk::ClearValue()
-			.setColor(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f });
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader,
+		vk::DependencyFlags(), uploadBarrier, nullptr, nullptr);
 
-		auto renderPassBeginInfo = vk::RenderPassBeginInfo()
-			.setRenderPass(renderPass)
-			.setFramebuffer(swapchainFramebuffers[i])
-			.setRenderArea(renderArea)
-			.setClearValueCount(1)
-			.setPClearValues(&clearColor);
+	// Culling, scene and post-processing passes with their barriers. Async culling was submitted on the compute
+	// queue; its span is left out since the slot's queries are reset here.
+	if (postProcessing)
+		postProcess.beginFrame(currentFrame, snapshots.front().seconds);
+	graph.execute(commandBuffer);
 
-		commandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
-		commandBuffer.draw(3, 1, 0, 0);
-		commandBuffer.endRenderPass();
-		commandBuffer.end();
+	profiler.endGpuSpan(commandBuffer, frameSpan);
+	commandBuffer.end();
+
+	return commandBuffer;
+}
+
+void Application::recordDraws(vk::CommandBuffer commandBuffer, const vk::CommandBufferInheritanceInfo& inheritanceInfo, vk::Extent2D extent,
+	uint32_t firstDraw, uint32_t lastDraw)
+{
+	auto beginInfo = vk::CommandBufferBeginInfo()
+		.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+		.setPInheritanceInfo(&inheritanceInfo);
+	commandBuffer.begin(beginInfo);
+
+	// Resolved once per job; materials still compiling draw with their fallback or are skipped
+	std::vector<vk::Pipeline> materials;
+	for (auto handle : materialPipelines)
+		materials.push_back(pipelines.get(handle));
+
+	setViewportAndScissor(commandBuffer, extent);
+	bindDescriptors(commandBuffer, firstDraw);
+	vk::Buffer vertexBuffers[] = { vertexBuffer, culler.instanceBuffer() };
+	vk::DeviceSize vertexOffsets[] = { 0, 0 };
+	commandBuffer.bindVertexBuffers(0, 2, vertexBuffers, vertexOffsets);
+	commandBuffer.bindIndexBuffer(indexBuffer, 0, sceneIndexType);
+
+	vk::Pipeline boundPipeline;
+	for (uint32_t i = firstDraw; i < lastDraw; i++)
+	{
+		auto pipeline = materials[i % materials.size()];
+		if (!pipeline)
+			continue;
+		if (pipeline != boundPipeline)
+		{
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+			boundPipeline = pipeline;
+		}
+
+		pushDrawConstants(commandBuffer, i % static_cast<uint32_t>(materials.size()));
+		// Only the offset changes, set 1 is not rewritten per draw
+		if (i != firstDraw)
+		{
+			uint32_t offset = objectOffset(i);
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 1, frameSet, offset);
+		}
+
+		uint32_t instance = i % static_cast<uint32_t>(instances.size());
+		const auto& mesh = sceneMeshes[instances[instance].mesh];
+		commandBuffer.drawIndexed(mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, instance);
 	}
+
+	commandBuffer.end();
+}
+
+void Application::recordIndirectDraw(vk::CommandBuffer commandBuffer, const vk::CommandBufferInheritanceInfo& inheritanceInfo, vk::Extent2D extent)
+{
+	auto beginInfo = vk::CommandBufferBeginInfo()
+		.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+		.setPInheritanceInfo(&inheritanceInfo);
+	commandBuffer.begin(beginInfo);
+
+	auto pipeline = pipelines.get(scenePipeline);
+	if (pipeline)
+	{
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+		setViewportAndScissor(commandBuffer, extent);
+		bindDescriptors(commandBuffer);
+		pushDrawConstants(commandBuffer, 0);
+		vk::DeviceSize vertexOffset = 0;
+		commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer, &vertexOffset);
+		commandBuffer.bindIndexBuffer(indexBuffer, 0, sceneIndexType);
+		culler.recordDraw(commandBuffer, currentFrame);
+	}
+
+	commandBuffer.end();
+}
+
+void Application::updateFrameDescriptors()
+{
+	for (size_t i = 0; i < materialTextures.size(); i++)
+		materialTextureIndices[i] = textures.use(materialTextures[i]);
+
+	// The frame slot has been waited on, so its transient sets and constants are free again
+	bindless.update();
+	frameDescriptors.beginFrame(currentFrame);
+	frameConstants.beginFrame(currentFrame);
+
+	auto range = frameConstants.allocate(sizeof(FrameConstants), 1);
+	FrameConstants constants = { viewProj };
+	std::memcpy(range.mapped, &constants, sizeof(constants));
+
+	updateObjectConstants();
+	frameConstants.flush(device);
+
+	frameSet = frameDescriptors.allocate(frameSetLayout);
+
+	// The object binding covers one object from the start of the ring, draws select theirs with a dynamic offset
+	vk::DescriptorBufferInfo bufferInfos[] =
+	{
+		vk::DescriptorBufferInfo(range.buffer, range.offset, sizeof(FrameConstants)),
+		vk::DescriptorBufferInfo(frameConstants.handle(), 0, sizeof(ObjectConstants))
+	};
+	vk::WriteDescriptorSet writes[] =
+	{
+		vk::WriteDescriptorSet()
+			.setDstSet(frameSet)
+			.setDstBinding(0)
+			.setDescriptorCount(1)
+			.setDescriptorType(vk::DescriptorType::eUniformBuffer)
+			.setPBufferInfo(&bufferInfos[0]),
+		vk::WriteDescriptorSet()
+			.setDstSet(frameSet)
+			.setDstBinding(1)
+			.setDescriptorCount(1)
+			.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+			.setPBufferInfo(&bufferInfos[1])
+	};
+
+	device.updateDescriptorSets(writes, nullptr);
+}
+
+void Application::updateObjectConstants()
+{
+	// The stride is a multiple of the offset alignment, aligning to it wastes nothing for power-of-two sizes
+	auto objects = frameConstants.allocate(objectCount * objectStride, objectStride);
+	objectBase = objects.offset;
+
+	// Written in a single pass straight into mapped memory; nothing is allocated or rewritten per object.
+	// The objects spin at slightly different rates so every one of them changes every tick.
+	float seconds = static_cast<float>(snapshots.front().seconds);
+	auto mapped = static_cast<char*>(objects.mapped);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		float angle = objectCount > 1 ? seconds * (0.5f + 0.1f * static_cast<float>(i % 8)) : 0.0f;
+		glm::mat4 spin(1.0f);
+		spin[0][0] = std::cos(angle);
+		spin[0][1] = std::sin(angle);
+		spin[1][0] = -std::sin(angle);
+		spin[1][1] = std::cos(angle);
+		ObjectConstants object = { spin * meshTransform };
+		std::memcpy(mapped + i * objectStride, &object, sizeof(object));
+	}
+}
+
+void Application::bindDescriptors(vk::CommandBuffer commandBuffer, uint32_t object)
+{
+	// The bindless set once per command buffer; the pipelines share one layout so the sets survive pipeline switches
+	if (bindless.available())
+		bindless.bind(commandBuffer, vk::PipelineBindPoint::eGraphics, pipelineLayout);
+	uint32_t offset = objectOffset(object);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 1, frameSet, offset);
+}
+
+void Application::pushDrawConstants(vk::CommandBuffer commandBuffer, uint32_t material)
+{
+	DrawConstants constants = { materialBufferIndex, material, materialTextureIndices[material], samplerIndex };
+	commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+		0, sizeof(constants), &constants);
+}
+
+void Application::setViewportAndScissor(vk::CommandBuffer commandBuffer, vk::Extent2D extent)
+{
+	// Secondary command buffers inherit no dynamic state, every one of them sets its own
+	auto viewport = vk::Viewport()
+		.setX(0.0f)
+		.setY(0.0f)
+		.setWidth(static_cast<float>(extent.width))
+		.setHeight(static_cast<float>(extent.height))
+		.setMinDepth(0.0f)
+		.setMaxDepth(1.0f);
+
+	auto scissor = vk::Rect2D()
+		.setOffset({ 0, 0 })
+		.setExtent(extent);
+
+	commandBuffer.setViewport(0, 1, &viewport);
+	commandBuffer.setScissor(0, 1, &scissor);
+}
+
+void Application::printRecordingReport()
+{
+	if (recordedFrames == 0)
+		return;
+
+	uint32_t workers = workerPool->size();
+	std::cout << "[Recording] " << options.drawCount << " draws per frame into " << targets.size() << " target(s) on up to "
+		<< workers << " threads\n";
+	double totalSeconds = 0.0;
+	for (uint32_t i = 0; i < workers; i++)
+	{
+		if (recordSeconds[i] == 0.0)
+			continue;
+		std::cout << "\t--thread " << i << ": " << recordSeconds[i] * 1000.0 / recordedFrames << " ms per frame\n";
+		totalSeconds += recordSeconds[i];
+	}
+	if (options.drawCount > 0)
+		std::cout << "\t--CPU time per draw: " << totalSeconds * 1e9 / (double(recordedFrames) * options.drawCount * targets.size()) << " ns\n";
 }
 
 void Application::createSyncObjects()
 {
-	auto semaphoreInfo = vk::SemaphoreCreateInfo();
 	auto fenceInfo = vk::FenceCreateInfo()
 		.setFlags(vk::FenceCreateFlagBits::eSignaled);
 
-	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	if (timelineSemaphoreSupported)
+	{
+		auto timelineInfo = vk::SemaphoreTypeCreateInfo()
+			.setSemaphoreType(vk::SemaphoreType::eTimeline)
+			.setInitialValue(0);
+		frameTimeline = device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timelineInfo));
+	}
+
+	// The windows own their acquire and present semaphores
+	for (uint32_t i = 0; i < options.framesInFlight; i++)
 	{
-		auto availableSemaphore = device.createSemaphore(semaphoreInfo);
-		auto finishedSemaphore = device.createSemaphore(semaphoreInfo);
-		auto fence = device.createFence(fenceInfo);
-		imageAvailableSemaphores.push_back(availableSemaphore);
-		renderFinishedSemaphores.push_back(finishedSemaphore);
-		inFlightFences.push_back(fence);
+		if (!timelineSemaphoreSupported)
+			inFlightFences.push_back(device.createFence(fenceInfo));
 	}
 
-	imagesInFlight.resize(swapchainImages.size(), VK_NULL_HANDLE);
+	frameSlotValues.resize(options.framesInFlight, 0);
 }
 
 void Application::drawFrame()
 {
-	device.waitForFences({ inFlightFences[currentFrame] }, VK_TRUE, UINT64_MAX);
+	// Whatever this frame retires, starting with replaced swapchains, is held until its value completes
+	uint64_t frameValue = frameNumber + 1;
+	deletions.setFrame(frameValue);
+	for (auto& window : windows)
+	{
+		if (window->outOfDate())
+			recreateSwapchain(*window);
+	}
+
+	// Time blocked on the GPU and the swapchain is the render thread's stall
+	auto stalled = [this](std::chrono::steady_clock::time_point start)
+	{
+		threadStats.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	auto waitStart = std::chrono::steady_clock::now();
+	waitForFrame(frameSlotValues[currentFrame]);
+	stalled(waitStart);
+	profiler.beginFrame(currentFrame, frameValue);
+	profiler.addPhase(CpuPhase::WaitFrame, waitStart);
+	if (capturing)
+		capture.collect(currentFrame);
+	deletions.collect(pollCompletedFrame());
+
+	// Windows that are minimized or out of date sit this frame out, the others still render and present
+	auto acquireStart = std::chrono::steady_clock::now();
+	profiler.beginPhase(CpuPhase::Acquire);
+	std::vector<SemaphoreWait> waits;
+	for (size_t i = 0; i < windows.size(); i++)
+	{
+		auto& window = *windows[i];
+		auto& target = targets[i];
+		target.image = VK_NULL_HANDLE;
+		target.view = VK_NULL_HANDLE;
+		if (!window.acquire(currentFrame))
+			continue;
+
+		target.image = window.image();
+		target.view = window.imageView();
+		target.extent = window.extent();
+		waits.push_back({ window.imageAvailable(currentFrame), 0, vk::PipelineStageFlagBits::eColorAttachmentOutput });
+	}
+	profiler.endPhase(CpuPhase::Acquire);
+	if (waits.empty())
+		return;
 
-	auto imageIndex = device.acquireNextImageKHR(swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE).value;
-	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE)
-		device.waitForFences({ inFlightFences[currentFrame] }, VK_TRUE, UINT64_MAX);
+	// The images may still be owned by older frames from different slots
+	profiler.beginPhase(CpuPhase::WaitFrame);
+	for (size_t i = 0; i < windows.size(); i++)
+	{
+		if (targets[i].image)
+			waitForFrame(windows[i]->imageFrameValue());
+	}
+	profiler.endPhase(CpuPhase::WaitFrame);
+	stalled(acquireStart);
 
-	imagesInFlight[imageIndex] = inFlightFences[currentFrame];
-	
-	vk::Semaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-	vk::Semaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-	vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+	consumeSnapshot();
+	uploader.beginFrame(currentFrame);
 
-	auto submitInfo = vk::SubmitInfo()
-		.setWaitSemaphoreCount(1)
-		.setPWaitSemaphores(waitSemaphores)
-		.setPWaitDstStageMask(waitStages)
-		.setCommandBufferCount(1)
-		.setPCommandBuffers(&commandBuffers[imageIndex])
-		.setSignalSemaphoreCount(1)
-		.setPSignalSemaphores(signalSemaphores);
+	// Uploads are flushed first so the primary can acquire what they transferred
+	profiler.beginPhase(CpuPhase::Record);
+	flushUploads(waits);
+	auto commandBuffer = recordCommandBuffer();
+	profiler.endPhase(CpuPhase::Record);
+
+	profiler.beginPhase(CpuPhase::Submit);
+	std::vector<vk::Semaphore> signalSemaphores;
+	for (size_t i = 0; i < windows.size(); i++)
+	{
+		if (targets[i].image)
+			signalSemaphores.push_back(windows[i]->renderFinished());
+	}
+	submitFrame(commandBuffer, waits, signalSemaphores, frameValue);
+	profiler.endPhase(CpuPhase::Submit);
 
-	device.resetFences({ inFlightFences[currentFrame] });
+	profiler.beginPhase(CpuPhase::Present);
+	presentFrame();
+	profiler.endPhase(CpuPhase::Present);
+	pacer.frameSubmitted();
 
-	graphicsQueue.submit(1, &submitInfo, inFlightFences[currentFrame]);
+	currentFrame = (currentFrame + 1) % options.framesInFlight;
+}
 
-	vk::SwapchainKHR swapchains[] = { swapchain };
+void Application::presentFrame()
+{
+	// One present for every window that rendered this frame; each gets its own result back
+	std::vector<Window*> presented;
+	std::vector<vk::Semaphore> waitSemaphores;
+	std::vector<vk::SwapchainKHR> swapchains;
+	std::vector<uint32_t> imageIndices;
+	for (size_t i = 0; i < windows.size(); i++)
+	{
+		if (!targets[i].image)
+			continue;
+		auto& window = *windows[i];
+		window.submitted(frameNumber);
+		presented.push_back(&window);
+		waitSemaphores.push_back(window.renderFinished());
+		swapchains.push_back(window.swapchain());
+		imageIndices.push_back(window.acquiredImage());
+	}
 
+	std::vector<vk::Result> results(swapchains.size(), vk::Result::eSuccess);
 	auto presentInfo = vk::PresentInfoKHR()
-		.setWaitSemaphoreCount(1)
-		.setPWaitSemaphores(signalSemaphores)
-		.setSwapchainCount(1)
-		.setPSwapchains(swapchains)
-		.setPImageIndices(&imageIndex);
+		.setWaitSemaphoreCount(static_cast<uint32_t>(waitSemaphores.size()))
+		.setPWaitSemaphores(waitSemaphores.data())
+		.setSwapchainCount(static_cast<uint32_t>(swapchains.size()))
+		.setPSwapchains(swapchains.data())
+		.setPImageIndices(imageIndices.data())
+		.setPResults(results.data());
 
-	presentQueue.presentKHR(presentInfo);
-	presentQueue.waitIdle();
+	try
+	{
+		presentQueue.presentKHR(presentInfo);
+	}
+	catch (const vk::OutOfDateKHRError&)
+	{
+		// The per-swapchain results tell which of the windows it was
+	}
+	for (size_t i = 0; i < presented.size(); i++)
+		presented[i]->presented(results[i]);
+}
 
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+void Application::drawOffscreenFrame()
+{
+	uint64_t frameValue = frameNumber + 1;
+	deletions.setFrame(frameValue);
+
+	auto waitStart = std::chrono::steady_clock::now();
+	waitForFrame(frameSlotValues[currentFrame]);
+	profiler.beginFrame(currentFrame, frameValue);
+	profiler.addPhase(CpuPhase::WaitFrame, waitStart);
+	auto cpuStart = std::chrono::steady_clock::now();
+	threadStats.waitSeconds += std::chrono::duration<double>(cpuStart - waitStart).count();
+	if (capturing)
+		capture.collect(currentFrame);
+	deletions.collect(pollCompletedFrame());
+
+	consumeSnapshot();
+	uploader.beginFrame(currentFrame);
+	targets[0].image = offscreenImages[currentFrame];
+	targets[0].view = offscreenImageViews[currentFrame];
+
+	profiler.beginPhase(CpuPhase::Record);
+	std::vector<SemaphoreWait> waits;
+	flushUploads(waits);
+	auto commandBuffer = recordCommandBuffer();
+	profiler.endPhase(CpuPhase::Record);
+
+	profiler.beginPhase(CpuPhase::Submit);
+	submitFrame(commandBuffer, waits, {}, frameValue);
+	profiler.endPhase(CpuPhase::Submit);
+
+	cpuFrameSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - cpuStart).count();
+	currentFrame = (currentFrame + 1) % options.framesInFlight;
 }
 
-bool Application::isDeviceAvailable(vk::PhysicalDevice device)
+void Application::updateSimulation()
 {
-	auto deviceProperties = device.getProperties();
-	auto deviceFeatures = device.getFeatures();
-	auto queueFamilyIndices = findQueueFamilies(device);
+	auto now = std::chrono::steady_clock::now();
+	if (now < nextTick)
+		return;
 
-	bool extensionsSupported = checkDeviceExtensionSupport(device);
+	// Falling too far behind drops ticks, the simulation time then lags the wall clock instead of spiraling
+	auto due = (now - nextTick) / tickDuration + 1;
+	if (due > MAX_CATCH_UP_TICKS)
+	{
+		threadStats.droppedTicks += due - MAX_CATCH_UP_TICKS;
+		nextTick += tickDuration * (due - MAX_CATCH_UP_TICKS);
+	}
 
-	auto capabilities = device.getSurfaceCapabilitiesKHR(surface);
-	auto formats = device.getSurfaceFormatsKHR(surface);
-	auto presentModes = device.getSurfacePresentModesKHR(surface);
+	// How late each tick runs is the main thread's stall, from event handling or ticks before it running over
+	double tickSeconds = std::chrono::duration<double>(tickDuration).count();
+	for (; nextTick <= now; nextTick += tickDuration)
+	{
+		double late = std::chrono::duration<double>(now - nextTick).count();
+		threadStats.lateSeconds += late;
+		threadStats.maxLateSeconds = std::max(threadStats.maxLateSeconds, late);
+		threadStats.ticks++;
 
-	bool swapchainAdequate = !formats.empty() && !presentModes.empty();
+		simulation.tick++;
+		simulation.seconds += tickSeconds;
+	}
 
-	return deviceProperties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu &&
-		deviceFeatures.geometryShader &&
-		queueFamilyIndices.has_value() &&
-		swapchainAdequate &&
-		extensionsSupported;
+	// Only the newest state is handed over, the renderer never waits for it
+	snapshots.back() = simulation;
+	snapshots.publish();
 }
 
-std::optional<std::pair<uint32_t, uint32_t>> Application::findQueueFamilies(vk::PhysicalDevice device)
+void Application::consumeSnapshot()
 {
-	auto queueFamilies = device.getQueueFamilyProperties();
-	//std::cout << "\tDevice has " << queueFamilies.size() << " QueueFamilies\n";
-	std::optional<std::pair<uint32_t, uint32_t>> ret;
+	// As late as possible before recording, so the frame shows the newest tick; without one the last is drawn again
+	if (!snapshots.acquire())
+		threadStats.staleFrames++;
+	threadStats.frames++;
+	viewProj = snapshots.front().viewProj;
+}
 
-	uint32_t i = 0;
-	for (const auto& queueFamily : queueFamilies)
-	{
-		if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
-		{
-			if (device.getSurfaceSupportKHR(i, surface))
-			{
-				ret = std::pair<uint32_t, uint32_t>(i, i);
-				break;
-			}
-		}
-		i++;
-	}
-	return ret;
+void Application::printThreadReport()
+{
+	if (threadStats.frames == 0)
+		return;
+
+	std::cout << "[Threads] " << (options.headless ? "headless" : options.renderThread ? "render thread" : "single thread")
+		<< ", simulation at " << options.simulationRate << " Hz\n"
+		<< "\t--main: " << threadStats.ticks << " ticks, " << threadStats.droppedTicks << " dropped, late by "
+		<< (threadStats.ticks ? threadStats.lateSeconds * 1000.0 / threadStats.ticks : 0.0) << " ms on average, "
+		<< threadStats.maxLateSeconds * 1000.0 << " ms at most\n"
+		<< "\t--render: " << threadStats.frames << " frames, " << threadStats.staleFrames << " without a new snapshot, "
+		<< threadStats.waitSeconds * 1000.0 / threadStats.frames << " ms per frame waiting on the GPU and swapchain\n";
 }
 
-bool Application::checkDeviceExtensionSupport(vk::PhysicalDevice device)
+void Application::flushUploads(std::vector<SemaphoreWait>& waits)
 {
-	auto availableExtensions = vk::enumerateInstanceExtensionProperties();
-	std::cout << "[Vulkan Extensions Supported]\n";
-	for (const auto& i : availableExtensions)
-		std::cout << "\t--" << i.extensionName << "\n";
+	// Texture levels take whatever staging this frame's buffer uploads leave
+	textures.update();
 
-	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-	bool supported = true;
-	std::cout << "[Vulkan Extensions required]\n";
-	for (const auto& i : requiredExtensions)
+	if (!asyncCulling)
 	{
-		std::cout << "\t--" << i;
-		if (requiredExtensions.find(i) != requiredExtensions.end())
-			std::cout << "  [Found]\n";
-		else
-		{
-			supported = false;
-			break;
-		}
+		// Culling in the primary reads the uploaded instances ahead of any vertex input
+		uploader.flush(waits, vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader |
+			vk::PipelineStageFlagBits::eVertexInput);
+		return;
 	}
-	return supported;
+
+	// Uploads -> culling on the compute queue -> graphics, which then only waits for the culling results.
+	// Transfer is included for the texture mip blits recorded in the graphics primary.
+	std::vector<SemaphoreWait> computeWaits;
+	uploader.flush(computeWaits, vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader);
+
+	auto& compute = computeCommands[currentFrame];
+	device.resetCommandPool(compute.pool);
+	compute.commandBuffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	culler.recordCulling(compute.commandBuffer, currentFrame, viewProj);
+	compute.commandBuffer.end();
+
+	std::vector<vk::Semaphore> waitSemaphores;
+	std::vector<vk::PipelineStageFlags> waitStages;
+	for (const auto& wait : computeWaits)
+	{
+		waitSemaphores.push_back(wait.semaphore);
+		waitStages.push_back(wait.stage);
+	}
+
+	auto submitInfo = vk::SubmitInfo()
+		.setWaitSemaphoreCount(static_cast<uint32_t>(waitSemaphores.size()))
+		.setPWaitSemaphores(waitSemaphores.data())
+		.setPWaitDstStageMask(waitStages.data())
+		.setCommandBufferCount(1)
+		.setPCommandBuffers(&compute.commandBuffer)
+		.setSignalSemaphoreCount(1)
+		.setPSignalSemaphores(&compute.finished);
+
+	computeQueue.submit(submitInfo, VK_NULL_HANDLE);
+	waits.push_back({ compute.finished, 0, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput |
+		vk::PipelineStageFlagBits::eTransfer });
 }
 
-vk::SurfaceFormatKHR Application::selectSwapchainSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& formats)
+void Application::submitFrame(vk::CommandBuffer commandBuffer, const std::vector<SemaphoreWait>& waits, const std::vector<vk::Semaphore>& signalSemaphores,
+	uint64_t frameValue)
 {
-	for (const auto& format : formats)
+	std::vector<vk::Semaphore> waitSemaphores;
+	std::vector<uint64_t> waitValues;
+	std::vector<vk::PipelineStageFlags> waitStages;
+	for (const auto& wait : waits)
+	{
+		waitSemaphores.push_back(wait.semaphore);
+		waitValues.push_back(wait.value);
+		waitStages.push_back(wait.stage);
+	}
+
+	// Binary semaphores take a placeholder value
+	std::vector<vk::Semaphore> semaphores = signalSemaphores;
+	std::vector<uint64_t> signalValues(semaphores.size(), 0);
+	if (timelineSemaphoreSupported)
+	{
+		semaphores.push_back(frameTimeline);
+		signalValues.push_back(frameValue);
+	}
+
+	auto timelineInfo = vk::TimelineSemaphoreSubmitInfo()
+		.setWaitSemaphoreValueCount(static_cast<uint32_t>(waitValues.size()))
+		.setPWaitSemaphoreValues(waitValues.data())
+		.setSignalSemaphoreValueCount(static_cast<uint32_t>(signalValues.size()))
+		.setPSignalSemaphoreValues(signalValues.data());
+
+	auto submitInfo = vk::SubmitInfo()
+		.setWaitSemaphoreCount(static_cast<uint32_t>(waitSemaphores.size()))
+		.setPWaitSemaphores(waitSemaphores.data())
+		.setPWaitDstStageMask(waitStages.data())
+		.setCommandBufferCount(1)
+		.setPCommandBuffers(&commandBuffer)
+		.setSignalSemaphoreCount(static_cast<uint32_t>(semaphores.size()))
+		.setPSignalSemaphores(semaphores.data());
+
+	vk::Fence fence = VK_NULL_HANDLE;
+	if (timelineSemaphoreSupported)
+		submitInfo.setPNext(&timelineInfo);
+	else
 	{
-		if (format.format == vk::Format::eB8G8R8A8Srgb && format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)
-			return format;
+		fence = inFlightFences[currentFrame];
+		device.resetFences({ fence });
+	}
+
+	graphicsQueue.submit(1, &submitInfo, fence);
+
+	frameSlotValues[currentFrame] = frameValue;
+	frameNumber = frameValue;
+
+	if (frameValue == 1)
+	{
+		auto firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		std::cout << "[Startup] First frame submitted after " << firstFrameMs << " ms, "
+			<< pipelines.pendingCount() << " pipelines still compiling\n";
 	}
-	return formats[0];
 }
 
-vk::PresentModeKHR Application::selectSwapchainPresentMode(const std::vector<vk::PresentModeKHR>& modes)
+void Application::waitForFrame(uint64_t frameValue)
 {
-	for (const auto& mode : modes)
+	if (frameValue == 0 || frameValue <= completedFrame)
+		return;
+
+	if (timelineSemaphoreSupported)
 	{
-		if (mode == vk::PresentModeKHR::eMailbox)
-			return mode;
+		auto waitInfo = vk::SemaphoreWaitInfo()
+			.setSemaphoreCount(1)
+			.setPSemaphores(&frameTimeline)
+			.setPValues(&frameValue);
+		device.waitSemaphores(waitInfo, UINT64_MAX);
 	}
-	return vk::PresentModeKHR::eFifo;
+	else
+	{
+		// A slot is always waited on before it is reused, so if it now holds a newer frame this one has completed
+		uint32_t slot = static_cast<uint32_t>((frameValue - 1) % options.framesInFlight);
+		if (frameSlotValues[slot] == frameValue)
+			device.waitForFences({ inFlightFences[slot] }, VK_TRUE, UINT64_MAX);
+	}
+	completedFrame = frameValue;
 }
 
-vk::Extent2D Application::selectSwapchainExtent(const vk::SurfaceCapabilitiesKHR& capabilities)
+void Application::printLatencyReport()
 {
-	if (capabilities.currentExtent.width != UINT32_MAX)
-		return capabilities.currentExtent;
-	
-	int width, height;
-	glfwGetFramebufferSize(window, &width, &height);
-
-	auto actualExtent = vk::Extent2D()
-		.setWidth(static_cast<uint32_t>(width))
-		.setHeight(static_cast<uint32_t>(height));
+	frameReport.latencyMs = profiler.averageLatencyMs();
+	if (!profiler.hasGpuTimings())
+		return;
 
-	actualExtent.width = std::max(
-		capabilities.minImageExtent.width,
-		std::min(capabilities.maxImageExtent.width, actualExtent.width));
-	actualExtent.height = std::max(
-		capabilities.minImageExtent.height,
-		std::min(capabilities.maxImageExtent.height, actualExtent.height));
+	std::cout << "[Latency] " << (options.headless ? "offscreen" : vk::to_string(windows[0]->presentMode()))
+		<< ", pacing " << (pacer.isEnabled() ? "on" : "off") << "\n"
+		<< "\t--frame start to GPU completion: " << frameReport.latencyMs << " ms\n";
+	if (pacer.isEnabled())
+		std::cout << "\t--average pacing delay: " << pacer.averageDelayMs() << " ms\n";
+}
 
-	return actualExtent;
+void Application::exportProfile()
+{
+	if (!options.traceOutput.empty() && profiler.exportChromeTrace(options.traceOutput))
+		std::cout << "[Profiler] Wrote " << profiler.frameCount() << " frames to " << options.traceOutput << "\n";
+	if (!options.csvOutput.empty() && profiler.exportCsv(options.csvOutput))
+		std::cout << "[Profiler] Wrote " << profiler.frameCount() << " frames to " << options.csvOutput << "\n";
 }
 
-std::vector<char> Application::readShader(const std::string& filename)
+bool Application::isFrameComplete(uint64_t frameValue)
 {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	if (frameValue == 0 || frameValue <= completedFrame)
+		return true;
 
-	if (!file.is_open())
-		throw std::runtime_error("[Error] Unable to read file: " + filename);
+	bool complete = false;
+	if (timelineSemaphoreSupported)
+		complete = device.getSemaphoreCounterValue(frameTimeline) >= frameValue;
+	else
+	{
+		uint32_t slot = static_cast<uint32_t>((frameValue - 1) % options.framesInFlight);
+		complete = frameSlotValues[slot] != frameValue || device.getFenceStatus(inFlightFences[slot]) == vk::Result::eSuccess;
+	}
 
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> ret(fileSize);
-	file.seekg(0);
-	file.read(ret.data(), fileSize);
-	file.close();
+	if (complete)
+		completedFrame = frameValue;
+	return complete;
+}
 
-	return ret;
+uint64_t Application::pollCompletedFrame()
+{
+	if (timelineSemaphoreSupported)
+		completedFrame = std::max(completedFrame, device.getSemaphoreCounterValue(frameTimeline));
+	else
+	{
+		// Fences only answer for their own frame, so step forward until one is still running
+		while (completedFrame < frameNumber)
+		{
+			if (!isFrameComplete(completedFrame + 1))
+				break;
+		}
+	}
+	return completedFrame;
 }
 
-vk::ShaderModule Application::createShaderModule(const std::vector<char>& code)
+std::optional<QueueFamilyIndices> Application::findQueueFamilies(vk::PhysicalDevice device)
 {
-	auto createInfo = vk::ShaderModuleCreateInfo()
-		.setCodeSize(code.size())
-		.setPCode(reinterpret_cast<const uint32_t*>(code.data()));
+	auto queueFamilies = device.getQueueFamilyProperties();
+	QueueFamilyIndices indices;
+
+	for (uint32_t i = 0; i < queueFamilies.size(); i++)
+	{
+		auto flags = queueFamilies[i].queueFlags;
+		bool present = options.headless || device.getSurfaceSupportKHR(i, windows[0]->surface());
 
-	return device.createShaderModule(createInfo);
+		// A graphics family that can also present is preferred over any split
+		if ((flags & vk::QueueFlagBits::eGraphics) && (indices.graphics == UINT32_MAX || (present && indices.present != indices.graphics)))
+		{
+			indices.graphics = i;
+			if (present)
+				indices.present = i;
+		}
+		if (present && indices.present == UINT32_MAX)
+			indices.present = i;
+
+		if ((flags & vk::QueueFlagBits::eCompute) && !(flags & vk::QueueFlagBits::eGraphics) && indices.compute == UINT32_MAX)
+			indices.compute = i;
+		if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)) &&
+			indices.transfer == UINT32_MAX)
+			indices.transfer = i;
+	}
+
+	if (indices.graphics == UINT32_MAX || indices.present == UINT32_MAX)
+		return std::nullopt;
+
+	// Graphics families support compute and transfer as well, so they stand in for missing or disabled ones
+	if (indices.compute == UINT32_MAX || !options.asyncCompute)
+		indices.compute = indices.graphics;
+	if (indices.transfer == UINT32_MAX || !options.dedicatedTransfer)
+		indices.transfer = indices.graphics;
+	return indices;
 }
 
-vk::ShaderModule Application::createShaderModule(const std::string& filename)
+vk::PresentModeKHR Application::requestedPresentMode() const
 {
-	auto code = readShader(filename);
-	return createShaderModule(code);
+	switch (options.presentPolicy)
+	{
+	case PresentPolicy::Immediate: return vk::PresentModeKHR::eImmediate;
+	case PresentPolicy::Mailbox: return vk::PresentModeKHR::eMailbox;
+	case PresentPolicy::Fifo: return vk::PresentModeKHR::eFifo;
+	case PresentPolicy::FifoRelaxed: return vk::PresentModeKHR::eFifoRelaxed;
+	}
+	return vk::PresentModeKHR::eFifo;
 }
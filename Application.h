@@ -4,88 +4,427 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "DeletionQueue.h"
+#include "Descriptors.h"
+#include "DeviceSelector.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "FrameProfiler.h"
+#include "InstanceCuller.h"
+#include "MemoryAllocator.h"
+#include "MeshFile.h"
+#include "PipelineCache.h"
+#include "PipelineRegistry.h"
+#include "PostProcess.h"
+#include "RenderGraph.h"
+#include "ShaderLibrary.h"
+#include "Sync.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include "TripleBuffer.h"
+#include "UploadManager.h"
+#include "Vertex.h"
+#include "Window.h"
+
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
 #include <optional>
 #include <fstream>
 #include <vector>
 #include <tuple>
 #include <set>
 
+enum class PresentPolicy
+{
+	// Lowest latency, may tear
+	Immediate,
+	// Low latency without tearing, renders frames that are never shown
+	Mailbox,
+	// Throughput and power friendly, up to a full queue of frames of latency
+	Fifo,
+	// FIFO that tears instead of waiting when a frame misses its vblank
+	FifoRelaxed
+};
+
+struct AppOptions
+{
+	// Render into device-owned images instead of a swapchain; no window or surface is created
+	bool headless = false;
+	uint32_t headlessFrames = 1000;
+	// Device index, type (discrete, integrated, virtual, cpu) or name substring, overrides scoring; falls back to the VKTRY_DEVICE environment variable
+	std::string devicePreference;
+	// Remembers the selected device for the current set of GPUs and drivers, empty disables
+	std::string deviceCachePath = "device_cache.txt";
+	// Use compute-only and transfer-only queue families when the device has them
+	bool asyncCompute = true;
+	bool dedicatedTransfer = true;
+	// Number of frames the CPU may record ahead of the GPU
+	uint32_t framesInFlight = 2;
+	// Empty disables the on-disk pipeline cache
+	std::string pipelineCachePath = "pipeline_cache.bin";
+	// Staging memory available to uploads per frame in flight
+	vk::DeviceSize stagingBufferSize = 8ull << 20;
+	// Draw calls recorded per frame, spread over the recording threads
+	uint32_t drawCount = 1;
+	// Non-zero tessellates each scene mesh into a disk of this many triangles
+	uint32_t meshTriangles = 0;
+	// Cooked mesh file (vktry_meshcook) replacing the generated scene meshes
+	std::string meshPath;
+	// 0 uses one recording thread per hardware thread
+	uint32_t recordThreads = 0;
+	// Non-zero switches to GPU-driven rendering: compute frustum culling and indirect draws
+	uint32_t instanceCount = 0;
+	// Pipelines compile on their own threads, 0 leaves one hardware thread free
+	uint32_t compileThreads = 0;
+	// Material pipeline variants requested at startup, draws cycle through them
+	uint32_t materialCount = 1;
+	// Packed SPIR-V archive; shaders missing from it are loaded from shaderDirectory
+	std::string shaderArchivePath = "res/shaders.pak";
+	std::string shaderDirectory = "res/shaders/";
+	// KTX2 files assigned to the materials in turn, streamed within textureBudget of device memory
+	std::vector<std::string> texturePaths;
+	vk::DeviceSize textureBudget = 256ull << 20;
+	// Windows showing the same scene, rendered by one submission and presented together
+	uint32_t windowCount = 1;
+	// Frames are recorded and presented on their own thread while the main thread handles events and simulates
+	bool renderThread = true;
+	// Fixed simulation tick, independent of the display rate
+	double simulationRate = 60.0;
+	// Falls back to FIFO, which is always available, when the surface lacks the requested mode
+	PresentPolicy presentPolicy = PresentPolicy::Mailbox;
+	// Render the scene in HDR, then bloom, auto exposure and tonemapping in compute before the copy to each target
+	bool postProcess = true;
+	// Off forces the bloom downsample onto its sampler-only path, without shared memory
+	bool tiledDownsample = true;
+	// Delay frame starts to cut input latency, needs profiling for its GPU timings
+	bool framePacing = false;
+	double pacingMarginMs = 1.0;
+	// CPU phase and GPU timestamp spans per frame; the outputs are written on exit when non-empty
+	bool profiling = true;
+	std::string traceOutput;
+	std::string csvOutput;
+	// Non-empty copies every rendered frame back and writes it to this directory
+	std::string captureDirectory;
+	CaptureFormat captureFormat = CaptureFormat::Png;
+};
+
+struct QueueFamilyIndices
+{
+	uint32_t graphics = UINT32_MAX;
+	uint32_t present = UINT32_MAX;
+	// Equal to graphics when the device has no separate family or it is disabled
+	uint32_t compute = UINT32_MAX;
+	uint32_t transfer = UINT32_MAX;
+
+	bool asyncCompute() const { return compute != graphics; }
+	bool dedicatedTransfer() const { return transfer != graphics; }
+};
+
+// Simulation state handed from the main thread to the renderer, immutable once published.
+// Per-object transforms are derived from it while recording, so a snapshot stays small whatever the draw count.
+struct FrameSnapshot
+{
+	uint64_t tick = 0;
+	double seconds = 0.0;
+	glm::mat4 viewProj = glm::mat4(1.0f);
+};
+
+// Set 1 of the scene pipelines, written once per frame into a transient set
+struct FrameConstants
+{
+	glm::mat4 viewProj;
+};
+
+// Set 1 binding 1, a dynamic uniform buffer; every draw binds the set again at its own object's offset
+struct ObjectConstants
+{
+	glm::mat4 model;
+};
+
+// Per-draw push constants; resources are reached through bindless indices rather than rebinding sets
+struct DrawConstants
+{
+	uint32_t materialBuffer;
+	uint32_t material;
+	uint32_t texture;
+	uint32_t sampler;
+};
+
+struct FrameReport
+{
+	uint32_t frames = 0;
+	double seconds = 0.0;
+	double framesPerSecond = 0.0;
+	double cpuMsPerFrame = 0.0;
+	double gpuMsPerFrame = 0.0;
+	double latencyMs = 0.0;
+	// Recording time over all threads per draw, or per instance with GPU-driven rendering
+	double recordNsPerDraw = 0.0;
+	double submitMs = 0.0;
+	// Zero when headless, nothing is presented
+	double presentMs = 0.0;
+	vk::DeviceSize peakDeviceBytes = 0;
+};
+
 class Application
 {
 public:
-	Application(const std::string& name, int width, int height);
+	Application(const std::string& name, int width, int height, const AppOptions& options = AppOptions());
 	~Application();
 	int run();
 
+	const FrameReport& report() const { return frameReport; }
+
 private:
 	void setupWindow();
 	void setupVulkan();
 	void mainLoop();
+	void simulationLoop();
+	void renderLoop();
+	int runHeadless();
 	void cleanUp();
 
 	void createInstance();
 	void createSurface();
 	void selectPhysicalDevice();
 	void createLogicalDevice();
-	void createSwapchain();
-	void createImageViews();
-	void createRenderPass();
+	void createSwapchains();
+	void recreateSwapchain(Window& window);
+	void createOffscreenTargets();
+	void createRenderGraph();
+	// Largest target, the graph's transients cover every one of them
+	vk::Extent2D renderExtent() const;
 	void createGraphicsPipeline();
-	void createFramebuffers();
+	void createDescriptors();
 	void createCommandPool();
+	void createSceneGeometry();
+	void createGeometryBuffers();
+	void createTextures();
+	void createInstanceCulling();
+	void generateInstances();
 	void createCommandBuffers();
+	vk::CommandBuffer recordCommandBuffer();
+	void recordDraws(vk::CommandBuffer commandBuffer, const vk::CommandBufferInheritanceInfo& inheritanceInfo, vk::Extent2D extent,
+		uint32_t firstDraw, uint32_t lastDraw);
+	void recordIndirectDraw(vk::CommandBuffer commandBuffer, const vk::CommandBufferInheritanceInfo& inheritanceInfo, vk::Extent2D extent);
+	void setViewportAndScissor(vk::CommandBuffer commandBuffer, vk::Extent2D extent);
+	void updateFrameDescriptors();
+	void updateObjectConstants();
+	void bindDescriptors(vk::CommandBuffer commandBuffer, uint32_t object = 0);
+	uint32_t objectOffset(uint32_t object) const { return static_cast<uint32_t>(objectBase + object * objectStride); }
+	void pushDrawConstants(vk::CommandBuffer commandBuffer, uint32_t material);
+	void printRecordingReport();
 	void createSyncObjects();
 
-	void drawFrame();
-
-	bool isDeviceAvailable(vk::PhysicalDevice device);
-	std::optional<std::pair<uint32_t, uint32_t>> findQueueFamilies(vk::PhysicalDevice device);
-	bool checkDeviceExtensionSupport(vk::PhysicalDevice device);
+	void updateSimulation();
+	void consumeSnapshot();
+	void printThreadReport();
 
-	vk::SurfaceFormatKHR selectSwapchainSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& formats);
-	vk::PresentModeKHR selectSwapchainPresentMode(const std::vector<vk::PresentModeKHR>& modes);
-	vk::Extent2D selectSwapchainExtent(const vk::SurfaceCapabilitiesKHR& capabilities);
+	void drawFrame();
+	void drawOffscreenFrame();
+	void flushUploads(std::vector<SemaphoreWait>& waits);
+	void submitFrame(vk::CommandBuffer commandBuffer, const std::vector<SemaphoreWait>& waits, const std::vector<vk::Semaphore>& signalSemaphores,
+		uint64_t frameValue);
+	void presentFrame();
+	void waitForFrame(uint64_t frameValue);
+	bool isFrameComplete(uint64_t frameValue);
+	// Latest frame value known to have completed, without blocking
+	uint64_t pollCompletedFrame();
+	void exportProfile();
+	void printLatencyReport();
 
-	std::vector<char> readShader(const std::string& filename);
-	vk::ShaderModule createShaderModule(const std::vector<char>& code);
-	vk::ShaderModule createShaderModule(const std::string& filename);
+	std::optional<QueueFamilyIndices> findQueueFamilies(vk::PhysicalDevice device);
+	vk::PresentModeKHR requestedPresentMode() const;
 
 protected:
 	int windowWidth;
 	int windowHeight;
-	bool shouldTerminate = false;
-	GLFWwindow* window;
+	// Also set by the render thread when it fails
+	std::atomic<bool> shouldTerminate{ false };
+	// The first window selects the present family and surface format, and is the one captured.
+	// Held by pointer, GLFW keeps their addresses as user pointers.
+	std::vector<std::unique_ptr<Window>> windows;
 
 private:
 	std::string appName;
+	AppOptions options;
+	std::chrono::steady_clock::time_point startTime;
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0;
 	vk::Instance instance;
 
 	vk::PhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	// Lower of the instance and device versions, what device-level features may be used at
+	uint32_t apiVersion = VK_API_VERSION_1_0;
 	vk::Device device;
+	vk::PhysicalDeviceVulkan12Features features12;
+	bool timelineSemaphoreSupported = false;
+	bool multiDrawIndirectSupported = false;
+	bool descriptorIndexingSupported = false;
+	MemoryAllocator allocator;
+	// Everything retired at runtime; drained at the start of each frame and flushed once in cleanUp
+	DeletionQueue deletions;
 
+	QueueFamilyIndices queueFamilies;
 	vk::Queue graphicsQueue;
 	vk::Queue presentQueue;
+	vk::Queue computeQueue;
+	vk::Queue transferQueue;
 
-	vk::SurfaceKHR surface;
+	// Every window and the offscreen targets share one format, so a single set of pipelines draws into all of them
+	vk::Format targetFormat = vk::Format::eUndefined;
+	// Headless only, one render target per frame in flight
+	vk::Extent2D offscreenExtent;
+	std::vector<vk::Image> offscreenImages;
+	std::vector<vk::ImageView> offscreenImageViews;
+	std::vector<MemoryAllocation> offscreenImageAllocations;
 
-	vk::SwapchainKHR swapchain;
-	vk::Format swapchainImageFormat;
-	vk::Extent2D swapchainExtent;
-	std::vector<vk::Image> swapchainImages;
-	std::vector<vk::ImageView> swapchainImageViews;
+	BindlessDescriptors bindless;
+	FrameDescriptorAllocator frameDescriptors;
+	vk::DescriptorSetLayout frameSetLayout;
+	// Allocated before the recording jobs start, which only bind it
+	vk::DescriptorSet frameSet;
+	// Holds the frame constants followed by the object constants of every draw, one segment per frame in flight
+	BufferRing frameConstants;
+	glm::mat4 viewProj = glm::mat4(1.0f);
+	// Draws without GPU culling each get an object, the indirect draw shares a single one
+	uint32_t objectCount = 1;
+	// sizeof(ObjectConstants) rounded up to minUniformBufferOffsetAlignment
+	vk::DeviceSize objectStride = 0;
+	// Ring offset of this frame's first object
+	vk::DeviceSize objectBase = 0;
 
 	vk::PipelineLayout pipelineLayout;
-	vk::RenderPass renderPass;
-	vk::Pipeline graphicsPipeline;
-	std::vector<vk::Framebuffer> swapchainFramebuffers;
+	// Culling and one scene pass per window; each window's acquired image is imported into it every frame
+	RenderGraph graph;
+	// One per window, or the offscreen target when headless. Targets left without an image this frame
+	// (minimized or out of date) have their scene pass skipped by the graph, and their post-processing disabled.
+	struct RenderTarget
+	{
+		RenderResource backbuffer = INVALID_RESOURCE;
+		uint32_t scenePass = 0;
+		// Index within postProcess when the scene goes through it
+		uint32_t post = UINT32_MAX;
+		vk::Image image;
+		vk::ImageView view;
+		vk::Extent2D extent;
+	};
+	std::vector<RenderTarget> targets;
+	// Secondaries recorded this frame per target, executed by its scene pass
+	uint32_t sceneJobCount = 0;
+	FrameCapture capture;
+	bool capturing = false;
+	PipelineRegistry pipelines;
+	PipelineHandle scenePipeline = INVALID_PIPELINE;
+	std::vector<PipelineHandle> materialPipelines;
+	PipelineCache pipelineCache;
+	ShaderLibrary shaders;
+
+	// Every recording thread has a pool of its own per frame in flight, reset once per frame, and records all the
+	// secondaries it is handed from it. Target t's job j leaves its buffer at secondaries[t * workers + j].
+	struct WorkerCommands
+	{
+		vk::CommandPool pool;
+		// Allocated on demand and reused after the reset
+		std::vector<vk::CommandBuffer> buffers;
+		uint32_t used = 0;
+	};
+	struct FrameCommands
+	{
+		vk::CommandPool primaryPool;
+		vk::CommandBuffer primary;
+		std::vector<WorkerCommands> workers;
+		std::vector<vk::CommandBuffer> secondaries;
+	};
+	std::vector<FrameCommands> frameCommands;
+
+	// Culling runs on the compute queue when there is a separate compute family
+	bool asyncCulling = false;
+	struct ComputeCommands
+	{
+		vk::CommandPool pool;
+		vk::CommandBuffer commandBuffer;
+		vk::Semaphore finished;
+	};
+	std::vector<ComputeCommands> computeCommands;
+	std::unique_ptr<ThreadPool> workerPool;
+	// Accumulated recording time per worker thread
+	std::vector<double> recordSeconds;
+	uint64_t recordedFrames = 0;
+
+	UploadManager uploader;
+	std::vector<Vertex> sceneVertices;
+	std::vector<uint32_t> sceneIndices;
+	std::vector<MeshRange> sceneMeshes;
+	// Set while a cooked mesh is loaded; the uploads keep the mapping alive until they have been staged
+	std::shared_ptr<MeshFile> sceneMeshFile;
+	vk::VertexInputBindingDescription sceneVertexBinding;
+	std::vector<vk::VertexInputAttributeDescription> sceneVertexAttributes;
+	vk::IndexType sceneIndexType = vk::IndexType::eUint32;
+	// Dequantizes cooked positions and fits them into the unit square the generated meshes occupy
+	glm::mat4 meshTransform = glm::mat4(1.0f);
+	vk::Buffer vertexBuffer;
+	vk::Buffer indexBuffer;
+	MemoryAllocation vertexAllocation;
+	MemoryAllocation indexAllocation;
+	// Per-material tints, read through the bindless set
+	vk::Buffer materialBuffer;
+	MemoryAllocation materialAllocation;
+	uint32_t materialBufferIndex = 0;
 
-	vk::CommandPool commandPool;
-	std::vector<vk::CommandBuffer> commandBuffers;
+	TextureStreamer textures;
+	std::vector<TextureHandle> materialTextures;
+	// Bindless indices of the material textures, resolved once per frame for the recording jobs
+	std::vector<uint32_t> materialTextureIndices;
+	vk::Sampler textureSampler;
+	uint32_t samplerIndex = 0;
 
-	std::vector<vk::Semaphore> imageAvailableSemaphores;
-	std::vector<vk::Semaphore> renderFinishedSemaphores;
+	std::vector<InstanceData> instances;
+	InstanceCuller culler;
+	// Off when the option is, or when a swapchain cannot be copied into
+	bool postProcessing = false;
+	PostProcess postProcess;
+
+	// Only used when timeline semaphores are unavailable
 	std::vector<vk::Fence> inFlightFences;
-	std::vector<vk::Fence> imagesInFlight;
+
+	// Frames are numbered from 1; frameTimeline reaches N once frame N has finished on the GPU
+	vk::Semaphore frameTimeline;
+	uint64_t frameNumber = 0;
+	uint64_t completedFrame = 0;
+	std::vector<uint64_t> frameSlotValues;
 	int currentFrame = 0;
+
+	// Filled by updateSimulation on the main thread, drawn by whichever thread renders
+	TripleBuffer<FrameSnapshot> snapshots;
+	FrameSnapshot simulation;
+	std::chrono::steady_clock::duration tickDuration;
+	std::chrono::steady_clock::time_point nextTick;
+	std::thread renderer;
+	std::atomic<bool> rendering{ false };
+	std::exception_ptr renderError;
+	// Each field is only written by one thread: ticks and late time by the main thread, the rest by the renderer
+	struct ThreadStats
+	{
+		uint64_t ticks = 0;
+		uint64_t droppedTicks = 0;
+		double lateSeconds = 0.0;
+		double maxLateSeconds = 0.0;
+		uint64_t frames = 0;
+		uint64_t staleFrames = 0;
+		double waitSeconds = 0.0;
+	};
+	ThreadStats threadStats;
+
+	FrameProfiler profiler;
+	FramePacer pacer;
+	FrameReport frameReport;
+	double cpuFrameSeconds = 0.0;
 };
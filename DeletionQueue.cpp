@@ -0,0 +1,139 @@
+#include "DeletionQueue.h"
+
+#include <algorithm>
+#include <iostream>
+
+template <typename Handle>
+static Handle handleOf(uint64_t handle)
+{
+	return Handle((typename Handle::CType)handle);
+}
+
+void DeletionQueue::init(vk::Device device, MemoryAllocator& allocator)
+{
+	this->device = device;
+	this->allocator = &allocator;
+}
+
+void DeletionQueue::free(const MemoryAllocation& allocation)
+{
+	if (!allocation)
+		return;
+	Entry entry;
+	entry.frame = currentFrame;
+	entry.allocation = allocation;
+	push(std::move(entry));
+}
+
+void DeletionQueue::release(std::function<void()> callback)
+{
+	Entry entry;
+	entry.frame = currentFrame;
+	entry.callback = std::move(callback);
+	push(std::move(entry));
+}
+
+void DeletionQueue::collect(uint64_t completedValue)
+{
+	// Tags never decrease, so the first entry still in use ends the batch
+	if (entries.empty() || entries.front().frame > completedValue)
+		return;
+
+	while (!entries.empty() && entries.front().frame <= completedValue)
+	{
+		releaseEntry(entries.front());
+		entries.pop_front();
+	}
+	batches++;
+}
+
+void DeletionQueue::flush()
+{
+	while (!entries.empty())
+	{
+		releaseEntry(entries.front());
+		entries.pop_front();
+	}
+}
+
+void DeletionQueue::printStats() const
+{
+	std::cout << "[Deletion] " << released << " objects released in " << batches << " batches, at most "
+		<< peakPending << " pending\n";
+}
+
+void DeletionQueue::push(Entry&& entry)
+{
+	entries.push_back(std::move(entry));
+	peakPending = std::max(peakPending, entries.size());
+}
+
+void DeletionQueue::releaseEntry(Entry& entry)
+{
+	switch (entry.type)
+	{
+	case vk::ObjectType::eImage:
+		device.destroyImage(handleOf<vk::Image>(entry.handle));
+		break;
+	case vk::ObjectType::eImageView:
+		device.destroyImageView(handleOf<vk::ImageView>(entry.handle));
+		break;
+	case vk::ObjectType::eBuffer:
+		device.destroyBuffer(handleOf<vk::Buffer>(entry.handle));
+		break;
+	case vk::ObjectType::eBufferView:
+		device.destroyBufferView(handleOf<vk::BufferView>(entry.handle));
+		break;
+	case vk::ObjectType::eSampler:
+		device.destroySampler(handleOf<vk::Sampler>(entry.handle));
+		break;
+	case vk::ObjectType::eFramebuffer:
+		device.destroyFramebuffer(handleOf<vk::Framebuffer>(entry.handle));
+		break;
+	case vk::ObjectType::eRenderPass:
+		device.destroyRenderPass(handleOf<vk::RenderPass>(entry.handle));
+		break;
+	case vk::ObjectType::ePipeline:
+		device.destroyPipeline(handleOf<vk::Pipeline>(entry.handle));
+		break;
+	case vk::ObjectType::ePipelineLayout:
+		device.destroyPipelineLayout(handleOf<vk::PipelineLayout>(entry.handle));
+		break;
+	case vk::ObjectType::ePipelineCache:
+		device.destroyPipelineCache(handleOf<vk::PipelineCache>(entry.handle));
+		break;
+	case vk::ObjectType::eShaderModule:
+		device.destroyShaderModule(handleOf<vk::ShaderModule>(entry.handle));
+		break;
+	case vk::ObjectType::eDescriptorPool:
+		device.destroyDescriptorPool(handleOf<vk::DescriptorPool>(entry.handle));
+		break;
+	case vk::ObjectType::eDescriptorSetLayout:
+		device.destroyDescriptorSetLayout(handleOf<vk::DescriptorSetLayout>(entry.handle));
+		break;
+	case vk::ObjectType::eCommandPool:
+		device.destroyCommandPool(handleOf<vk::CommandPool>(entry.handle));
+		break;
+	case vk::ObjectType::eQueryPool:
+		device.destroyQueryPool(handleOf<vk::QueryPool>(entry.handle));
+		break;
+	case vk::ObjectType::eFence:
+		device.destroyFence(handleOf<vk::Fence>(entry.handle));
+		break;
+	case vk::ObjectType::eSemaphore:
+		device.destroySemaphore(handleOf<vk::Semaphore>(entry.handle));
+		break;
+	case vk::ObjectType::eSwapchainKHR:
+		device.destroySwapchainKHR(handleOf<vk::SwapchainKHR>(entry.handle));
+		break;
+	case vk::ObjectType::eUnknown:
+		if (entry.allocation)
+			allocator->free(entry.allocation);
+		if (entry.callback)
+			entry.callback();
+		break;
+	default:
+		throw std::runtime_error("[Error] Deletion queue cannot destroy " + vk::to_string(entry.type));
+	}
+	released++;
+}
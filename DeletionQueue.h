@@ -0,0 +1,69 @@
+#pragma once
+
+#include "MemoryAllocator.h"
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Holds handles and memory sub-allocations that frames still in flight may use. Each entry is tagged with the
+// value of the frame being recorded when it was retired, the last one that can reference it, and is released in a
+// batch at the start of a later frame once that value has completed, so nothing mid-run waits for the device to idle.
+// Entries are kept in retirement order, which is also the order flush() releases them in.
+class DeletionQueue
+{
+public:
+	void init(vk::Device device, MemoryAllocator& allocator);
+
+	// Retirements are tagged with this value until the next call
+	void setFrame(uint64_t frameValue) { currentFrame = frameValue; }
+
+	// Any handle type with a vkDestroy* function taking the device
+	template <typename Handle>
+	void destroy(Handle handle)
+	{
+		if (!handle)
+			return;
+		Entry entry;
+		entry.frame = currentFrame;
+		entry.type = Handle::objectType;
+		entry.handle = (uint64_t)static_cast<typename Handle::CType>(handle);
+		push(std::move(entry));
+	}
+	void free(const MemoryAllocation& allocation);
+	// Anything else, such as returning an index to a free list
+	void release(std::function<void()> callback);
+
+	// Releases every entry whose frame is at or below completedValue, stopping at the first one that is not
+	void collect(uint64_t completedValue);
+	// Releases everything; the device must be idle
+	void flush();
+
+	size_t pending() const { return entries.size(); }
+	void printStats() const;
+
+private:
+	struct Entry
+	{
+		uint64_t frame = 0;
+		vk::ObjectType type = vk::ObjectType::eUnknown;
+		uint64_t handle = 0;
+		MemoryAllocation allocation;
+		std::function<void()> callback;
+	};
+
+	void push(Entry&& entry);
+	void releaseEntry(Entry& entry);
+
+private:
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	uint64_t currentFrame = 0;
+	std::deque<Entry> entries;
+
+	uint64_t released = 0;
+	uint64_t batches = 0;
+	size_t peakPending = 0;
+};
@@ -0,0 +1,248 @@
+#include "Descriptors.h"
+
+#include <algorithm>
+#include <iostream>
+
+void BindlessDescriptors::init(vk::Device device, vk::PhysicalDevice physicalDevice, bool descriptorIndexing, DeletionQueue& deletions,
+	uint32_t bufferCapacity, uint32_t imageCapacity, uint32_t samplerCapacity)
+{
+	this->device = device;
+	this->deletions = &deletions;
+	indexing = descriptorIndexing;
+
+	// Update-after-bind sets have their own, usually much higher, limits
+	auto limits = physicalDevice.getProperties().limits;
+	if (indexing)
+	{
+		auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>()
+			.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+		bufferCapacity = std::min({ bufferCapacity, properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+			properties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+		imageCapacity = std::min({ imageCapacity, properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			properties.maxDescriptorSetUpdateAfterBindSampledImages });
+		samplerCapacity = std::min({ samplerCapacity, properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+			properties.maxDescriptorSetUpdateAfterBindSamplers });
+	}
+	else
+	{
+		bufferCapacity = std::min({ bufferCapacity, limits.maxPerStageDescriptorStorageBuffers, limits.maxDescriptorSetStorageBuffers });
+		imageCapacity = std::min({ imageCapacity, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages });
+		samplerCapacity = std::min({ samplerCapacity, limits.maxPerStageDescriptorSamplers, limits.maxDescriptorSetSamplers });
+	}
+	slots[static_cast<uint32_t>(BindlessType::Buffer)].capacity = bufferCapacity;
+	slots[static_cast<uint32_t>(BindlessType::SampledImage)].capacity = imageCapacity;
+	slots[static_cast<uint32_t>(BindlessType::Sampler)].capacity = samplerCapacity;
+
+	vk::DescriptorType types[] = { vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eSampledImage, vk::DescriptorType::eSampler };
+
+	std::vector<vk::DescriptorSetLayoutBinding> bindings;
+	std::vector<vk::DescriptorPoolSize> poolSizes;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(BindlessType::Count); i++)
+	{
+		bindings.push_back(vk::DescriptorSetLayoutBinding()
+			.setBinding(i)
+			.setDescriptorType(types[i])
+			.setDescriptorCount(slots[i].capacity)
+			.setStageFlags(vk::ShaderStageFlagBits::eAll));
+		poolSizes.push_back(vk::DescriptorPoolSize(types[i], slots[i].capacity));
+	}
+
+	vk::DescriptorBindingFlags bindingFlags = vk::DescriptorBindingFlagBits::ePartiallyBound |
+		vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+	std::vector<vk::DescriptorBindingFlags> flags(bindings.size(), bindingFlags);
+
+	auto flagsInfo = vk::DescriptorSetLayoutBindingFlagsCreateInfo()
+		.setBindingCount(static_cast<uint32_t>(flags.size()))
+		.setPBindingFlags(flags.data());
+
+	auto setLayoutInfo = vk::DescriptorSetLayoutCreateInfo()
+		.setBindingCount(static_cast<uint32_t>(bindings.size()))
+		.setPBindings(bindings.data());
+
+	auto poolInfo = vk::DescriptorPoolCreateInfo()
+		.setMaxSets(1)
+		.setPoolSizeCount(static_cast<uint32_t>(poolSizes.size()))
+		.setPPoolSizes(poolSizes.data());
+
+	if (indexing)
+	{
+		setLayoutInfo.setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+			.setPNext(&flagsInfo);
+		poolInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind);
+	}
+
+	setLayout = device.createDescriptorSetLayout(setLayoutInfo);
+	pool = device.createDescriptorPool(poolInfo);
+
+	auto allocInfo = vk::DescriptorSetAllocateInfo()
+		.setDescriptorPool(pool)
+		.setDescriptorSetCount(1)
+		.setPSetLayouts(&setLayout);
+
+	set = device.allocateDescriptorSets(allocInfo)[0];
+
+	std::cout << "[Descriptors] Bindless set " << (indexing ? "enabled" : "unavailable, descriptor indexing not supported")
+		<< ": " << bufferCapacity << " buffers, " << imageCapacity << " images, " << samplerCapacity << " samplers\n";
+}
+
+void BindlessDescriptors::destroy()
+{
+	if (!device)
+		return;
+
+	deletions->destroy(pool);
+	deletions->destroy(setLayout);
+}
+
+uint32_t BindlessDescriptors::allocateSlot(BindlessType type)
+{
+	auto& typeSlots = slots[static_cast<uint32_t>(type)];
+	if (!typeSlots.freeList.empty())
+	{
+		uint32_t index = typeSlots.freeList.back();
+		typeSlots.freeList.pop_back();
+		return index;
+	}
+	if (typeSlots.next == typeSlots.capacity)
+		throw std::runtime_error("[Error] Bindless descriptor array is full");
+	return typeSlots.next++;
+}
+
+uint32_t BindlessDescriptors::addBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range)
+{
+	uint32_t index = allocateSlot(BindlessType::Buffer);
+
+	pendingBuffers.push_back(vk::DescriptorBufferInfo(buffer, offset, range));
+	pendingWrites.push_back(vk::WriteDescriptorSet()
+		.setDstSet(set)
+		.setDstBinding(static_cast<uint32_t>(BindlessType::Buffer))
+		.setDstArrayElement(index)
+		.setDescriptorCount(1)
+		.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+		.setPBufferInfo(&pendingBuffers.back()));
+	return index;
+}
+
+uint32_t BindlessDescriptors::addImage(vk::ImageView imageView, vk::ImageLayout layout)
+{
+	uint32_t index = allocateSlot(BindlessType::SampledImage);
+
+	pendingImages.push_back(vk::DescriptorImageInfo(VK_NULL_HANDLE, imageView, layout));
+	pendingWrites.push_back(vk::WriteDescriptorSet()
+		.setDstSet(set)
+		.setDstBinding(static_cast<uint32_t>(BindlessType::SampledImage))
+		.setDstArrayElement(index)
+		.setDescriptorCount(1)
+		.setDescriptorType(vk::DescriptorType::eSampledImage)
+		.setPImageInfo(&pendingImages.back()));
+	return index;
+}
+
+uint32_t BindlessDescriptors::addSampler(vk::Sampler sampler)
+{
+	uint32_t index = allocateSlot(BindlessType::Sampler);
+
+	pendingImages.push_back(vk::DescriptorImageInfo(sampler, VK_NULL_HANDLE, vk::ImageLayout::eUndefined));
+	pendingWrites.push_back(vk::WriteDescriptorSet()
+		.setDstSet(set)
+		.setDstBinding(static_cast<uint32_t>(BindlessType::Sampler))
+		.setDstArrayElement(index)
+		.setDescriptorCount(1)
+		.setDescriptorType(vk::DescriptorType::eSampler)
+		.setPImageInfo(&pendingImages.back()));
+	return index;
+}
+
+void BindlessDescriptors::remove(BindlessType type, uint32_t index)
+{
+	// Partially bound slots need no rewrite, the stale descriptor is simply never indexed again.
+	// The index returns to the free list once the frames that could still reference it have completed.
+	auto& freeList = slots[static_cast<uint32_t>(type)].freeList;
+	deletions->release([&freeList, index]() { freeList.push_back(index); });
+}
+
+void BindlessDescriptors::update()
+{
+	if (pendingWrites.empty())
+		return;
+
+	device.updateDescriptorSets(pendingWrites, nullptr);
+	pendingWrites.clear();
+	pendingBuffers.clear();
+	pendingImages.clear();
+}
+
+void BindlessDescriptors::bind(vk::CommandBuffer commandBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout) const
+{
+	commandBuffer.bindDescriptorSets(bindPoint, pipelineLayout, SET, set, nullptr);
+}
+
+void FrameDescriptorAllocator::init(vk::Device device, uint32_t framesInFlight, const std::vector<vk::DescriptorPoolSize>& poolSizes, uint32_t setsPerPool)
+{
+	this->device = device;
+	this->setsPerPool = setsPerPool;
+
+	sizes = poolSizes;
+	for (auto& size : sizes)
+		size.descriptorCount *= setsPerPool;
+
+	frames.resize(framesInFlight);
+	for (auto& frame : frames)
+		frame.pools.push_back(createPool());
+}
+
+void FrameDescriptorAllocator::destroy(DeletionQueue& deletions)
+{
+	for (auto& frame : frames)
+	{
+		for (auto pool : frame.pools)
+			deletions.destroy(pool);
+	}
+	frames.clear();
+}
+
+vk::DescriptorPool FrameDescriptorAllocator::createPool()
+{
+	auto poolInfo = vk::DescriptorPoolCreateInfo()
+		.setMaxSets(setsPerPool)
+		.setPoolSizeCount(static_cast<uint32_t>(sizes.size()))
+		.setPPoolSizes(sizes.data());
+
+	return device.createDescriptorPool(poolInfo);
+}
+
+void FrameDescriptorAllocator::beginFrame(uint32_t frameSlot)
+{
+	this->frameSlot = frameSlot;
+
+	auto& frame = frames[frameSlot];
+	for (size_t i = 0; i <= frame.current && i < frame.pools.size(); i++)
+		device.resetDescriptorPool(frame.pools[i]);
+	frame.current = 0;
+}
+
+vk::DescriptorSet FrameDescriptorAllocator::allocate(vk::DescriptorSetLayout layout)
+{
+	auto& frame = frames[frameSlot];
+
+	auto allocInfo = vk::DescriptorSetAllocateInfo()
+		.setDescriptorSetCount(1)
+		.setPSetLayouts(&layout);
+
+	while (true)
+	{
+		allocInfo.setDescriptorPool(frame.pools[frame.current]);
+
+		vk::DescriptorSet set;
+		auto result = device.allocateDescriptorSets(&allocInfo, &set);
+		if (result == vk::Result::eSuccess)
+			return set;
+		if (result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool)
+			throw std::runtime_error("[Error] Failed to allocate a frame descriptor set");
+
+		// Pools beyond the first stay with the slot, a frame that needed them once likely will again
+		frame.current++;
+		if (frame.current == frame.pools.size())
+			frame.pools.push_back(createPool());
+	}
+}
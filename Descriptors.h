@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <deque>
+#include <vector>
+
+#include "DeletionQueue.h"
+
+enum class BindlessType : uint32_t
+{
+	Buffer,
+	SampledImage,
+	Sampler,
+	Count
+};
+
+// One global set of large storage buffer, sampled image and sampler arrays, bound once per command buffer.
+// Resources are registered once and addressed by index from push constants, so a draw costs the same
+// no matter how many resources exist. With descriptor indexing the set is update-after-bind and partially
+// bound: changed slots are written incrementally while in-flight frames keep using the others.
+class BindlessDescriptors
+{
+public:
+	static constexpr uint32_t SET = 0;
+
+	void init(vk::Device device, vk::PhysicalDevice physicalDevice, bool descriptorIndexing, DeletionQueue& deletions,
+		uint32_t bufferCapacity = 4096, uint32_t imageCapacity = 4096, uint32_t samplerCapacity = 64);
+	void destroy();
+
+	uint32_t addBuffer(vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE);
+	uint32_t addImage(vk::ImageView imageView, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+	uint32_t addSampler(vk::Sampler sampler);
+	// The slot is reused once every frame that could still reference it has completed
+	void remove(BindlessType type, uint32_t index);
+
+	// Writes the slots changed since the last call; once per frame, after the frame slot has been waited on
+	void update();
+	void bind(vk::CommandBuffer commandBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout pipelineLayout) const;
+
+	// Without descriptor indexing the set exists for layout compatibility only and must not be bound
+	bool available() const { return indexing; }
+	vk::DescriptorSetLayout layout() const { return setLayout; }
+	uint32_t capacity(BindlessType type) const { return slots[static_cast<uint32_t>(type)].capacity; }
+
+private:
+	struct Slots
+	{
+		uint32_t capacity = 0;
+		uint32_t next = 0;
+		std::vector<uint32_t> freeList;
+	};
+
+	uint32_t allocateSlot(BindlessType type);
+
+private:
+	vk::Device device;
+	vk::DescriptorSetLayout setLayout;
+	vk::DescriptorPool pool;
+	vk::DescriptorSet set;
+	bool indexing = false;
+	DeletionQueue* deletions = nullptr;
+
+	std::array<Slots, static_cast<size_t>(BindlessType::Count)> slots;
+
+	// Deques keep the infos referenced by pendingWrites in place while more are added
+	std::deque<vk::DescriptorBufferInfo> pendingBuffers;
+	std::deque<vk::DescriptorImageInfo> pendingImages;
+	std::vector<vk::WriteDescriptorSet> pendingWrites;
+};
+
+// Transient sets that live for a single frame. Each frame slot owns its pools, which are reset in bulk
+// when the slot comes around again instead of freeing sets one by one; a slot grows another pool when full.
+// Not thread safe, allocate before handing sets to recording jobs.
+class FrameDescriptorAllocator
+{
+public:
+	// poolSizes describe one set, each pool holds setsPerPool of them
+	void init(vk::Device device, uint32_t framesInFlight, const std::vector<vk::DescriptorPoolSize>& poolSizes, uint32_t setsPerPool = 64);
+	void destroy(DeletionQueue& deletions);
+
+	// Call once the frame slot's previous submission has completed
+	void beginFrame(uint32_t frameSlot);
+	vk::DescriptorSet allocate(vk::DescriptorSetLayout layout);
+
+private:
+	struct FramePools
+	{
+		std::vector<vk::DescriptorPool> pools;
+		size_t current = 0;
+	};
+
+	vk::DescriptorPool createPool();
+
+private:
+	vk::Device device;
+	std::vector<vk::DescriptorPoolSize> sizes;
+	uint32_t setsPerPool = 0;
+	std::vector<FramePools> frames;
+	uint32_t frameSlot = 0;
+};
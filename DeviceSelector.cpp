@@ -0,0 +1,264 @@
+#include "DeviceSelector.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+const uint32_t DEVICE_CACHE_VERSION = 1;
+
+DeviceSelector::DeviceSelector(vk::Instance instance, vk::SurfaceKHR surface, const std::vector<const char*>& requiredExtensions):
+	surface(surface), requiredExtensions(requiredExtensions)
+{
+	devices = instance.enumeratePhysicalDevices();
+	for (const auto& device : devices)
+		properties.push_back(device.getProperties());
+}
+
+vk::PhysicalDevice DeviceSelector::select(const std::string& preference, const std::string& cacheFile)
+{
+	std::cout << "[Number of Physical Devices] " << devices.size() << "\n";
+
+	if (auto cached = loadCached(cacheFile, preference))
+	{
+		std::cout << "[Device] Using cached selection: " << cached.getProperties().deviceName << "\n";
+		return cached;
+	}
+
+	vk::PhysicalDevice selected;
+	if (!preference.empty())
+	{
+		selected = matchPreference(preference);
+		if (selected)
+		{
+			auto candidate = score(selected, surface, requiredExtensions);
+			if (candidate.score < 0)
+			{
+				std::cout << "[Warning] Preferred device " << candidate.properties.deviceName << " is not usable (" << candidate.reason << ")\n";
+				selected = VK_NULL_HANDLE;
+			}
+		}
+		else
+			std::cout << "[Warning] No device matches preference \"" << preference << "\"\n";
+	}
+
+	if (!selected)
+	{
+		int64_t bestScore = -1;
+		for (const auto& device : devices)
+		{
+			auto candidate = score(device, surface, requiredExtensions);
+			std::cout << "\t--" << candidate.properties.deviceName << " (" << vk::to_string(candidate.properties.deviceType) << "): ";
+			if (candidate.score < 0)
+				std::cout << "unusable, " << candidate.reason << "\n";
+			else
+				std::cout << "score " << candidate.score << "\n";
+
+			if (candidate.score > bestScore)
+			{
+				bestScore = candidate.score;
+				selected = device;
+			}
+		}
+	}
+
+	if (!selected)
+		throw std::runtime_error("[Error] Failed to find any available physical device");
+
+	std::cout << "[Device] Selected " << selected.getProperties().deviceName << "\n";
+	saveCached(cacheFile, preference, selected);
+	return selected;
+}
+
+DeviceSelector::Candidate DeviceSelector::score(vk::PhysicalDevice device, vk::SurfaceKHR surface, const std::vector<const char*>& requiredExtensions)
+{
+	Candidate candidate;
+	candidate.device = device;
+	candidate.properties = device.getProperties();
+	const auto& limits = candidate.properties.limits;
+
+	// Requirements first: a graphics queue that can present, the required extensions and a usable surface
+	auto queueFamilies = device.getQueueFamilyProperties();
+	bool graphicsPresent = false;
+	bool asyncCompute = false;
+	bool dedicatedTransfer = false;
+	for (uint32_t i = 0; i < queueFamilies.size(); i++)
+	{
+		auto flags = queueFamilies[i].queueFlags;
+		if ((flags & vk::QueueFlagBits::eGraphics) && (!surface || device.getSurfaceSupportKHR(i, surface)))
+			graphicsPresent = true;
+		if ((flags & vk::QueueFlagBits::eCompute) && !(flags & vk::QueueFlagBits::eGraphics))
+			asyncCompute = true;
+		if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)))
+			dedicatedTransfer = true;
+	}
+	if (!graphicsPresent)
+	{
+		candidate.reason = surface ? "no graphics queue can present to the surface" : "no graphics queue";
+		return candidate;
+	}
+
+	std::set<std::string> missingExtensions(requiredExtensions.begin(), requiredExtensions.end());
+	for (const auto& extension : device.enumerateDeviceExtensionProperties())
+		missingExtensions.erase(extension.extensionName);
+	if (!missingExtensions.empty())
+	{
+		candidate.reason = "missing " + *missingExtensions.begin();
+		return candidate;
+	}
+
+	if (surface && (device.getSurfaceFormatsKHR(surface).empty() || device.getSurfacePresentModesKHR(surface).empty()))
+	{
+		candidate.reason = "no surface formats or present modes";
+		return candidate;
+	}
+
+	int64_t score = 0;
+	switch (candidate.properties.deviceType)
+	{
+	case vk::PhysicalDeviceType::eDiscreteGpu: score += 10000; break;
+	case vk::PhysicalDeviceType::eIntegratedGpu: score += 5000; break;
+	case vk::PhysicalDeviceType::eVirtualGpu: score += 2000; break;
+	case vk::PhysicalDeviceType::eCpu: score += 500; break;
+	default: break;
+	}
+
+	// One point per 64 MiB of the largest device-local heap; integrated parts report shared memory here, so it is capped
+	auto memoryProperties = device.getMemoryProperties();
+	vk::DeviceSize deviceLocalBytes = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		if (memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+			deviceLocalBytes = std::max(deviceLocalBytes, memoryProperties.memoryHeaps[i].size);
+	}
+	score += static_cast<int64_t>(std::min<vk::DeviceSize>(deviceLocalBytes >> 26, 2048));
+
+	score += limits.maxImageDimension2D / 1024;
+	score += limits.maxComputeWorkGroupInvocations / 64;
+	if (limits.timestampComputeAndGraphics)
+		score += 50;
+
+	auto features = device.getFeatures();
+	if (features.multiDrawIndirect)
+		score += 100;
+	if (candidate.properties.apiVersion >= VK_API_VERSION_1_2)
+		score += 200;
+
+	if (asyncCompute)
+		score += 200;
+	if (dedicatedTransfer)
+		score += 200;
+
+	candidate.score = score;
+	return candidate;
+}
+
+uint64_t DeviceSelector::fingerprint() const
+{
+	// Adding, removing or updating any device invalidates the cached choice
+	uint64_t hash = fnv1a64(&DEVICE_CACHE_VERSION, sizeof(DEVICE_CACHE_VERSION));
+	for (const auto& props : properties)
+	{
+		hashCombine(hash, props.vendorID);
+		hashCombine(hash, props.deviceID);
+		hashCombine(hash, props.driverVersion);
+		hashCombine(hash, props.apiVersion);
+		hashCombine(hash, fnv1a64(props.pipelineCacheUUID, VK_UUID_SIZE));
+	}
+	hashCombine(hash, surface ? 1 : 0);
+	return hash;
+}
+
+bool DeviceSelector::hasGraphicsPresentQueue(vk::PhysicalDevice device) const
+{
+	auto queueFamilies = device.getQueueFamilyProperties();
+	for (uint32_t i = 0; i < queueFamilies.size(); i++)
+	{
+		if ((queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics) && (!surface || device.getSurfaceSupportKHR(i, surface)))
+			return true;
+	}
+	return false;
+}
+
+vk::PhysicalDevice DeviceSelector::matchPreference(const std::string& preference) const
+{
+	// A plain number is an index into the enumeration order
+	if (std::all_of(preference.begin(), preference.end(), [](char c) { return c >= '0' && c <= '9'; }))
+	{
+		size_t index = std::stoul(preference);
+		return index < devices.size() ? devices[index] : VK_NULL_HANDLE;
+	}
+
+	std::string needle = preference;
+	std::transform(needle.begin(), needle.end(), needle.begin(), ::tolower);
+
+	// A device type picks the first device of that type, e.g. cpu for a software driver
+	const std::pair<const char*, vk::PhysicalDeviceType> types[] =
+	{
+		{ "discrete", vk::PhysicalDeviceType::eDiscreteGpu },
+		{ "integrated", vk::PhysicalDeviceType::eIntegratedGpu },
+		{ "virtual", vk::PhysicalDeviceType::eVirtualGpu },
+		{ "cpu", vk::PhysicalDeviceType::eCpu }
+	};
+	for (const auto& type : types)
+	{
+		if (needle != type.first)
+			continue;
+		for (size_t i = 0; i < devices.size(); i++)
+		{
+			if (properties[i].deviceType == type.second)
+				return devices[i];
+		}
+		return VK_NULL_HANDLE;
+	}
+
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		std::string name = properties[i].deviceName;
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		if (name.find(needle) != std::string::npos)
+			return devices[i];
+	}
+	return VK_NULL_HANDLE;
+}
+
+vk::PhysicalDevice DeviceSelector::loadCached(const std::string& cacheFile, const std::string& preference) const
+{
+	if (cacheFile.empty())
+		return VK_NULL_HANDLE;
+
+	std::ifstream file(cacheFile);
+	uint64_t cachedFingerprint = 0;
+	size_t index = 0;
+	uint32_t vendorID = 0, deviceID = 0;
+	std::string cachedPreference;
+	if (!(file >> cachedFingerprint >> index >> vendorID >> deviceID) || cachedFingerprint != fingerprint() || index >= devices.size())
+		return VK_NULL_HANDLE;
+	std::getline(file >> std::ws, cachedPreference);
+	if (cachedPreference != "preference=" + preference)
+		return VK_NULL_HANDLE;
+
+	// The index keeps two identical GPUs apart; presentation is the one check the rest of startup cannot do without
+	if (properties[index].vendorID != vendorID || properties[index].deviceID != deviceID || !hasGraphicsPresentQueue(devices[index]))
+		return VK_NULL_HANDLE;
+	return devices[index];
+}
+
+void DeviceSelector::saveCached(const std::string& cacheFile, const std::string& preference, vk::PhysicalDevice device) const
+{
+	if (cacheFile.empty())
+		return;
+
+	size_t index = std::find(devices.begin(), devices.end(), device) - devices.begin();
+	std::ofstream file(cacheFile, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "[Device] Unable to write file: " << cacheFile << "\n";
+		return;
+	}
+	file << fingerprint() << " " << index << " " << properties[index].vendorID << " " << properties[index].deviceID << "\n"
+		<< "preference=" << preference << "\n";
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+// Picks the physical device to run on. Every device is scored on its type, device-local memory, a few limits,
+// features and the queue families it offers; the best eligible one wins. The choice can be forced with a
+// preference (a device index, a device type such as cpu, or a substring of its name), and is cached on disk keyed on the set of devices
+// present, so later launches with the same hardware and drivers skip the probing.
+class DeviceSelector
+{
+public:
+	struct Candidate
+	{
+		vk::PhysicalDevice device;
+		vk::PhysicalDeviceProperties properties;
+		// Negative when the device cannot run the application at all
+		int64_t score = -1;
+		std::string reason;
+	};
+
+	// A null surface means headless: no presentation support or swapchain extension is required
+	DeviceSelector(vk::Instance instance, vk::SurfaceKHR surface, const std::vector<const char*>& requiredExtensions);
+
+	// Throws when no device is eligible
+	vk::PhysicalDevice select(const std::string& preference, const std::string& cacheFile);
+
+	static Candidate score(vk::PhysicalDevice device, vk::SurfaceKHR surface, const std::vector<const char*>& requiredExtensions);
+
+private:
+	uint64_t fingerprint() const;
+	bool hasGraphicsPresentQueue(vk::PhysicalDevice device) const;
+	vk::PhysicalDevice matchPreference(const std::string& preference) const;
+	vk::PhysicalDevice loadCached(const std::string& cacheFile, const std::string& preference) const;
+	void saveCached(const std::string& cacheFile, const std::string& preference, vk::PhysicalDevice device) const;
+
+private:
+	vk::SurfaceKHR surface;
+	std::vector<const char*> requiredExtensions;
+	std::vector<vk::PhysicalDevice> devices;
+	std::vector<vk::PhysicalDeviceProperties> properties;
+};
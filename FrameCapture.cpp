@@ -0,0 +1,327 @@
+#include "FrameCapture.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static uint32_t bytesPerPixel(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR8G8B8A8Unorm:
+	case vk::Format::eR8G8B8A8Srgb:
+	case vk::Format::eB8G8R8A8Unorm:
+	case vk::Format::eB8G8R8A8Srgb:
+	case vk::Format::eA2B10G10R10UnormPack32:
+	case vk::Format::eA2R10G10B10UnormPack32:
+		return 4;
+	case vk::Format::eR16G16B16A16Sfloat:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+static bool isBgra(vk::Format format)
+{
+	return format == vk::Format::eB8G8R8A8Unorm || format == vk::Format::eB8G8R8A8Srgb;
+}
+
+static bool isRgba8(vk::Format format)
+{
+	return isBgra(format) || format == vk::Format::eR8G8B8A8Unorm || format == vk::Format::eR8G8B8A8Srgb;
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+	static const auto table = []()
+	{
+		std::array<uint32_t, 256> table;
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		return table;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> chunk;
+	putBigEndian(chunk, static_cast<uint32_t>(data.size()));
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+	file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+// Stored (uncompressed) deflate blocks: no dependency and no encoding cost, files are as large as raw frames
+static bool writePng(const std::string& filename, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+		return false;
+
+	const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<uint8_t> header;
+	putBigEndian(header, width);
+	putBigEndian(header, height);
+	// 8 bits per channel, RGBA, deflate, no filtering method extensions, not interlaced
+	header.insert(header.end(), { 8, 6, 0, 0, 0 });
+	writeChunk(file, "IHDR", header);
+
+	size_t rowBytes = size_t(width) * 4;
+	std::vector<uint8_t> scanlines;
+	scanlines.reserve((rowBytes + 1) * height);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		scanlines.push_back(0);
+		scanlines.insert(scanlines.end(), rgba + y * rowBytes, rgba + (y + 1) * rowBytes);
+	}
+
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	zlib.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+	uint32_t a = 1, b = 0;
+	for (size_t offset = 0; offset < scanlines.size() || offset == 0;)
+	{
+		size_t length = std::min<size_t>(65535, scanlines.size() - offset);
+		bool last = offset + length == scanlines.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(length));
+		zlib.push_back(static_cast<uint8_t>(length >> 8));
+		zlib.push_back(static_cast<uint8_t>(~length));
+		zlib.push_back(static_cast<uint8_t>(~length >> 8));
+		for (size_t i = 0; i < length; i++)
+		{
+			a = (a + scanlines[offset + i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+		offset += length;
+		if (last)
+			break;
+	}
+	putBigEndian(zlib, (b << 16) | a);
+	writeChunk(file, "IDAT", zlib);
+	writeChunk(file, "IEND", {});
+	return static_cast<bool>(file);
+}
+
+void FrameCapture::init(vk::Device device, MemoryAllocator& allocator, DeletionQueue& deletions, uint32_t framesInFlight,
+	const std::string& directory, CaptureFormat format, uint32_t queueDepth)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	this->deletions = &deletions;
+	this->directory = directory;
+	this->format = format;
+	this->queueDepth = std::max(1u, queueDepth);
+	slots.resize(framesInFlight);
+	writer = std::make_unique<ThreadPool>(1);
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	std::cout << "[Capture] Writing " << (format == CaptureFormat::Png ? "PNG" : "raw") << " frames to " << directory << "\n";
+}
+
+void FrameCapture::destroy()
+{
+	if (!device)
+		return;
+
+	for (uint32_t i = 0; i < slots.size(); i++)
+		collect(i);
+	// Joins once every queued frame is written
+	writer.reset();
+
+	for (auto& slot : slots)
+	{
+		deletions->destroy(slot.buffer);
+		deletions->free(slot.allocation);
+	}
+	slots.clear();
+}
+
+void FrameCapture::recordCopy(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format format, vk::Extent2D extent,
+	uint32_t frameSlot, uint64_t frameNumber)
+{
+	uint32_t pixelBytes = bytesPerPixel(format);
+	if (pixelBytes == 0)
+	{
+		if (!warnedFormat)
+			std::cout << "[Warning] Cannot capture " << vk::to_string(format) << " images\n";
+		warnedFormat = true;
+		return;
+	}
+
+	// The slot has been collected, the CPU no longer reads its old buffer; the queue holds it for the GPU
+	auto& slot = slots[frameSlot];
+	vk::DeviceSize size = vk::DeviceSize(extent.width) * extent.height * pixelBytes;
+	if (size > slot.capacity)
+	{
+		deletions->destroy(slot.buffer);
+		deletions->free(slot.allocation);
+
+		auto bufferInfo = vk::BufferCreateInfo()
+			.setSize(size)
+			.setUsage(vk::BufferUsageFlagBits::eTransferDst)
+			.setSharingMode(vk::SharingMode::eExclusive);
+
+		slot.buffer = device.createBuffer(bufferInfo);
+		// Cached memory makes the CPU reads fast, uncached reads are often several times slower
+		auto typeBits = device.getBufferMemoryRequirements(slot.buffer).memoryTypeBits;
+		vk::MemoryPropertyFlags cached = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+		slot.allocation = allocator->allocateBuffer(slot.buffer, allocator->hasMemoryType(typeBits, cached) ? cached
+			: vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		slot.capacity = size;
+	}
+
+	auto region = vk::BufferImageCopy()
+		.setBufferOffset(0)
+		.setBufferRowLength(0)
+		.setBufferImageHeight(0)
+		.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+		.setImageOffset({ 0, 0, 0 })
+		.setImageExtent(vk::Extent3D(extent.width, extent.height, 1));
+
+	commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, slot.buffer, region);
+
+	auto hostBarrier = vk::BufferMemoryBarrier()
+		.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+		.setDstAccessMask(vk::AccessFlagBits::eHostRead)
+		.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+		.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+		.setBuffer(slot.buffer)
+		.setOffset(0)
+		.setSize(size);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+		vk::DependencyFlags(), nullptr, hostBarrier, nullptr);
+
+	slot.pending = true;
+	slot.frameNumber = frameNumber;
+	slot.format = format;
+	slot.extent = extent;
+	captured++;
+}
+
+void FrameCapture::collect(uint32_t frameSlot)
+{
+	auto& slot = slots[frameSlot];
+	if (!slot.pending)
+		return;
+	slot.pending = false;
+
+	// Bounded, so a slow disk slows rendering down rather than growing memory without limit
+	std::vector<uint8_t> pixels;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (queued >= queueDepth)
+		{
+			auto start = std::chrono::steady_clock::now();
+			condition.wait(lock, [this]() { return queued < queueDepth; });
+			stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		queued++;
+		if (!spare.empty())
+		{
+			pixels = std::move(spare.back());
+			spare.pop_back();
+		}
+	}
+
+	size_t size = size_t(slot.extent.width) * slot.extent.height * bytesPerPixel(slot.format);
+	if (!allocator->isHostCoherent(slot.allocation.memoryType))
+	{
+		auto atomSize = allocator->nonCoherentAtomSize();
+		auto begin = slot.allocation.offset / atomSize * atomSize;
+		auto end = (slot.allocation.offset + size + atomSize - 1) / atomSize * atomSize;
+
+		auto range = vk::MappedMemoryRange()
+			.setMemory(slot.allocation.memory)
+			.setOffset(begin)
+			.setSize(end - begin);
+
+		// Pooled chunks are whole multiples of the atom size, only a dedicated allocation can end early
+		if (slot.allocation.sizeClass == MemoryAllocator::DEDICATED_CLASS && end > slot.allocation.size)
+			range.setSize(VK_WHOLE_SIZE);
+
+		device.invalidateMappedMemoryRanges({ range });
+	}
+
+	pixels.resize(size);
+	std::memcpy(pixels.data(), slot.allocation.mapped, size);
+
+	auto frame = std::make_shared<Frame>(Frame{ std::move(pixels), slot.frameNumber, slot.format, slot.extent });
+	writer->enqueue([this, frame]() { write(*frame); });
+}
+
+void FrameCapture::write(Frame& frame)
+{
+	bool png = format == CaptureFormat::Png && isRgba8(frame.format);
+
+	// Raw frames carry their size and format in the name, there is no header
+	char number[32];
+	std::snprintf(number, sizeof(number), "frame_%06llu", static_cast<unsigned long long>(frame.frameNumber));
+	std::string name = png ? std::string(number) + ".png" : std::string(number) + "_" + std::to_string(frame.extent.width) + "x" +
+		std::to_string(frame.extent.height) + "_" + vk::to_string(frame.format) + ".raw";
+	std::string filename = (std::filesystem::path(directory) / name).string();
+
+	bool ok = false;
+	if (png)
+	{
+		// Swapchain images are opaque, their alpha is whatever the blend left behind
+		for (size_t i = 0; i < frame.pixels.size(); i += 4)
+		{
+			if (isBgra(frame.format))
+				std::swap(frame.pixels[i], frame.pixels[i + 2]);
+			frame.pixels[i + 3] = 255;
+		}
+		ok = writePng(filename, frame.pixels.data(), frame.extent.width, frame.extent.height);
+	}
+	else
+	{
+		std::ofstream file(filename, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(frame.pixels.data()), frame.pixels.size());
+		ok = static_cast<bool>(file);
+	}
+	(ok ? written : failed)++;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		spare.push_back(std::move(frame.pixels));
+		queued--;
+	}
+	condition.notify_one();
+}
+
+void FrameCapture::printStats() const
+{
+	std::cout << "[Capture] " << captured << " frames captured, " << written << " written to " << directory;
+	if (failed)
+		std::cout << ", " << failed << " failed";
+	std::cout << "\n\t--render thread stalled on the writer: " << stallMs << " ms\n";
+}
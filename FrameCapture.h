@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+#include "ThreadPool.h"
+
+enum class CaptureFormat
+{
+	Raw,
+	Png
+};
+
+// Copies rendered frames into host-visible readback buffers, one per frame in flight, and writes them to disk
+// on a writer thread. A slot's buffer is only read once its frame slot has been waited on, so capturing never
+// waits on the GPU. The writer works from its own copy of the pixels; the render thread blocks only when more
+// than queueDepth frames are still waiting to be written.
+class FrameCapture
+{
+public:
+	void init(vk::Device device, MemoryAllocator& allocator, DeletionQueue& deletions, uint32_t framesInFlight, const std::string& directory,
+		CaptureFormat format, uint32_t queueDepth = 8);
+	// Writes every outstanding frame and retires the readback buffers; the caller guarantees the GPU is idle
+	void destroy();
+
+	// Call once the slot's previous frame has completed, hands its pixels to the writer
+	void collect(uint32_t frameSlot);
+	// Outside a render pass, with the image in transfer source layout
+	void recordCopy(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format format, vk::Extent2D extent,
+		uint32_t frameSlot, uint64_t frameNumber);
+
+	void printStats() const;
+
+private:
+	struct Slot
+	{
+		vk::Buffer buffer;
+		MemoryAllocation allocation;
+		vk::DeviceSize capacity = 0;
+		bool pending = false;
+		uint64_t frameNumber = 0;
+		vk::Format format = vk::Format::eUndefined;
+		vk::Extent2D extent;
+	};
+
+	struct Frame
+	{
+		std::vector<uint8_t> pixels;
+		uint64_t frameNumber;
+		vk::Format format;
+		vk::Extent2D extent;
+	};
+
+	void write(Frame& frame);
+
+private:
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	DeletionQueue* deletions = nullptr;
+	std::string directory;
+	CaptureFormat format = CaptureFormat::Png;
+	uint32_t queueDepth = 8;
+	std::vector<Slot> slots;
+	std::unique_ptr<ThreadPool> writer;
+
+	// Frames handed to the writer and not yet on disk, and pixel buffers to reuse
+	std::mutex mutex;
+	std::condition_variable condition;
+	uint32_t queued = 0;
+	std::vector<std::vector<uint8_t>> spare;
+
+	uint64_t captured = 0;
+	std::atomic<uint64_t> written{ 0 };
+	std::atomic<uint64_t> failed{ 0 };
+	double stallMs = 0.0;
+	bool warnedFormat = false;
+};
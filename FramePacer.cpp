@@ -0,0 +1,93 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// Weight of the newest sample in the moving averages
+static const double SMOOTHING = 0.1;
+// Upper bound on any single delay so a bad estimate can cost at most a few frames
+static const double MAX_DELAY_US = 50000.0;
+
+void FramePacer::init(const FrameProfiler* profiler, bool enabled, double marginMs)
+{
+	this->profiler = profiler;
+	this->enabled = enabled;
+	marginUs = marginMs * 1000.0;
+
+	if (enabled && !profiler->hasGpuTimings())
+	{
+		std::cout << "[Warning] Frame pacing needs GPU timestamps, pacing is disabled\n";
+		this->enabled = false;
+	}
+}
+
+void FramePacer::waitForFrameStart()
+{
+	if (!enabled)
+		return;
+
+	double now = profiler->nowUs();
+
+	// Start so that recording and submission end just as the GPU runs out of queued work
+	double gpuBoundDelay = gpuIdleAtUs - cpuFrameUs - marginUs - now;
+	double delay = std::min(std::max(gpuBoundDelay, blockedDelayUs), MAX_DELAY_US);
+	if (delay <= 0.0)
+		return;
+
+	std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(delay));
+	totalDelayUs += delay;
+	delayedFrames++;
+}
+
+void FramePacer::frameSubmitted()
+{
+	if (!enabled || profiler->frameCount() == 0)
+		return;
+
+	updateGpuTime();
+
+	const auto& record = profiler->frame(profiler->frameCount() - 1);
+	auto phase = [&](CpuPhase phase) { return record.phaseDurationUs[static_cast<uint32_t>(phase)]; };
+
+	double cpuUs = phase(CpuPhase::Record) + phase(CpuPhase::Submit);
+	cpuFrameUs = cpuFrameUs == 0.0 ? cpuUs : cpuFrameUs + (cpuUs - cpuFrameUs) * SMOOTHING;
+
+	// The GPU picks this frame up once it is submitted and everything queued before it has finished
+	auto submit = static_cast<uint32_t>(CpuPhase::Submit);
+	double submittedUs = record.phaseStartUs[submit] + record.phaseDurationUs[submit];
+	gpuIdleAtUs = std::max(gpuIdleAtUs, submittedUs) + gpuFrameUs;
+
+	// Time spent blocked could have been spent sleeping before input was sampled; back off slowly once it disappears
+	double blockedUs = phase(CpuPhase::WaitFrame) + phase(CpuPhase::Acquire);
+	if (blockedUs > marginUs)
+		blockedDelayUs += (blockedUs - marginUs) * 0.5;
+	else
+		blockedDelayUs *= 0.9;
+	blockedDelayUs = std::min(blockedDelayUs, MAX_DELAY_US);
+}
+
+void FramePacer::updateGpuTime()
+{
+	// GPU results arrive a few frames late; walk back from the newest record to the last one already consumed
+	uint64_t newest = lastGpuFrame;
+	for (size_t i = profiler->frameCount(); i > 0; i--)
+	{
+		const auto& record = profiler->frame(i - 1);
+		if (record.frame <= lastGpuFrame)
+			break;
+		if (!record.gpuResolved)
+			continue;
+
+		for (uint32_t j = 0; j < record.gpuSpanCount; j++)
+		{
+			if (std::strcmp(record.gpuSpans[j].name, "frame") != 0)
+				continue;
+			double gpuUs = record.gpuSpans[j].durationUs;
+			gpuFrameUs = gpuFrameUs == 0.0 ? gpuUs : gpuFrameUs + (gpuUs - gpuFrameUs) * SMOOTHING;
+		}
+		newest = std::max(newest, record.frame);
+	}
+	lastGpuFrame = newest;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "FrameProfiler.h"
+
+#include <cstdint>
+
+// Delays the start of each frame so the CPU samples input as late as possible while still handing work to the GPU
+// before it runs dry. Two estimates are combined: when the GPU will finish the work already queued, from measured GPU
+// frame times, and how long the previous frames sat blocked on their slot or on acquire, which covers display-bound
+// present modes where the GPU is idle but the swapchain is not.
+class FramePacer
+{
+public:
+	void init(const FrameProfiler* profiler, bool enabled, double marginMs = 1.0);
+
+	// Sleeps until the next frame should start, call before polling input
+	void waitForFrameStart();
+	// Call after the frame has been submitted and presented
+	void frameSubmitted();
+
+	bool isEnabled() const { return enabled; }
+	double averageDelayMs() const { return delayedFrames ? totalDelayUs / delayedFrames / 1000.0 : 0.0; }
+
+private:
+	void updateGpuTime();
+
+private:
+	const FrameProfiler* profiler = nullptr;
+	bool enabled = false;
+	double marginUs = 1000.0;
+
+	// Exponential moving averages, in microseconds
+	double gpuFrameUs = 0.0;
+	double cpuFrameUs = 0.0;
+	uint64_t lastGpuFrame = 0;
+
+	double gpuIdleAtUs = 0.0;
+	double blockedDelayUs = 0.0;
+
+	double totalDelayUs = 0.0;
+	uint64_t delayedFrames = 0;
+};
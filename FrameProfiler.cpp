@@ -0,0 +1,321 @@
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const char* CPU_PHASE_NAMES[] = { "waitFrame", "acquire", "record", "submit", "present" };
+
+void FrameProfiler::init(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight,
+	bool enabled, uint32_t historySize)
+{
+	this->device = device;
+	this->enabled = enabled;
+	epoch = std::chrono::steady_clock::now();
+
+	history.resize(std::max(historySize, framesInFlight * 2));
+	pendingRecords.resize(framesInFlight, SIZE_MAX);
+
+	if (!enabled)
+		return;
+
+	auto validBits = physicalDevice.getQueueFamilyProperties()[queueFamily].timestampValidBits;
+	if (validBits == 0)
+	{
+		std::cout << "[Warning] Queue family does not support timestamps, GPU spans will not be recorded\n";
+		return;
+	}
+	timestampMask = validBits >= 64 ? UINT64_MAX : ((uint64_t(1) << validBits) - 1);
+	timestampPeriodNs = physicalDevice.getProperties().limits.timestampPeriod;
+
+	auto queryPoolInfo = vk::QueryPoolCreateInfo()
+		.setQueryType(vk::QueryType::eTimestamp)
+		.setQueryCount(framesInFlight * MAX_GPU_SPANS * 2);
+
+	queryPool = device.createQueryPool(queryPoolInfo);
+}
+
+void FrameProfiler::destroy(DeletionQueue& deletions)
+{
+	deletions.destroy(queryPool);
+	queryPool = VK_NULL_HANDLE;
+}
+
+void FrameProfiler::beginFrame(uint32_t frameSlot, uint64_t frameNumber)
+{
+	if (!enabled)
+		return;
+
+	resolve(frameSlot);
+
+	current = &history[head];
+	*current = FrameRecord();
+	current->frame = frameNumber;
+	currentSlot = frameSlot;
+	pendingRecords[frameSlot] = head;
+
+	head = (head + 1) % history.size();
+	count = std::min(count + 1, history.size());
+}
+
+void FrameProfiler::beginPhase(CpuPhase phase)
+{
+	if (!current)
+		return;
+
+	auto index = static_cast<uint32_t>(phase);
+	phaseBeginUs[index] = nowUs();
+	if (current->phaseDurationUs[index] == 0.0)
+		current->phaseStartUs[index] = phaseBeginUs[index];
+}
+
+void FrameProfiler::endPhase(CpuPhase phase)
+{
+	if (!current)
+		return;
+
+	// A phase entered several times in one frame accumulates
+	auto index = static_cast<uint32_t>(phase);
+	current->phaseDurationUs[index] += nowUs() - phaseBeginUs[index];
+}
+
+void FrameProfiler::addPhase(CpuPhase phase, std::chrono::steady_clock::time_point start)
+{
+	if (!current)
+		return;
+
+	auto index = static_cast<uint32_t>(phase);
+	auto startUs = std::chrono::duration<double, std::micro>(start - epoch).count();
+	if (current->phaseDurationUs[index] == 0.0)
+		current->phaseStartUs[index] = startUs;
+	current->phaseDurationUs[index] += nowUs() - startUs;
+}
+
+void FrameProfiler::resetQueries(vk::CommandBuffer commandBuffer)
+{
+	if (queryPool && current)
+		commandBuffer.resetQueryPool(queryPool, currentSlot * MAX_GPU_SPANS * 2, MAX_GPU_SPANS * 2);
+}
+
+uint32_t FrameProfiler::beginGpuSpan(vk::CommandBuffer commandBuffer, const char* name)
+{
+	if (!queryPool || !current || current->gpuSpanCount == MAX_GPU_SPANS)
+		return UINT32_MAX;
+
+	uint32_t span = current->gpuSpanCount++;
+	current->gpuSpans[span].name = name;
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, (currentSlot * MAX_GPU_SPANS + span) * 2);
+	return span;
+}
+
+const char* FrameProfiler::internName(const std::string& name)
+{
+	for (const auto& interned : names)
+	{
+		if (interned == name)
+			return interned.c_str();
+	}
+	names.push_back(name);
+	return names.back().c_str();
+}
+
+void FrameProfiler::endGpuSpan(vk::CommandBuffer commandBuffer, uint32_t span)
+{
+	if (span == UINT32_MAX)
+		return;
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, (currentSlot * MAX_GPU_SPANS + span) * 2 + 1);
+}
+
+void FrameProfiler::resolveAll()
+{
+	for (uint32_t i = 0; i < pendingRecords.size(); i++)
+		resolve(i);
+}
+
+double FrameProfiler::averageCpuMs(CpuPhase phase) const
+{
+	if (count == 0)
+		return 0.0;
+
+	double total = 0.0;
+	for (size_t i = 0; i < count; i++)
+		total += frame(i).phaseDurationUs[static_cast<uint32_t>(phase)];
+	return total / count / 1000.0;
+}
+
+double FrameProfiler::averageGpuMs(const char* span) const
+{
+	double total = 0.0;
+	size_t samples = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto& record = frame(i);
+		if (!record.gpuResolved)
+			continue;
+		for (uint32_t j = 0; j < record.gpuSpanCount; j++)
+		{
+			if (std::strcmp(record.gpuSpans[j].name, span) == 0)
+			{
+				total += record.gpuSpans[j].durationUs;
+				samples++;
+			}
+		}
+	}
+	return samples ? total / samples / 1000.0 : 0.0;
+}
+
+double FrameProfiler::averageLatencyMs() const
+{
+	double total = 0.0;
+	size_t samples = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto& record = frame(i);
+		if (!record.gpuResolved)
+			continue;
+		total += record.latencyUs;
+		samples++;
+	}
+	return samples ? total / samples / 1000.0 : 0.0;
+}
+
+bool FrameProfiler::exportChromeTrace(const std::string& filename) const
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cout << "[Error] Unable to write file: " << filename << "\n";
+		return false;
+	}
+
+	file << "{\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto& record = frame(i);
+		for (uint32_t j = 0; j < CPU_PHASE_COUNT; j++)
+		{
+			if (record.phaseDurationUs[j] == 0.0)
+				continue;
+			file << ",\n{\"name\":\"" << CPU_PHASE_NAMES[j] << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+				<< ",\"ts\":" << record.phaseStartUs[j] << ",\"dur\":" << record.phaseDurationUs[j]
+				<< ",\"args\":{\"frame\":" << record.frame << "}}";
+		}
+		if (!record.gpuResolved)
+			continue;
+		for (uint32_t j = 0; j < record.gpuSpanCount; j++)
+		{
+			const auto& span = record.gpuSpans[j];
+			file << ",\n{\"name\":\"" << span.name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2"
+				<< ",\"ts\":" << span.startUs << ",\"dur\":" << span.durationUs
+				<< ",\"args\":{\"frame\":" << record.frame << "}}";
+		}
+	}
+	file << "\n]}\n";
+	return true;
+}
+
+bool FrameProfiler::exportCsv(const std::string& filename) const
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cout << "[Error] Unable to write file: " << filename << "\n";
+		return false;
+	}
+
+	// One column per distinct GPU span name, in order of first appearance
+	std::vector<const char*> spanNames;
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto& record = frame(i);
+		for (uint32_t j = 0; j < record.gpuSpanCount; j++)
+		{
+			bool known = false;
+			for (auto name : spanNames)
+				known = known || std::strcmp(name, record.gpuSpans[j].name) == 0;
+			if (!known)
+				spanNames.push_back(record.gpuSpans[j].name);
+		}
+	}
+
+	file << "frame";
+	for (auto name : CPU_PHASE_NAMES)
+		file << ",cpu_" << name << "_ms";
+	for (auto name : spanNames)
+		file << ",gpu_" << name << "_ms";
+	file << "\n";
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto& record = frame(i);
+		file << record.frame;
+		for (uint32_t j = 0; j < CPU_PHASE_COUNT; j++)
+			file << "," << record.phaseDurationUs[j] / 1000.0;
+		for (auto name : spanNames)
+		{
+			file << ",";
+			for (uint32_t j = 0; record.gpuResolved && j < record.gpuSpanCount; j++)
+			{
+				if (std::strcmp(name, record.gpuSpans[j].name) == 0)
+				{
+					file << record.gpuSpans[j].durationUs / 1000.0;
+					break;
+				}
+			}
+		}
+		file << "\n";
+	}
+	return true;
+}
+
+double FrameProfiler::nowUs() const
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void FrameProfiler::resolve(uint32_t frameSlot)
+{
+	size_t index = pendingRecords[frameSlot];
+	pendingRecords[frameSlot] = SIZE_MAX;
+	if (!queryPool || index == SIZE_MAX)
+		return;
+
+	auto& record = history[index];
+	if (record.gpuSpanCount == 0)
+		return;
+
+	uint64_t timestamps[MAX_GPU_SPANS * 2];
+	auto result = device.getQueryPoolResults(queryPool, frameSlot * MAX_GPU_SPANS * 2, record.gpuSpanCount * 2,
+		sizeof(uint64_t) * record.gpuSpanCount * 2, timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+	// Not ready means the slot was reused without waiting, drop the sample rather than stall
+	if (result != vk::Result::eSuccess)
+		return;
+
+	auto toUs = [&](uint64_t ticks) { return static_cast<double>(ticks & timestampMask) * timestampPeriodNs / 1000.0; };
+
+	// There is no shared clock without calibrated timestamps, but GPU work cannot start before its submit did.
+	// Every frame bounds the offset from below and the largest bound is the closest estimate.
+	auto submit = static_cast<uint32_t>(CpuPhase::Submit);
+	double offsetBound = record.phaseStartUs[submit] - toUs(timestamps[0]);
+	if (!gpuOffsetKnown || offsetBound > gpuOffsetUs)
+	{
+		gpuOffsetUs = offsetBound;
+		gpuOffsetKnown = true;
+	}
+
+	double gpuEndUs = 0.0;
+	for (uint32_t i = 0; i < record.gpuSpanCount; i++)
+	{
+		auto& span = record.gpuSpans[i];
+		span.startUs = toUs(timestamps[i * 2]) + gpuOffsetUs;
+		span.durationUs = toUs((timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask);
+		gpuEndUs = std::max(gpuEndUs, span.startUs + span.durationUs);
+	}
+	record.latencyUs = gpuEndUs - record.phaseStartUs[static_cast<uint32_t>(CpuPhase::WaitFrame)];
+	record.gpuResolved = true;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "DeletionQueue.h"
+
+enum class CpuPhase
+{
+	WaitFrame,
+	Acquire,
+	Record,
+	Submit,
+	Present,
+	Count
+};
+
+// Per-frame CPU phase timings and GPU timestamp spans kept in a fixed-size history ring.
+// GPU results of a frame slot are read back when the slot comes around again, at which point
+// the frame has completed and vkGetQueryPoolResults never has to wait.
+class FrameProfiler
+{
+public:
+	static const uint32_t MAX_GPU_SPANS = 32;
+	static const uint32_t CPU_PHASE_COUNT = static_cast<uint32_t>(CpuPhase::Count);
+
+	struct GpuSpan
+	{
+		// Expected to be a string literal or come from internName(), spans never own their names
+		const char* name = nullptr;
+		double startUs = 0.0;
+		double durationUs = 0.0;
+	};
+
+	struct FrameRecord
+	{
+		uint64_t frame = 0;
+		std::array<double, CPU_PHASE_COUNT> phaseStartUs = {};
+		std::array<double, CPU_PHASE_COUNT> phaseDurationUs = {};
+		std::array<GpuSpan, MAX_GPU_SPANS> gpuSpans;
+		uint32_t gpuSpanCount = 0;
+		bool gpuResolved = false;
+		// From the start of the frame on the CPU to the end of its last GPU span
+		double latencyUs = 0.0;
+	};
+
+	void init(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight,
+		bool enabled = true, uint32_t historySize = 1024);
+	// The history stays readable afterwards
+	void destroy(DeletionQueue& deletions);
+
+	// Call once the slot's previous frame has completed
+	void beginFrame(uint32_t frameSlot, uint64_t frameNumber);
+
+	void beginPhase(CpuPhase phase);
+	void endPhase(CpuPhase phase);
+	// For work that has to finish before the frame can begin, such as the wait on its slot
+	void addPhase(CpuPhase phase, std::chrono::steady_clock::time_point start);
+
+	// First command of the frame's primary command buffer
+	void resetQueries(vk::CommandBuffer commandBuffer);
+	uint32_t beginGpuSpan(vk::CommandBuffer commandBuffer, const char* name);
+	void endGpuSpan(vk::CommandBuffer commandBuffer, uint32_t span);
+	// Profiler-owned copy of a name built at runtime, valid for the profiler's lifetime
+	const char* internName(const std::string& name);
+
+	// Resolves every outstanding slot; the caller guarantees the GPU is idle
+	void resolveAll();
+
+	size_t frameCount() const { return count; }
+	// 0 is the oldest frame still in the history
+	const FrameRecord& frame(size_t index) const { return history[(head + history.size() - count + index) % history.size()]; }
+
+	double averageCpuMs(CpuPhase phase) const;
+	double averageGpuMs(const char* span) const;
+	double averageLatencyMs() const;
+	bool hasGpuTimings() const { return static_cast<bool>(queryPool); }
+
+	bool exportChromeTrace(const std::string& filename) const;
+	bool exportCsv(const std::string& filename) const;
+
+	// Microseconds on the clock all records are expressed in
+	double nowUs() const;
+
+private:
+	void resolve(uint32_t frameSlot);
+
+private:
+	bool enabled = false;
+	vk::Device device;
+	vk::QueryPool queryPool;
+	double timestampPeriodNs = 0.0;
+	uint64_t timestampMask = 0;
+	std::chrono::steady_clock::time_point epoch;
+
+	std::vector<FrameRecord> history;
+	size_t head = 0;
+	size_t count = 0;
+	FrameRecord* current = nullptr;
+	uint32_t currentSlot = 0;
+
+	// History index of the frame last recorded in each slot, or SIZE_MAX
+	std::vector<size_t> pendingRecords;
+	std::array<double, CPU_PHASE_COUNT> phaseBeginUs = {};
+	// Interned span names, a deque never moves its elements so the pointers stay stable
+	std::deque<std::string> names;
+
+	// Maps GPU timestamps onto the CPU timeline, the tightest bound seen so far
+	bool gpuOffsetKnown = false;
+	double gpuOffsetUs = 0.0;
+};
@@ -0,0 +1,276 @@
+#include "InstanceCuller.h"
+
+const uint32_t CULL_GROUP_SIZE = 64;
+
+static std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& m)
+{
+	auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+	// Vulkan clip space: -w <= x, y <= w and 0 <= z <= w
+	std::array<glm::vec4, 6> planes =
+	{
+		row(3) + row(0),
+		row(3) - row(0),
+		row(3) + row(1),
+		row(3) - row(1),
+		row(2),
+		row(3) - row(2)
+	};
+	for (auto& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+	return planes;
+}
+
+void InstanceCuller::init(vk::Device device, MemoryAllocator& allocator, UploadManager& uploader,
+	const std::vector<InstanceData>& instanceData, const std::vector<MeshRange>& meshes, uint32_t framesInFlight,
+	vk::ShaderModule cullShader, vk::ShaderModule compactShader, vk::PipelineCache pipelineCache,
+	bool drawIndirectCount, bool multiDrawIndirect, const std::vector<uint32_t>& queueFamilies)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	instanceCount = static_cast<uint32_t>(instanceData.size());
+	meshCount = static_cast<uint32_t>(meshes.size());
+	useDrawIndirectCount = drawIndirectCount;
+	useMultiDrawIndirect = multiDrawIndirect;
+	this->queueFamilies = queueFamilies;
+
+	auto instanceBytes = sizeof(InstanceData) * instanceData.size();
+	auto commandBytes = sizeof(vk::DrawIndexedIndirectCommand) * meshes.size();
+
+	// Survivors of each mesh land in a contiguous range of the visible buffer, sized for the worst case
+	std::vector<vk::DrawIndexedIndirectCommand> commands(meshes.size());
+	std::vector<uint32_t> meshInstanceCounts(meshes.size(), 0);
+	for (const auto& instance : instanceData)
+		meshInstanceCounts[instance.mesh]++;
+
+	uint32_t firstInstance = 0;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		commands[i] = vk::DrawIndexedIndirectCommand()
+			.setIndexCount(meshes[i].indexCount)
+			.setInstanceCount(0)
+			.setFirstIndex(meshes[i].firstIndex)
+			.setVertexOffset(meshes[i].vertexOffset)
+			.setFirstInstance(firstInstance);
+		firstInstance += meshInstanceCounts[i];
+	}
+
+	instances = createBuffer(instanceBytes,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+		instanceAllocation);
+	commandTemplate = createBuffer(commandBytes, vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+		commandTemplateAllocation);
+
+	// Written by the transfer family and read by compute and graphics, shared rather than handed over every frame
+	bool concurrent = queueFamilies.size() > 1;
+	uploader.uploadBuffer(instances, 0, instanceData.data(), instanceBytes, nullptr, concurrent);
+	uploader.uploadBuffer(commandTemplate, 0, commands.data(), commandBytes, nullptr, concurrent);
+
+	auto storageBinding = [](uint32_t binding)
+	{
+		return vk::DescriptorSetLayoutBinding()
+			.setBinding(binding)
+			.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+			.setDescriptorCount(1)
+			.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	};
+	vk::DescriptorSetLayoutBinding bindings[] =
+	{
+		storageBinding(0), storageBinding(1), storageBinding(2), storageBinding(3), storageBinding(4)
+	};
+
+	auto setLayoutInfo = vk::DescriptorSetLayoutCreateInfo()
+		.setBindingCount(5)
+		.setPBindings(bindings);
+
+	setLayout = device.createDescriptorSetLayout(setLayoutInfo);
+
+	auto poolSize = vk::DescriptorPoolSize()
+		.setType(vk::DescriptorType::eStorageBuffer)
+		.setDescriptorCount(5 * framesInFlight);
+
+	auto poolInfo = vk::DescriptorPoolCreateInfo()
+		.setMaxSets(framesInFlight)
+		.setPoolSizeCount(1)
+		.setPPoolSizes(&poolSize);
+
+	descriptorPool = device.createDescriptorPool(poolInfo);
+
+	frames.resize(framesInFlight);
+	for (auto& frame : frames)
+	{
+		frame.visible = createBuffer(instanceBytes,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer, frame.allocations[0]);
+		frame.commands = createBuffer(commandBytes,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			frame.allocations[1]);
+		frame.compactCommands = createBuffer(commandBytes,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, frame.allocations[2]);
+		frame.drawCount = createBuffer(sizeof(uint32_t),
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			frame.allocations[3]);
+
+		auto allocInfo = vk::DescriptorSetAllocateInfo()
+			.setDescriptorPool(descriptorPool)
+			.setDescriptorSetCount(1)
+			.setPSetLayouts(&setLayout);
+
+		frame.descriptorSet = device.allocateDescriptorSets(allocInfo)[0];
+
+		vk::DescriptorBufferInfo bufferInfos[] =
+		{
+			vk::DescriptorBufferInfo(instances, 0, VK_WHOLE_SIZE),
+			vk::DescriptorBufferInfo(frame.visible, 0, VK_WHOLE_SIZE),
+			vk::DescriptorBufferInfo(frame.commands, 0, VK_WHOLE_SIZE),
+			vk::DescriptorBufferInfo(frame.compactCommands, 0, VK_WHOLE_SIZE),
+			vk::DescriptorBufferInfo(frame.drawCount, 0, VK_WHOLE_SIZE)
+		};
+
+		std::vector<vk::WriteDescriptorSet> writes;
+		for (uint32_t i = 0; i < 5; i++)
+		{
+			writes.push_back(vk::WriteDescriptorSet()
+				.setDstSet(frame.descriptorSet)
+				.setDstBinding(i)
+				.setDescriptorCount(1)
+				.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+				.setPBufferInfo(&bufferInfos[i]));
+		}
+		device.updateDescriptorSets(writes, nullptr);
+	}
+
+	auto pushConstantRange = vk::PushConstantRange()
+		.setStageFlags(vk::ShaderStageFlagBits::eCompute)
+		.setOffset(0)
+		.setSize(sizeof(PushConstants));
+
+	auto pipelineLayoutInfo = vk::PipelineLayoutCreateInfo()
+		.setSetLayoutCount(1)
+		.setPSetLayouts(&setLayout)
+		.setPushConstantRangeCount(1)
+		.setPPushConstantRanges(&pushConstantRange);
+
+	pipelineLayout = device.createPipelineLayout(pipelineLayoutInfo);
+
+	auto createComputePipeline = [&](vk::ShaderModule module)
+	{
+		auto stageInfo = vk::PipelineShaderStageCreateInfo()
+			.setStage(vk::ShaderStageFlagBits::eCompute)
+			.setModule(module)
+			.setPName("main");
+
+		auto pipelineInfo = vk::ComputePipelineCreateInfo()
+			.setStage(stageInfo)
+			.setLayout(pipelineLayout);
+
+		return device.createComputePipeline(pipelineCache, pipelineInfo).value;
+	};
+
+	cullPipeline = createComputePipeline(cullShader);
+	if (useDrawIndirectCount)
+		compactPipeline = createComputePipeline(compactShader);
+}
+
+void InstanceCuller::destroy(DeletionQueue& deletions)
+{
+	if (!device)
+		return;
+
+	deletions.destroy(compactPipeline);
+	deletions.destroy(cullPipeline);
+	deletions.destroy(pipelineLayout);
+	deletions.destroy(descriptorPool);
+	deletions.destroy(setLayout);
+
+	for (auto& frame : frames)
+	{
+		deletions.destroy(frame.visible);
+		deletions.destroy(frame.commands);
+		deletions.destroy(frame.compactCommands);
+		deletions.destroy(frame.drawCount);
+		for (auto& allocation : frame.allocations)
+			deletions.free(allocation);
+	}
+	frames.clear();
+
+	deletions.destroy(instances);
+	deletions.destroy(commandTemplate);
+	deletions.free(instanceAllocation);
+	deletions.free(commandTemplateAllocation);
+}
+
+void InstanceCuller::recordCulling(vk::CommandBuffer commandBuffer, uint32_t frameSlot, const glm::mat4& viewProj)
+{
+	auto& frame = frames[frameSlot];
+	auto commandBytes = sizeof(vk::DrawIndexedIndirectCommand) * meshCount;
+
+	commandBuffer.copyBuffer(commandTemplate, frame.commands, vk::BufferCopy(0, 0, commandBytes));
+	commandBuffer.fillBuffer(frame.drawCount, 0, sizeof(uint32_t), 0);
+
+	auto resetBarrier = vk::MemoryBarrier()
+		.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+		.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+		vk::DependencyFlags(), resetBarrier, nullptr, nullptr);
+
+	PushConstants pushConstants;
+	auto planes = extractFrustumPlanes(viewProj);
+	for (int i = 0; i < 6; i++)
+		pushConstants.planes[i] = planes[i];
+	pushConstants.instanceCount = instanceCount;
+	pushConstants.meshCount = meshCount;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, frame.descriptorSet, nullptr);
+	commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &pushConstants);
+	commandBuffer.dispatch((instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	if (useDrawIndirectCount)
+	{
+		auto cullBarrier = vk::MemoryBarrier()
+			.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+			.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+			vk::DependencyFlags(), cullBarrier, nullptr, nullptr);
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, compactPipeline);
+		commandBuffer.dispatch((meshCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	}
+}
+
+void InstanceCuller::recordDraw(vk::CommandBuffer commandBuffer, uint32_t frameSlot)
+{
+	auto& frame = frames[frameSlot];
+	const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+	vk::DeviceSize offset = 0;
+	commandBuffer.bindVertexBuffers(1, 1, &frame.visible, &offset);
+
+	if (useDrawIndirectCount)
+		commandBuffer.drawIndexedIndirectCount(frame.compactCommands, 0, frame.drawCount, 0, meshCount, stride);
+	else if (useMultiDrawIndirect)
+		commandBuffer.drawIndexedIndirect(frame.commands, 0, meshCount, stride);
+	else
+	{
+		// Meshes with no survivors are empty draws
+		for (uint32_t i = 0; i < meshCount; i++)
+			commandBuffer.drawIndexedIndirect(frame.commands, i * stride, 1, stride);
+	}
+}
+
+vk::Buffer InstanceCuller::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, MemoryAllocation& allocation)
+{
+	bool concurrent = queueFamilies.size() > 1;
+	auto bufferInfo = vk::BufferCreateInfo()
+		.setSize(size)
+		.setUsage(usage)
+		.setSharingMode(concurrent ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive)
+		.setQueueFamilyIndexCount(concurrent ? static_cast<uint32_t>(queueFamilies.size()) : 0)
+		.setPQueueFamilyIndices(concurrent ? queueFamilies.data() : nullptr);
+
+	auto buffer = device.createBuffer(bufferInfo);
+	allocation = allocator->allocateBuffer(buffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	return buffer;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+#include "UploadManager.h"
+
+struct MeshRange
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+};
+
+// Matches the Instance struct in the culling shaders (std430) and vertex binding 1
+struct InstanceData
+{
+	// xyz position, w uniform scale
+	glm::vec4 positionScale;
+	glm::vec4 color;
+	uint32_t mesh;
+	uint32_t padding[3];
+
+	static vk::VertexInputBindingDescription bindingDescription()
+	{
+		return vk::VertexInputBindingDescription()
+			.setBinding(1)
+			.setStride(sizeof(InstanceData))
+			.setInputRate(vk::VertexInputRate::eInstance);
+	}
+
+	static std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions()
+	{
+		return
+		{
+			vk::VertexInputAttributeDescription()
+				.setLocation(2)
+				.setBinding(1)
+				.setFormat(vk::Format::eR32G32B32A32Sfloat)
+				.setOffset(offsetof(InstanceData, positionScale)),
+			vk::VertexInputAttributeDescription()
+				.setLocation(3)
+				.setBinding(1)
+				.setFormat(vk::Format::eR32G32B32A32Sfloat)
+				.setOffset(offsetof(InstanceData, color))
+		};
+	}
+};
+
+// Frustum-culls instances in a compute pass and compacts the survivors into per-mesh
+// drawIndexedIndirect commands, so the CPU records the same handful of commands for any instance count
+class InstanceCuller
+{
+public:
+	void init(vk::Device device, MemoryAllocator& allocator, UploadManager& uploader,
+		const std::vector<InstanceData>& instances, const std::vector<MeshRange>& meshes, uint32_t framesInFlight,
+		vk::ShaderModule cullShader, vk::ShaderModule compactShader, vk::PipelineCache pipelineCache,
+		bool drawIndirectCount, bool multiDrawIndirect, const std::vector<uint32_t>& queueFamilies);
+	void destroy(DeletionQueue& deletions);
+
+	// Outside a render pass. The draws must be ordered after it by the caller: a barrier from the
+	// compute shader stage to draw indirect and vertex input, or the semaphore with async compute.
+	void recordCulling(vk::CommandBuffer commandBuffer, uint32_t frameSlot, const glm::mat4& viewProj);
+	// Inside the render pass, with a pipeline and the vertex / index buffers already bound
+	void recordDraw(vk::CommandBuffer commandBuffer, uint32_t frameSlot);
+
+	vk::Buffer instanceBuffer() const { return instances; }
+
+private:
+	struct PushConstants
+	{
+		glm::vec4 planes[6];
+		uint32_t instanceCount;
+		uint32_t meshCount;
+	};
+
+	struct FrameBuffers
+	{
+		vk::Buffer visible;
+		vk::Buffer commands;
+		vk::Buffer compactCommands;
+		vk::Buffer drawCount;
+		std::array<MemoryAllocation, 4> allocations;
+		vk::DescriptorSet descriptorSet;
+	};
+
+	vk::Buffer createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, MemoryAllocation& allocation);
+
+private:
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+
+	uint32_t instanceCount = 0;
+	uint32_t meshCount = 0;
+	bool useDrawIndirectCount = false;
+	bool useMultiDrawIndirect = false;
+	// Every family that touches the buffers; more than one makes them concurrent
+	std::vector<uint32_t> queueFamilies;
+
+	vk::Buffer instances;
+	MemoryAllocation instanceAllocation;
+	// Per-mesh commands with instanceCount 0, copied over the frame's commands before culling
+	vk::Buffer commandTemplate;
+	MemoryAllocation commandTemplateAllocation;
+	std::vector<FrameBuffers> frames;
+
+	vk::DescriptorSetLayout setLayout;
+	vk::DescriptorPool descriptorPool;
+	vk::PipelineLayout pipelineLayout;
+	vk::Pipeline cullPipeline;
+	vk::Pipeline compactPipeline;
+};
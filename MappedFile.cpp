@@ -0,0 +1,106 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const size_t PREFETCH_PAGE_SIZE = 4096;
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	bytes = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	length = static_cast<size_t>(size.QuadPart);
+#else
+	int file = ::open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	void* mapping = MAP_FAILED;
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+		mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	// The mapping keeps its own reference to the file
+	::close(file);
+	if (mapping == MAP_FAILED)
+		return false;
+
+	bytes = static_cast<const uint8_t*>(mapping);
+	length = static_cast<size_t>(info.st_size);
+#endif
+	if (!bytes)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle)
+		CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (bytes)
+		munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+	bytes = nullptr;
+	length = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const
+{
+	if (!bytes || offset >= length)
+		return;
+	size = std::min(size, length - offset);
+
+#if !defined(_WIN32)
+	// Lets the kernel start reading ahead of the loop below
+	size_t pageStart = offset & ~(PREFETCH_PAGE_SIZE - 1);
+	madvise(const_cast<uint8_t*>(bytes) + pageStart, offset + size - pageStart, MADV_WILLNEED);
+#endif
+
+	volatile uint8_t sink = 0;
+	for (size_t i = offset; i < offset + size; i += PREFETCH_PAGE_SIZE)
+		sink = sink + bytes[i];
+	if (size > 0)
+		sink = sink + bytes[offset + size - 1];
+}
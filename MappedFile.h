@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first access,
+// prefetch() does that ahead of time, e.g. on a loader thread.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& filename);
+	void close();
+	bool isOpen() const { return bytes != nullptr; }
+
+	const uint8_t* data() const { return bytes; }
+	size_t size() const { return length; }
+
+	// Touches every page of the range so later reads don't block on disk I/O
+	void prefetch(size_t offset, size_t size) const;
+
+private:
+	const uint8_t* bytes = nullptr;
+	size_t length = 0;
+
+#if defined(_WIN32)
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
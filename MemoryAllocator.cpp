@@ -0,0 +1,377 @@
+#include "MemoryAllocator.h"
+#include "DeletionQueue.h"
+
+#include <iostream>
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void MemoryAllocator::init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::DeviceSize blockSize)
+{
+	this->device = device;
+	this->blockSize = blockSize;
+	memoryProperties = physicalDevice.getMemoryProperties();
+
+	auto limits = physicalDevice.getProperties().limits;
+	granularity = std::max<vk::DeviceSize>(limits.bufferImageGranularity, 1);
+	atomSize = std::max<vk::DeviceSize>(limits.nonCoherentAtomSize, 1);
+	maxAllocationCount = limits.maxMemoryAllocationCount;
+
+	classCount = 0;
+	while ((MIN_CLASS_SIZE << classCount) <= blockSize / 2)
+		classCount++;
+
+	pools.resize(memoryProperties.memoryTypeCount * 2);
+	for (uint32_t i = 0; i < pools.size(); i++)
+	{
+		auto& pool = pools[i];
+		pool.memoryType = i / 2;
+
+		// Don't let a single block take a large share of a small heap
+		auto heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[pool.memoryType].heapIndex].size;
+		pool.blockSize = blockSize;
+		while (pool.blockSize > MIN_CLASS_SIZE * 2 && pool.blockSize > heapSize / 8)
+			pool.blockSize /= 2;
+		pool.freeLists.resize(classCount);
+	}
+}
+
+void MemoryAllocator::destroy()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& pool : pools)
+	{
+		for (auto& block : pool.blocks)
+			freeDeviceMemory(block.memory, block.size, block.mapped != nullptr);
+		pool.blocks.clear();
+		for (auto& freeList : pool.freeLists)
+			freeList.clear();
+	}
+	if (statistics.deviceAllocationCount > 0)
+		std::cout << "[Warning] " << statistics.deviceAllocationCount << " dedicated device memory allocations leaked\n";
+}
+
+MemoryAllocation MemoryAllocator::allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, ResourceKind kind)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+	auto alignment = std::max<vk::DeviceSize>(requirements.alignment, 1);
+
+	// Chunks of non-coherent memory have to be flushable without touching their neighbours
+	if (!isHostCoherent(memoryType) && (memoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible))
+		alignment = std::max(alignment, atomSize);
+
+	uint32_t sizeClass = sizeClassOf(std::max(requirements.size, alignment));
+	uint32_t index = poolIndex(memoryType, kind);
+	auto& pool = pools[index];
+
+	MemoryAllocation allocation;
+	allocation.size = requirements.size;
+	allocation.memoryType = memoryType;
+	allocation.pool = index;
+
+	if (sizeClass >= classCount || (MIN_CLASS_SIZE << sizeClass) > pool.blockSize / 2)
+	{
+		allocation.memory = allocateDeviceMemory(requirements.size, memoryType, &allocation.mapped);
+		allocation.sizeClass = DEDICATED_CLASS;
+		statistics.chunkBytes += requirements.size;
+		statistics.dedicatedAllocationCount++;
+	}
+	else
+	{
+		vk::DeviceSize classSize = MIN_CLASS_SIZE << sizeClass;
+		auto& freeList = pool.freeLists[sizeClass];
+
+		FreeChunk chunk = { UINT32_MAX, 0 };
+		if (!freeList.empty())
+		{
+			chunk = freeList.back();
+			freeList.pop_back();
+		}
+		else
+		{
+			// Chunks are placed at multiples of their own size, which covers any power-of-two alignment up to it
+			for (uint32_t i = 0; i < pool.blocks.size(); i++)
+			{
+				auto offset = alignUp(pool.blocks[i].head, classSize);
+				if (offset + classSize <= pool.blocks[i].size)
+				{
+					chunk = { i, offset };
+					break;
+				}
+			}
+			if (chunk.block == UINT32_MAX)
+			{
+				Block block;
+				block.size = pool.blockSize;
+				block.memory = allocateDeviceMemory(block.size, memoryType, &block.mapped);
+				pool.blocks.push_back(block);
+				chunk = { static_cast<uint32_t>(pool.blocks.size() - 1), 0 };
+			}
+			pool.blocks[chunk.block].head = chunk.offset + classSize;
+		}
+
+		auto& block = pool.blocks[chunk.block];
+		allocation.memory = block.memory;
+		allocation.offset = chunk.offset;
+		allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + chunk.offset : nullptr;
+		allocation.block = chunk.block;
+		allocation.sizeClass = sizeClass;
+		statistics.chunkBytes += classSize;
+	}
+
+	statistics.usedBytes += requirements.size;
+	statistics.allocationCount++;
+	return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+	if (!allocation)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (allocation.sizeClass == DEDICATED_CLASS)
+	{
+		freeDeviceMemory(allocation.memory, allocation.size, allocation.mapped != nullptr);
+		statistics.chunkBytes -= allocation.size;
+		statistics.dedicatedAllocationCount--;
+	}
+	else
+	{
+		pools[allocation.pool].freeLists[allocation.sizeClass].push_back({ allocation.block, allocation.offset });
+		statistics.chunkBytes -= MIN_CLASS_SIZE << allocation.sizeClass;
+	}
+
+	statistics.usedBytes -= allocation.size;
+	statistics.allocationCount--;
+	allocation = MemoryAllocation();
+}
+
+MemoryAllocation MemoryAllocator::allocateBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags properties)
+{
+	auto allocation = allocate(device.getBufferMemoryRequirements(buffer), properties, ResourceKind::Linear);
+	device.bindBufferMemory(buffer, allocation.memory, allocation.offset);
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::allocateImage(vk::Image image, vk::MemoryPropertyFlags properties)
+{
+	auto allocation = allocate(device.getImageMemoryRequirements(image), properties, ResourceKind::Optimal);
+	device.bindImageMemory(image, allocation.memory, allocation.offset);
+	return allocation;
+}
+
+LinearArena MemoryAllocator::createArena(vk::DeviceSize size, uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Arenas may mix buffers and images, so they always get memory of their own rather than a shared block
+	LinearArena arena;
+	arena.granularity = granularity;
+	arena.backing.memoryType = findMemoryType(typeFilter, properties);
+	arena.backing.memory = allocateDeviceMemory(size, arena.backing.memoryType, &arena.backing.mapped);
+	arena.backing.size = size;
+	arena.backing.sizeClass = DEDICATED_CLASS;
+
+	statistics.usedBytes += size;
+	statistics.chunkBytes += size;
+	statistics.allocationCount++;
+	statistics.dedicatedAllocationCount++;
+	return arena;
+}
+
+void MemoryAllocator::destroyArena(LinearArena& arena)
+{
+	free(arena.backing);
+	arena.reset();
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+	throw std::runtime_error("[Error] Failed to find suitable memory type");
+}
+
+bool MemoryAllocator::hasMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return true;
+	}
+	return false;
+}
+
+bool MemoryAllocator::isHostCoherent(uint32_t memoryType) const
+{
+	return static_cast<bool>(memoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+}
+
+MemoryStats MemoryAllocator::stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return statistics;
+}
+
+void MemoryAllocator::printStats() const
+{
+	auto s = stats();
+	std::cout << "[Memory] reserved: " << (s.reservedBytes >> 10) << " KiB (peak " << (s.peakReservedBytes >> 10) << " KiB)"
+		<< ", used: " << (s.usedBytes >> 10) << " KiB"
+		<< ", fragmentation: " << s.fragmentation() * 100.0 << "%\n"
+		<< "\t--allocations: " << s.allocationCount
+		<< ", device allocations: " << s.deviceAllocationCount << " / " << maxAllocationCount
+		<< " (" << s.dedicatedAllocationCount << " dedicated)\n";
+}
+
+uint32_t MemoryAllocator::poolIndex(uint32_t memoryType, ResourceKind kind) const
+{
+	// With a granularity of 1 linear and optimal resources may share blocks
+	if (granularity <= 1)
+		return memoryType * 2;
+	return memoryType * 2 + (kind == ResourceKind::Optimal ? 1 : 0);
+}
+
+uint32_t MemoryAllocator::sizeClassOf(vk::DeviceSize size) const
+{
+	uint32_t sizeClass = 0;
+	while ((MIN_CLASS_SIZE << sizeClass) < size)
+		sizeClass++;
+	return sizeClass;
+}
+
+vk::DeviceMemory MemoryAllocator::allocateDeviceMemory(vk::DeviceSize size, uint32_t memoryType, void** mapped)
+{
+	if (statistics.deviceAllocationCount >= maxAllocationCount)
+		throw std::runtime_error("[Error] maxMemoryAllocationCount exceeded");
+
+	auto allocInfo = vk::MemoryAllocateInfo()
+		.setAllocationSize(size)
+		.setMemoryTypeIndex(memoryType);
+
+	auto memory = device.allocateMemory(allocInfo);
+
+	*mapped = nullptr;
+	if (memoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+		*mapped = device.mapMemory(memory, 0, VK_WHOLE_SIZE);
+
+	statistics.reservedBytes += size;
+	statistics.peakReservedBytes = std::max(statistics.peakReservedBytes, statistics.reservedBytes);
+	statistics.deviceAllocationCount++;
+	return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(vk::DeviceMemory memory, vk::DeviceSize size, bool mapped)
+{
+	if (mapped)
+		device.unmapMemory(memory);
+	device.freeMemory(memory);
+
+	statistics.reservedBytes -= size;
+	statistics.deviceAllocationCount--;
+}
+
+MemoryAllocation LinearArena::allocate(vk::DeviceSize size, vk::DeviceSize alignment, ResourceKind kind)
+{
+	auto offset = alignUp(head, std::max<vk::DeviceSize>(alignment, 1));
+	if (head > 0 && kind != lastKind)
+		offset = alignUp(offset, granularity);
+
+	if (offset + size > backing.size)
+		return MemoryAllocation();
+
+	MemoryAllocation allocation = backing;
+	allocation.offset = backing.offset + offset;
+	allocation.size = size;
+	allocation.mapped = backing.mapped ? static_cast<char*>(backing.mapped) + offset : nullptr;
+
+	head = offset + size;
+	lastKind = kind;
+	return allocation;
+}
+
+void LinearArena::reset()
+{
+	head = 0;
+	lastKind = ResourceKind::Linear;
+}
+
+void BufferRing::init(MemoryAllocator& allocator, vk::Device device, vk::DeviceSize segmentSize, uint32_t segmentCount, vk::BufferUsageFlags usage)
+{
+	atomSize = allocator.nonCoherentAtomSize();
+	segment = alignUp(segmentSize, std::max<vk::DeviceSize>(atomSize, 256));
+
+	auto bufferInfo = vk::BufferCreateInfo()
+		.setSize(segment * segmentCount)
+		.setUsage(usage)
+		.setSharingMode(vk::SharingMode::eExclusive);
+
+	buffer = device.createBuffer(bufferInfo);
+
+	auto requirements = device.getBufferMemoryRequirements(buffer);
+	auto properties = vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eHostVisible);
+	if (allocator.hasMemoryType(requirements.memoryTypeBits, properties | vk::MemoryPropertyFlagBits::eHostCoherent))
+		properties |= vk::MemoryPropertyFlagBits::eHostCoherent;
+
+	allocation = allocator.allocateBuffer(buffer, properties);
+	coherent = allocator.isHostCoherent(allocation.memoryType);
+}
+
+void BufferRing::destroy(DeletionQueue& deletions)
+{
+	deletions.destroy(buffer);
+	deletions.free(allocation);
+	buffer = VK_NULL_HANDLE;
+}
+
+void BufferRing::beginFrame(uint32_t frameSlot)
+{
+	segmentBase = segment * frameSlot;
+	head = 0;
+	flushed = 0;
+}
+
+BufferRing::Range BufferRing::allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	auto offset = alignUp(segmentBase + head, std::max<vk::DeviceSize>(alignment, 1));
+	if (offset + size > segmentBase + segment)
+		return Range();
+
+	head = offset + size - segmentBase;
+
+	Range range;
+	range.buffer = buffer;
+	range.offset = offset;
+	range.mapped = static_cast<char*>(allocation.mapped) + offset;
+	return range;
+}
+
+void BufferRing::flush(vk::Device device)
+{
+	if (coherent || head == flushed)
+		return;
+
+	auto begin = (allocation.offset + segmentBase + flushed) / atomSize * atomSize;
+	auto end = alignUp(allocation.offset + segmentBase + head, atomSize);
+
+	auto range = vk::MappedMemoryRange()
+		.setMemory(allocation.memory)
+		.setOffset(begin)
+		.setSize(end - begin);
+
+	// Pooled chunks are whole multiples of the atom size, only a dedicated allocation can end early
+	if (allocation.sizeClass == MemoryAllocator::DEDICATED_CLASS && end > allocation.size)
+		range.setSize(VK_WHOLE_SIZE);
+
+	device.flushMappedMemoryRanges({ range });
+	flushed = head;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+// Buffers and linear images must not share a bufferImageGranularity page with optimal images
+enum class ResourceKind
+{
+	Linear,
+	Optimal
+};
+
+struct MemoryAllocation
+{
+	vk::DeviceMemory memory;
+	vk::DeviceSize offset = 0;
+	vk::DeviceSize size = 0;
+	// Persistently mapped pointer to offset, null unless the memory is host visible
+	void* mapped = nullptr;
+
+	uint32_t memoryType = 0;
+	uint32_t pool = 0;
+	uint32_t block = 0;
+	uint32_t sizeClass = 0;
+
+	explicit operator bool() const { return static_cast<bool>(memory); }
+};
+
+struct MemoryStats
+{
+	vk::DeviceSize reservedBytes = 0;
+	vk::DeviceSize peakReservedBytes = 0;
+	// Bytes actually requested by live allocations
+	vk::DeviceSize usedBytes = 0;
+	// Bytes handed out in size-class chunks, the difference to usedBytes is internal fragmentation
+	vk::DeviceSize chunkBytes = 0;
+	uint32_t allocationCount = 0;
+	uint32_t deviceAllocationCount = 0;
+	uint32_t dedicatedAllocationCount = 0;
+
+	double fragmentation() const { return reservedBytes ? 1.0 - double(usedBytes) / double(reservedBytes) : 0.0; }
+};
+
+class LinearArena;
+class DeletionQueue;
+
+// Allocates large blocks per memory type and sub-allocates them with power-of-two size classes.
+// Freed chunks go to a per-class free list; requests larger than half a block get their own vk::DeviceMemory.
+class MemoryAllocator
+{
+public:
+	static constexpr vk::DeviceSize MIN_CLASS_SIZE = 256;
+	static constexpr uint32_t DEDICATED_CLASS = UINT32_MAX;
+
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, vk::DeviceSize blockSize = 64ull << 20);
+	void destroy();
+
+	MemoryAllocation allocate(const vk::MemoryRequirements& requirements, vk::MemoryPropertyFlags properties, ResourceKind kind);
+	void free(MemoryAllocation& allocation);
+
+	// Allocate and bind in one step
+	MemoryAllocation allocateBuffer(vk::Buffer buffer, vk::MemoryPropertyFlags properties);
+	MemoryAllocation allocateImage(vk::Image image, vk::MemoryPropertyFlags properties);
+
+	LinearArena createArena(vk::DeviceSize size, uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+	void destroyArena(LinearArena& arena);
+
+	uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
+	bool hasMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
+	bool isHostCoherent(uint32_t memoryType) const;
+	vk::DeviceSize bufferImageGranularity() const { return granularity; }
+	vk::DeviceSize nonCoherentAtomSize() const { return atomSize; }
+
+	MemoryStats stats() const;
+	void printStats() const;
+
+private:
+	struct Block
+	{
+		vk::DeviceMemory memory;
+		vk::DeviceSize size = 0;
+		vk::DeviceSize head = 0;
+		void* mapped = nullptr;
+	};
+
+	struct FreeChunk
+	{
+		uint32_t block;
+		vk::DeviceSize offset;
+	};
+
+	struct Pool
+	{
+		uint32_t memoryType = 0;
+		vk::DeviceSize blockSize = 0;
+		std::vector<Block> blocks;
+		std::vector<std::vector<FreeChunk>> freeLists;
+	};
+
+	uint32_t poolIndex(uint32_t memoryType, ResourceKind kind) const;
+	uint32_t sizeClassOf(vk::DeviceSize size) const;
+	vk::DeviceMemory allocateDeviceMemory(vk::DeviceSize size, uint32_t memoryType, void** mapped);
+	void freeDeviceMemory(vk::DeviceMemory memory, vk::DeviceSize size, bool mapped);
+
+private:
+	vk::Device device;
+	vk::PhysicalDeviceMemoryProperties memoryProperties;
+	vk::DeviceSize blockSize = 0;
+	vk::DeviceSize granularity = 1;
+	vk::DeviceSize atomSize = 1;
+	uint32_t maxAllocationCount = 0;
+	uint32_t classCount = 0;
+
+	// Two pools per memory type, one per ResourceKind
+	std::vector<Pool> pools;
+	MemoryStats statistics;
+	mutable std::mutex mutex;
+};
+
+// Bump allocator over a single allocation, released in bulk with reset().
+// Allocations returned by it must never be passed to MemoryAllocator::free.
+class LinearArena
+{
+public:
+	MemoryAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment, ResourceKind kind = ResourceKind::Linear);
+	void reset();
+
+	const MemoryAllocation& allocation() const { return backing; }
+	vk::DeviceSize used() const { return head; }
+	vk::DeviceSize capacity() const { return backing.size; }
+
+private:
+	friend class MemoryAllocator;
+
+	MemoryAllocation backing;
+	vk::DeviceSize head = 0;
+	vk::DeviceSize granularity = 1;
+	ResourceKind lastKind = ResourceKind::Linear;
+};
+
+// Persistently mapped host-visible buffer split into one linear segment per frame in flight.
+// A segment is reset when its frame slot comes around again, i.e. once the GPU has finished with it.
+class BufferRing
+{
+public:
+	struct Range
+	{
+		vk::Buffer buffer;
+		vk::DeviceSize offset = 0;
+		void* mapped = nullptr;
+	};
+
+	void init(MemoryAllocator& allocator, vk::Device device, vk::DeviceSize segmentSize, uint32_t segmentCount, vk::BufferUsageFlags usage);
+	void destroy(DeletionQueue& deletions);
+
+	void beginFrame(uint32_t frameSlot);
+	// Returns an empty range when the current segment is exhausted
+	Range allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+	// Required before the GPU reads data written through mapped pointers on non-coherent memory
+	void flush(vk::Device device);
+
+	vk::Buffer handle() const { return buffer; }
+	vk::DeviceSize segmentSize() const { return segment; }
+	vk::DeviceSize remaining() const { return segment - head; }
+
+private:
+	vk::Buffer buffer;
+	MemoryAllocation allocation;
+	vk::DeviceSize segment = 0;
+	vk::DeviceSize segmentBase = 0;
+	vk::DeviceSize head = 0;
+	vk::DeviceSize flushed = 0;
+	vk::DeviceSize atomSize = 1;
+	bool coherent = true;
+};
@@ -0,0 +1,675 @@
+#include "MeshCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+// Tipsify clusters are merged up to this size before they are sorted for overdraw, smaller ones cost too many cache misses at their seams
+const uint32_t MIN_CLUSTER_TRIANGLES = 64;
+
+static uint64_t alignSection(uint64_t offset)
+{
+	return (offset + 15) & ~uint64_t(15);
+}
+
+static int16_t toSnorm16(float value)
+{
+	return static_cast<int16_t>(std::round(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f));
+}
+
+static uint8_t toUnorm8(float value)
+{
+	return static_cast<uint8_t>(std::round(std::max(0.0f, std::min(1.0f, value)) * 255.0f));
+}
+
+// Round to nearest even, overflow goes to infinity
+static uint16_t toHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t biased = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+	if (biased == 0xff)
+		return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+	int32_t exponent = static_cast<int32_t>(biased) - 127 + 15;
+	if (exponent >= 31)
+		return static_cast<uint16_t>(sign | 0x7c00);
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return static_cast<uint16_t>(sign);
+		mantissa |= 0x800000;
+		uint32_t shift = static_cast<uint32_t>(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	// A carry out of the mantissa correctly bumps the exponent
+	uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return static_cast<uint16_t>(sign | half);
+}
+
+// Projects the unit sphere onto an octahedron and unfolds it into the [-1, 1] square
+static glm::vec2 octahedralEncode(glm::vec3 normal)
+{
+	float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length == 0.0f)
+		return glm::vec2(0.0f);
+	normal /= length;
+	glm::vec2 encoded(normal.x, normal.y);
+	if (normal.z < 0.0f)
+	{
+		encoded.x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+		encoded.y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return encoded;
+}
+
+// Average cache miss ratio, misses per triangle, of a FIFO cache as found in most hardware
+static double averageCacheMissRatio(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	if (indices.empty())
+		return 0.0;
+
+	std::vector<int64_t> insertedAt(vertexCount, INT64_MIN / 2);
+	int64_t misses = 0;
+	for (auto index : indices)
+	{
+		if (misses - insertedAt[index] < cacheSize)
+			continue;
+		insertedAt[index] = misses;
+		misses++;
+	}
+	return double(misses) / double(indices.size() / 3);
+}
+
+// Tipsify (Sander, Nehab and Barczak 2007): emits all triangles around a fanning vertex, then continues with
+// the emitted vertex that will stay in the cache while its remaining triangles go out. Where no such vertex
+// exists it jumps to a recent dead end or the next unfinished vertex, and a new cluster starts there.
+static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize,
+	std::vector<uint32_t>& clusterStarts)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	// Triangles around each vertex
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (auto index : indices)
+		adjacencyOffsets[index + 1]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		for (uint32_t k = 0; k < 3; k++)
+			adjacency[fill[indices[3 * t + k]]++] = t;
+	}
+
+	std::vector<uint32_t> live(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		live[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t time = cacheSize + 1;
+	uint32_t cursor = 0;
+	auto skipDeadEnd = [&]() -> int64_t
+	{
+		while (!deadEnds.empty())
+		{
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[vertex] > 0)
+				return vertex;
+		}
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (live[cursor] > 0)
+				return cursor;
+		}
+		return -1;
+	};
+
+	clusterStarts.clear();
+	int64_t fan = skipDeadEnd();
+	if (fan >= 0)
+		clusterStarts.push_back(0);
+	while (fan >= 0)
+	{
+		candidates.clear();
+		for (uint32_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++)
+		{
+			uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t vertex = indices[3 * t + k];
+				result.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+				if (time - timestamps[vertex] > cacheSize)
+					timestamps[vertex] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		int64_t next = -1;
+		int64_t best = -1;
+		for (auto vertex : candidates)
+		{
+			if (live[vertex] == 0)
+				continue;
+			int64_t priority = 0;
+			if (time - timestamps[vertex] + 2 * live[vertex] <= cacheSize)
+				priority = time - timestamps[vertex];
+			if (priority > best)
+			{
+				best = priority;
+				next = vertex;
+			}
+		}
+		if (next < 0)
+		{
+			next = skipDeadEnd();
+			if (next >= 0)
+				clusterStarts.push_back(static_cast<uint32_t>(result.size() / 3));
+		}
+		fan = next;
+	}
+	return result;
+}
+
+// Clusters facing away from the mesh center go first: drawn early they occlude the inner and back-facing
+// ones from most viewpoints (Sander et al., simplified to a static sort without a view-dependent pass)
+static std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions,
+	const std::vector<uint32_t>& clusterStarts)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	std::vector<uint32_t> starts;
+	for (auto start : clusterStarts)
+	{
+		if (starts.empty() || start - starts.back() >= MIN_CLUSTER_TRIANGLES)
+			starts.push_back(start);
+	}
+	if (starts.size() < 2)
+		return indices;
+
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	std::vector<glm::vec3> centers(starts.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(starts.size(), glm::vec3(0.0f));
+	std::vector<float> areas(starts.size(), 0.0f);
+	for (size_t c = 0; c < starts.size(); c++)
+	{
+		uint32_t end = c + 1 < starts.size() ? starts[c + 1] : triangleCount;
+		for (uint32_t t = starts[c]; t < end; t++)
+		{
+			const auto& a = positions[indices[3 * t]];
+			const auto& b = positions[indices[3 * t + 1]];
+			const auto& d = positions[indices[3 * t + 2]];
+			glm::vec3 normal = glm::cross(b - a, d - a);
+			float area = glm::length(normal);
+			centers[c] += (a + b + d) * (area / 3.0f);
+			normals[c] += normal;
+			areas[c] += area;
+		}
+		meshCenter += centers[c];
+		meshArea += areas[c];
+	}
+	if (meshArea <= 0.0f)
+		return indices;
+	meshCenter /= meshArea;
+
+	std::vector<float> keys(starts.size(), 0.0f);
+	for (size_t c = 0; c < starts.size(); c++)
+	{
+		float length = glm::length(normals[c]);
+		if (areas[c] > 0.0f && length > 0.0f)
+			keys[c] = glm::dot(centers[c] / areas[c] - meshCenter, normals[c] / length);
+	}
+
+	std::vector<uint32_t> order(starts.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (auto c : order)
+	{
+		uint32_t end = c + 1 < starts.size() ? starts[c + 1] : triangleCount;
+		result.insert(result.end(), indices.begin() + 3 * starts[c], indices.begin() + 3 * end);
+	}
+	return result;
+}
+
+static void boundingSphere(const std::vector<glm::vec3>& positions, const uint32_t* vertices, size_t count, float center[3], float& radius)
+{
+	glm::vec3 low(INFINITY), high(-INFINITY);
+	for (size_t i = 0; i < count; i++)
+	{
+		low = glm::min(low, positions[vertices[i]]);
+		high = glm::max(high, positions[vertices[i]]);
+	}
+	glm::vec3 middle = count > 0 ? (low + high) * 0.5f : glm::vec3(0.0f);
+	radius = 0.0f;
+	for (size_t i = 0; i < count; i++)
+		radius = std::max(radius, glm::length(positions[vertices[i]] - middle));
+	center[0] = middle.x;
+	center[1] = middle.y;
+	center[2] = middle.z;
+}
+
+void MeshCooker::addMesh(const std::string& name, const std::vector<CookVertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	SourceMesh mesh;
+	mesh.name = name;
+	mesh.vertices = vertices;
+	mesh.indices = indices;
+	mesh.indices.resize(indices.size() / 3 * 3);
+	meshes.push_back(std::move(mesh));
+}
+
+bool MeshCooker::loadObj(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cout << "[Error] Failed to open " << filename << "\n";
+		return false;
+	}
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec4> colors;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texCoords;
+	bool anyColors = false;
+
+	// Corners are kept unindexed, vertices are deduplicated after quantization anyway
+	SourceMesh current;
+	current.name = filename;
+	auto finishMesh = [&](const std::string& nextName)
+	{
+		if (!current.indices.empty())
+			meshes.push_back(std::move(current));
+		current = SourceMesh();
+		current.name = nextName;
+	};
+
+	// 1-based, negative counts back from the last element read so far
+	auto resolve = [](long index, size_t count) -> long
+	{
+		return index > 0 ? index - 1 : static_cast<long>(count) + index;
+	};
+
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+		if (keyword == "v")
+		{
+			glm::vec3 position(0.0f);
+			glm::vec4 color(1.0f);
+			stream >> position.x >> position.y >> position.z;
+			if (stream >> color.r >> color.g >> color.b)
+				anyColors = true;
+			positions.push_back(position);
+			colors.push_back(color);
+		}
+		else if (keyword == "vn")
+		{
+			glm::vec3 normal(0.0f);
+			stream >> normal.x >> normal.y >> normal.z;
+			normals.push_back(normal);
+		}
+		else if (keyword == "vt")
+		{
+			glm::vec2 texCoord(0.0f);
+			stream >> texCoord.x >> texCoord.y;
+			texCoords.push_back(texCoord);
+		}
+		else if (keyword == "o" || keyword == "g")
+		{
+			std::string name;
+			std::getline(stream >> std::ws, name);
+			finishMesh(name.empty() ? filename : name);
+		}
+		else if (keyword == "f")
+		{
+			std::vector<CookVertex> polygon;
+			std::string corner;
+			while (stream >> corner)
+			{
+				// p, p/t, p//n or p/t/n
+				long indices[3] = { 0, 0, 0 };
+				size_t start = 0;
+				for (int i = 0; i < 3 && start <= corner.size(); i++)
+				{
+					size_t end = corner.find('/', start);
+					std::string part = corner.substr(start, end == std::string::npos ? std::string::npos : end - start);
+					if (!part.empty())
+						indices[i] = std::strtol(part.c_str(), nullptr, 10);
+					if (end == std::string::npos)
+						break;
+					start = end + 1;
+				}
+
+				long p = resolve(indices[0], positions.size());
+				long t = indices[1] ? resolve(indices[1], texCoords.size()) : -1;
+				long n = indices[2] ? resolve(indices[2], normals.size()) : -1;
+				if (p < 0 || p >= static_cast<long>(positions.size()) || t >= static_cast<long>(texCoords.size()) ||
+					n >= static_cast<long>(normals.size()) || (indices[1] && t < 0) || (indices[2] && n < 0))
+				{
+					std::cout << "[Error] " << filename << ":" << lineNumber << ": index out of range\n";
+					return false;
+				}
+
+				CookVertex vertex;
+				vertex.position = positions[p];
+				vertex.color = colors[p];
+				if (t >= 0)
+					vertex.texCoord = texCoords[t];
+				if (n >= 0)
+					vertex.normal = normals[n];
+				polygon.push_back(vertex);
+			}
+
+			// Polygons are triangulated as fans
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				for (size_t corner : { size_t(0), i - 1, i })
+				{
+					current.indices.push_back(static_cast<uint32_t>(current.vertices.size()));
+					current.vertices.push_back(polygon[corner]);
+				}
+			}
+		}
+	}
+	finishMesh(std::string());
+
+	// Without vertex colors the normals tint the mesh, so it is not a flat silhouette
+	if (!anyColors && !normals.empty())
+	{
+		for (auto& mesh : meshes)
+		{
+			for (auto& vertex : mesh.vertices)
+				vertex.color = glm::vec4(glm::normalize(vertex.normal) * 0.5f + 0.5f, 1.0f);
+		}
+	}
+
+	hasNormals = hasNormals || !normals.empty();
+	hasTexCoords = hasTexCoords || !texCoords.empty();
+	return true;
+}
+
+bool MeshCooker::write(const std::string& filename)
+{
+	if (meshes.empty())
+	{
+		std::cout << "[Error] No meshes to write\n";
+		return false;
+	}
+	stats = Stats();
+
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+
+	// Layout: quantized position, then the optional attributes, then the color
+	auto addAttribute = [&](MeshSemantic semantic, MeshAttributeFormat format, uint32_t size)
+	{
+		header.attributes[header.attributeCount++] = { semantic, format, header.vertexStride };
+		header.vertexStride += size;
+	};
+	addAttribute(MeshSemantic::Position, MeshAttributeFormat::Snorm16x4, 8);
+	if (hasNormals)
+		addAttribute(MeshSemantic::Normal, MeshAttributeFormat::Snorm16x2, 4);
+	if (hasTexCoords)
+		addAttribute(MeshSemantic::TexCoord, MeshAttributeFormat::Half2, 4);
+	addAttribute(MeshSemantic::Color, MeshAttributeFormat::Unorm8x4, 4);
+
+	// One set of bounds for the whole file, so the meshes share a dequantization transform
+	glm::vec3 low(INFINITY), high(-INFINITY);
+	for (const auto& mesh : meshes)
+	{
+		for (const auto& vertex : mesh.vertices)
+		{
+			low = glm::min(low, vertex.position);
+			high = glm::max(high, vertex.position);
+		}
+	}
+	glm::vec3 center = (low + high) * 0.5f;
+	glm::vec3 extent = glm::max((high - low) * 0.5f, glm::vec3(1e-6f));
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.positionScale[axis] = extent[axis];
+		header.positionOffset[axis] = center[axis];
+	}
+
+	std::vector<uint8_t> vertexData;
+	std::vector<uint32_t> indexData;
+	std::vector<MeshEntry> entries;
+	std::vector<MeshletEntry> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	bool wideIndices = false;
+
+	uint32_t stride = header.vertexStride;
+	for (const auto& mesh : meshes)
+	{
+		// Quantize, then merge vertices whose bytes came out identical
+		std::vector<uint8_t> unique;
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices(mesh.indices.size());
+		std::unordered_map<std::string, uint32_t> lookup;
+		std::string bytes(stride, '\0');
+		std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+		{
+			uint32_t source = mesh.indices[i];
+			if (remap[source] == UINT32_MAX)
+			{
+				const auto& vertex = mesh.vertices[source];
+				glm::vec3 quantized = (vertex.position - center) / extent;
+				// w is 1.0 so the attribute also reads as a homogeneous point
+				int16_t position[4] = { toSnorm16(quantized.x), toSnorm16(quantized.y), toSnorm16(quantized.z), 32767 };
+				std::memcpy(&bytes[0], position, sizeof(position));
+				uint32_t offset = sizeof(position);
+				if (hasNormals)
+				{
+					glm::vec2 encoded = octahedralEncode(vertex.normal);
+					int16_t normal[2] = { toSnorm16(encoded.x), toSnorm16(encoded.y) };
+					std::memcpy(&bytes[offset], normal, sizeof(normal));
+					offset += sizeof(normal);
+				}
+				if (hasTexCoords)
+				{
+					uint16_t texCoord[2] = { toHalf(vertex.texCoord.x), toHalf(vertex.texCoord.y) };
+					std::memcpy(&bytes[offset], texCoord, sizeof(texCoord));
+					offset += sizeof(texCoord);
+				}
+				uint8_t color[4] = { toUnorm8(vertex.color.r), toUnorm8(vertex.color.g), toUnorm8(vertex.color.b), toUnorm8(vertex.color.a) };
+				std::memcpy(&bytes[offset], color, sizeof(color));
+
+				auto inserted = lookup.emplace(bytes, static_cast<uint32_t>(positions.size()));
+				if (inserted.second)
+				{
+					unique.insert(unique.end(), bytes.begin(), bytes.end());
+					positions.push_back(vertex.position);
+				}
+				remap[source] = inserted.first->second;
+			}
+			indices[i] = remap[source];
+		}
+		uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+
+		stats.sourceVertices += mesh.vertices.size();
+		stats.triangles += indices.size() / 3;
+		stats.acmrBefore += averageCacheMissRatio(indices, vertexCount, cacheSize) * double(indices.size() / 3);
+
+		std::vector<uint32_t> clusterStarts;
+		indices = optimizeVertexCache(indices, vertexCount, cacheSize, clusterStarts);
+		indices = optimizeOverdraw(indices, positions, clusterStarts);
+		stats.acmrAfter += averageCacheMissRatio(indices, vertexCount, cacheSize) * double(indices.size() / 3);
+
+		// Vertices in the order the triangles first reference them, so fetches walk memory forwards
+		std::vector<uint32_t> fetchOrder(vertexCount, UINT32_MAX);
+		std::vector<glm::vec3> orderedPositions;
+		uint32_t firstVertex = static_cast<uint32_t>(vertexData.size() / stride);
+		for (auto& index : indices)
+		{
+			if (fetchOrder[index] == UINT32_MAX)
+			{
+				fetchOrder[index] = static_cast<uint32_t>(orderedPositions.size());
+				orderedPositions.push_back(positions[index]);
+				vertexData.insert(vertexData.end(), unique.begin() + size_t(index) * stride, unique.begin() + size_t(index + 1) * stride);
+			}
+			index = fetchOrder[index];
+		}
+		uint32_t usedVertices = static_cast<uint32_t>(orderedPositions.size());
+		wideIndices = wideIndices || usedVertices > 65536;
+
+		MeshEntry entry = {};
+		entry.firstIndex = static_cast<uint32_t>(indexData.size());
+		entry.indexCount = static_cast<uint32_t>(indices.size());
+		entry.vertexOffset = static_cast<int32_t>(firstVertex);
+		entry.vertexCount = usedVertices;
+		entry.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+		std::vector<uint32_t> all(usedVertices);
+		std::iota(all.begin(), all.end(), 0);
+		boundingSphere(orderedPositions, all.data(), all.size(), entry.center, entry.radius);
+		indexData.insert(indexData.end(), indices.begin(), indices.end());
+
+		// Greedy meshlets over the optimized order, which keeps each one spatially compact
+		std::vector<uint32_t> localIndex(usedVertices, UINT32_MAX);
+		MeshletEntry meshlet = {};
+		auto closeMeshlet = [&]()
+		{
+			if (meshlet.triangleCount == 0)
+				return;
+			const uint32_t* vertices = meshletVertices.data() + meshlet.vertexOffset;
+			boundingSphere(orderedPositions, vertices, meshlet.vertexCount, meshlet.center, meshlet.radius);
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+				localIndex[vertices[i]] = UINT32_MAX;
+			meshlets.push_back(meshlet);
+			meshlet = {};
+			meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size() / 3);
+		};
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size() / 3);
+		for (size_t t = 0; t < indices.size() / 3; t++)
+		{
+			uint32_t newVertices = 0;
+			for (uint32_t k = 0; k < 3; k++)
+				newVertices += localIndex[indices[3 * t + k]] == UINT32_MAX ? 1 : 0;
+			if (meshlet.vertexCount + newVertices > MESHLET_MAX_VERTICES || meshlet.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+				closeMeshlet();
+
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t vertex = indices[3 * t + k];
+				if (localIndex[vertex] == UINT32_MAX)
+				{
+					localIndex[vertex] = meshlet.vertexCount++;
+					meshletVertices.push_back(vertex);
+				}
+				meshletTriangles.push_back(static_cast<uint8_t>(localIndex[vertex]));
+			}
+			meshlet.triangleCount++;
+		}
+		closeMeshlet();
+		entry.meshletCount = static_cast<uint32_t>(meshlets.size()) - entry.firstMeshlet;
+		entries.push_back(entry);
+	}
+
+	header.vertexCount = static_cast<uint32_t>(vertexData.size() / stride);
+	header.indexCount = static_cast<uint32_t>(indexData.size());
+	header.indexSize = wideIndices ? 4 : 2;
+	header.meshCount = static_cast<uint32_t>(entries.size());
+	header.meshletCount = static_cast<uint32_t>(meshlets.size());
+	header.meshletVertexCount = static_cast<uint32_t>(meshletVertices.size());
+	header.meshletTriangleCount = static_cast<uint32_t>(meshletTriangles.size() / 3);
+
+	header.vertexOffset = alignSection(sizeof(header));
+	header.indexOffset = alignSection(header.vertexOffset + vertexData.size());
+	header.meshOffset = alignSection(header.indexOffset + uint64_t(header.indexCount) * header.indexSize);
+	header.meshletOffset = alignSection(header.meshOffset + entries.size() * sizeof(MeshEntry));
+	header.meshletVertexOffset = alignSection(header.meshletOffset + meshlets.size() * sizeof(MeshletEntry));
+	header.meshletTriangleOffset = alignSection(header.meshletVertexOffset + meshletVertices.size() * sizeof(uint32_t));
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "[Error] Failed to create " << filename << "\n";
+		return false;
+	}
+
+	auto writeSection = [&](uint64_t offset, const void* data, size_t size)
+	{
+		static const char padding[16] = {};
+		file.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeSection(header.vertexOffset, vertexData.data(), vertexData.size());
+	if (wideIndices)
+		writeSection(header.indexOffset, indexData.data(), indexData.size() * sizeof(uint32_t));
+	else
+	{
+		std::vector<uint16_t> narrow(indexData.begin(), indexData.end());
+		writeSection(header.indexOffset, narrow.data(), narrow.size() * sizeof(uint16_t));
+	}
+	writeSection(header.meshOffset, entries.data(), entries.size() * sizeof(MeshEntry));
+	writeSection(header.meshletOffset, meshlets.data(), meshlets.size() * sizeof(MeshletEntry));
+	writeSection(header.meshletVertexOffset, meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+	writeSection(header.meshletTriangleOffset, meshletTriangles.data(), meshletTriangles.size());
+	if (!file)
+	{
+		std::cout << "[Error] Failed to write " << filename << "\n";
+		return false;
+	}
+
+	stats.vertices = header.vertexCount;
+	stats.meshlets = header.meshletCount;
+	stats.sourceBytes = stats.sourceVertices * (sizeof(glm::vec3) * 2 + sizeof(glm::vec2) + sizeof(glm::vec4)) + stats.triangles * 3 * sizeof(uint32_t);
+	stats.bytes = static_cast<uint64_t>(file.tellp());
+	if (stats.triangles > 0)
+	{
+		stats.acmrBefore /= double(stats.triangles);
+		stats.acmrAfter /= double(stats.triangles);
+	}
+	return true;
+}
+
+void MeshCooker::printStats() const
+{
+	std::cout << "[MeshCook] " << meshes.size() << " meshes, " << stats.triangles << " triangles\n"
+		<< "\t--Vertices: " << stats.sourceVertices << " corners -> " << stats.vertices << " unique after quantization\n"
+		<< "\t--Cache misses per triangle (" << cacheSize << " entry FIFO): " << stats.acmrBefore << " -> " << stats.acmrAfter << "\n"
+		<< "\t--Meshlets: " << stats.meshlets << " of up to " << MESHLET_MAX_VERTICES << " vertices and " << MESHLET_MAX_TRIANGLES << " triangles\n"
+		<< "\t--Size: " << stats.sourceBytes / 1024 << " KiB unindexed float -> " << stats.bytes / 1024 << " KiB\n";
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "MeshFormat.h"
+
+struct CookVertex
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 normal = glm::vec3(0.0f, 0.0f, 1.0f);
+	glm::vec2 texCoord = glm::vec2(0.0f);
+	glm::vec4 color = glm::vec4(1.0f);
+};
+
+// Offline half of the mesh format. Vertices are quantized and deduplicated on their quantized bytes,
+// triangles reordered for the post-transform cache with Tipsify and then, cluster by cluster, front to back
+// from the outside in to cut overdraw, vertices renumbered in fetch order and the result split into meshlets.
+class MeshCooker
+{
+public:
+	// Triangle list; every mesh of a file shares its vertex layout and quantization bounds
+	void addMesh(const std::string& name, const std::vector<CookVertex>& vertices, const std::vector<uint32_t>& indices);
+	// Wavefront OBJ; each o or g statement starts a new mesh, "v x y z r g b" vertex colors are picked up.
+	// Enables the attributes the file provides.
+	bool loadObj(const std::string& filename);
+
+	// Positions and colors are always written, the rest only when enabled
+	void setAttributes(bool normals, bool texCoords) { hasNormals = normals; hasTexCoords = texCoords; }
+
+	void setCacheSize(uint32_t size) { cacheSize = size; }
+	bool write(const std::string& filename);
+
+	void printStats() const;
+
+private:
+	struct SourceMesh
+	{
+		std::string name;
+		std::vector<CookVertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	struct Stats
+	{
+		uint64_t sourceVertices = 0;
+		uint64_t vertices = 0;
+		uint64_t triangles = 0;
+		uint64_t sourceBytes = 0;
+		uint64_t bytes = 0;
+		double acmrBefore = 0.0;
+		double acmrAfter = 0.0;
+		uint32_t meshlets = 0;
+	};
+
+private:
+	std::vector<SourceMesh> meshes;
+	bool hasNormals = false;
+	bool hasTexCoords = false;
+	uint32_t cacheSize = 16;
+	Stats stats;
+};
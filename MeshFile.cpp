@@ -0,0 +1,128 @@
+#include "MeshFile.h"
+
+#include <iostream>
+
+static vk::Format attributeFormat(MeshAttributeFormat format)
+{
+	switch (format)
+	{
+	case MeshAttributeFormat::Snorm16x4:
+		return vk::Format::eR16G16B16A16Snorm;
+	case MeshAttributeFormat::Snorm16x2:
+		return vk::Format::eR16G16Snorm;
+	case MeshAttributeFormat::Half2:
+		return vk::Format::eR16G16Sfloat;
+	case MeshAttributeFormat::Unorm8x4:
+		return vk::Format::eR8G8B8A8Unorm;
+	}
+	return vk::Format::eUndefined;
+}
+
+static uint32_t attributeSize(MeshAttributeFormat format)
+{
+	return format == MeshAttributeFormat::Snorm16x4 ? 8 : 4;
+}
+
+void MeshFile::open(const std::string& filename)
+{
+	name = filename;
+	if (!file.open(filename))
+		throw std::runtime_error("[Error] Failed to open mesh " + filename);
+
+	auto fail = [&](const std::string& reason)
+	{
+		file.close();
+		throw std::runtime_error("[Error] Invalid mesh " + filename + ": " + reason);
+	};
+
+	if (file.size() < sizeof(MeshFileHeader))
+		fail("truncated header");
+	const auto& info = header();
+	if (info.magic != MESH_FILE_MAGIC)
+		fail("not a mesh file");
+	if (info.version != MESH_FILE_VERSION)
+		fail("version " + std::to_string(info.version) + ", expected " + std::to_string(MESH_FILE_VERSION));
+	if (info.indexSize != 2 && info.indexSize != 4)
+		fail("index size " + std::to_string(info.indexSize));
+	if (info.attributeCount == 0 || info.attributeCount > MESH_MAX_ATTRIBUTES || info.vertexStride == 0)
+		fail("bad vertex layout");
+
+	bool position = false;
+	for (uint32_t i = 0; i < info.attributeCount; i++)
+	{
+		const auto& attribute = info.attributes[i];
+		if (attributeFormat(attribute.format) == vk::Format::eUndefined || attribute.offset + attributeSize(attribute.format) > info.vertexStride)
+			fail("bad attribute " + std::to_string(i));
+		position = position || attribute.semantic == MeshSemantic::Position;
+	}
+	if (!position)
+		fail("no positions");
+
+	// Sections are cast in place, they have to lie within the file and keep their natural alignment
+	auto section = [&](uint64_t offset, uint64_t size, const char* what)
+	{
+		if (offset % 16 != 0 || offset > file.size() || size > file.size() - offset)
+			fail(std::string("truncated ") + what);
+	};
+	section(info.vertexOffset, uint64_t(info.vertexCount) * info.vertexStride, "vertices");
+	section(info.indexOffset, uint64_t(info.indexCount) * info.indexSize, "indices");
+	section(info.meshOffset, uint64_t(info.meshCount) * sizeof(MeshEntry), "meshes");
+	section(info.meshletOffset, uint64_t(info.meshletCount) * sizeof(MeshletEntry), "meshlets");
+	section(info.meshletVertexOffset, uint64_t(info.meshletVertexCount) * sizeof(uint32_t), "meshlet vertices");
+	section(info.meshletTriangleOffset, uint64_t(info.meshletTriangleCount) * 3, "meshlet triangles");
+
+	if (info.meshCount == 0)
+		fail("no meshes");
+	for (uint32_t i = 0; i < info.meshCount; i++)
+	{
+		const auto& entry = mesh(i);
+		if (uint64_t(entry.firstIndex) + entry.indexCount > info.indexCount || entry.vertexOffset < 0 ||
+			uint64_t(entry.vertexOffset) + entry.vertexCount > info.vertexCount ||
+			uint64_t(entry.firstMeshlet) + entry.meshletCount > info.meshletCount)
+			fail("bad mesh " + std::to_string(i));
+	}
+}
+
+vk::VertexInputBindingDescription MeshFile::bindingDescription(uint32_t binding) const
+{
+	return vk::VertexInputBindingDescription()
+		.setBinding(binding)
+		.setStride(header().vertexStride)
+		.setInputRate(vk::VertexInputRate::eVertex);
+}
+
+std::vector<vk::VertexInputAttributeDescription> MeshFile::attributeDescriptions(uint32_t binding) const
+{
+	// Normalized formats are expanded to floats by the input assembler, the shaders see plain vectors
+	std::vector<vk::VertexInputAttributeDescription> attributes;
+	for (uint32_t i = 0; i < header().attributeCount; i++)
+	{
+		const auto& attribute = header().attributes[i];
+		attributes.push_back(vk::VertexInputAttributeDescription()
+			.setLocation(static_cast<uint32_t>(attribute.semantic))
+			.setBinding(binding)
+			.setFormat(attributeFormat(attribute.format))
+			.setOffset(attribute.offset));
+	}
+	return attributes;
+}
+
+glm::mat4 MeshFile::dequantization() const
+{
+	const auto& info = header();
+	glm::mat4 transform(1.0f);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		transform[axis][axis] = info.positionScale[axis];
+		transform[3][axis] = info.positionOffset[axis];
+	}
+	return transform;
+}
+
+void MeshFile::printStats() const
+{
+	const auto& info = header();
+	std::cout << "[Mesh] " << name << ": " << info.meshCount << " meshes, " << info.vertexCount << " vertices of "
+		<< info.vertexStride << " bytes, " << info.indexCount / 3 << " triangles with " << info.indexSize * 8 << " bit indices, "
+		<< info.meshletCount << " meshlets, " << (vertexBytes() + indexBytes()) / 1024 << " KiB of geometry\n";
+}
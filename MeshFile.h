@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshFormat.h"
+
+// A cooked mesh file mapped into memory. Nothing is parsed or converted: once the header and section bounds
+// are validated, the vertex and index sections are handed to the uploader as they are, and the vertex input
+// state that reads the quantized attributes is generated from the header.
+class MeshFile
+{
+public:
+	// Throws when the file is missing, truncated or not a mesh file of this version
+	void open(const std::string& filename);
+
+	const MeshFileHeader& header() const { return *reinterpret_cast<const MeshFileHeader*>(file.data()); }
+
+	const void* vertexData() const { return file.data() + header().vertexOffset; }
+	vk::DeviceSize vertexBytes() const { return vk::DeviceSize(header().vertexCount) * header().vertexStride; }
+	const void* indexData() const { return file.data() + header().indexOffset; }
+	vk::DeviceSize indexBytes() const { return vk::DeviceSize(header().indexCount) * header().indexSize; }
+	vk::IndexType indexType() const { return header().indexSize == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32; }
+
+	uint32_t meshCount() const { return header().meshCount; }
+	const MeshEntry& mesh(uint32_t index) const { return reinterpret_cast<const MeshEntry*>(file.data() + header().meshOffset)[index]; }
+	uint32_t meshletCount() const { return header().meshletCount; }
+	const MeshletEntry& meshlet(uint32_t index) const { return reinterpret_cast<const MeshletEntry*>(file.data() + header().meshletOffset)[index]; }
+
+	vk::VertexInputBindingDescription bindingDescription(uint32_t binding) const;
+	std::vector<vk::VertexInputAttributeDescription> attributeDescriptions(uint32_t binding) const;
+	// Maps quantized positions back into the space the mesh was authored in
+	glm::mat4 dequantization() const;
+
+	void printStats() const;
+
+private:
+	std::string name;
+	MappedFile file;
+};
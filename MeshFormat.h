@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+
+// Layout of cooked mesh files (.vkm), written by vktry_meshcook and mapped by MeshFile as is.
+// Little endian; every section starts on a 16 byte boundary and is addressed by its offset from the start
+// of the file. Indices are relative to their mesh's first vertex, so most files get away with 16 bits.
+
+const uint32_t MESH_FILE_MAGIC = 0x4D544B56; // "VKTM"
+const uint32_t MESH_FILE_VERSION = 1;
+const uint32_t MESH_MAX_ATTRIBUTES = 8;
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// The values are the shader input locations the attributes feed
+enum class MeshSemantic : uint32_t
+{
+	Position = 0,
+	Color = 1,
+	Normal = 4,
+	TexCoord = 5
+};
+
+enum class MeshAttributeFormat : uint32_t
+{
+	// Positions in [-1, 1] over the file's bounds, see positionScale and positionOffset
+	Snorm16x4,
+	// Octahedral-encoded unit vectors
+	Snorm16x2,
+	Half2,
+	Unorm8x4
+};
+
+struct MeshAttribute
+{
+	MeshSemantic semantic;
+	MeshAttributeFormat format;
+	uint32_t offset;
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t indexCount;
+	// 2 or 4 bytes
+	uint32_t indexSize;
+	uint32_t meshCount;
+	uint32_t meshletCount;
+	uint32_t meshletVertexCount;
+	uint32_t meshletTriangleCount;
+	uint32_t attributeCount;
+	uint32_t padding;
+	// position = quantized * positionScale + positionOffset
+	float positionScale[3];
+	float positionOffset[3];
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t meshOffset;
+	uint64_t meshletOffset;
+	uint64_t meshletVertexOffset;
+	uint64_t meshletTriangleOffset;
+	MeshAttribute attributes[MESH_MAX_ATTRIBUTES];
+};
+
+struct MeshEntry
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+	uint32_t vertexCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	uint32_t padding[2];
+	// Bounding sphere in unquantized mesh space
+	float center[3];
+	float radius;
+};
+
+// Up to MESHLET_MAX_VERTICES vertices, as indices into the mesh's vertices stored in the meshlet vertex
+// section, and up to MESHLET_MAX_TRIANGLES triangles as byte triples into those in the triangle section
+struct MeshletEntry
+{
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	float center[3];
+	float radius;
+};
+
+static_assert(sizeof(MeshFileHeader) == 216, "MeshFileHeader is part of the file format");
+static_assert(sizeof(MeshEntry) == 48, "MeshEntry is part of the file format");
+static_assert(sizeof(MeshletEntry) == 32, "MeshletEntry is part of the file format");
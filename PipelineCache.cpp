@@ -0,0 +1,136 @@
+#include "PipelineCache.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+
+const char PIPELINE_CACHE_MAGIC[4] = { 'V', 'K', 'P', 'C' };
+const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+void PipelineCache::load(vk::Device device, const vk::PhysicalDeviceProperties& properties, const std::string& filename)
+{
+	this->device = device;
+	this->properties = properties;
+	this->filename = filename;
+
+	std::vector<char> data;
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (file.is_open())
+	{
+		// The header's size is only trusted once it matches the file, a corrupt one must not drive the allocation
+		uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+		file.seekg(0);
+		FileHeader header;
+		if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.dataSize == fileSize - sizeof(header))
+		{
+			data.resize(static_cast<size_t>(header.dataSize));
+			if (!file.read(data.data(), data.size()) || !validate(header, data))
+				data.clear();
+			else
+				coldCompileMs = header.coldCompileMs;
+		}
+		if (data.empty())
+			std::cout << "[PipelineCache] Discarding stale or corrupt cache: " << filename << "\n";
+	}
+
+	auto createInfo = vk::PipelineCacheCreateInfo()
+		.setInitialDataSize(data.size())
+		.setPInitialData(data.empty() ? nullptr : data.data());
+	try
+	{
+		cache = device.createPipelineCache(createInfo);
+		warm = !data.empty();
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "[PipelineCache] Driver rejected cache data, starting empty: " << e.what() << "\n";
+		cache = device.createPipelineCache(vk::PipelineCacheCreateInfo());
+		warm = false;
+	}
+}
+
+void PipelineCache::save()
+{
+	if (!cache || filename.empty())
+		return;
+
+	auto data = device.getPipelineCacheData(cache);
+
+	// Value-initialized so the padding goes to disk as zeros
+	FileHeader header{};
+	std::memcpy(header.magic, PIPELINE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	header.driverVersion = properties.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.checksum = fnv1a64(data.data(), data.size());
+	header.coldCompileMs = warm ? coldCompileMs : compileMs;
+
+	// Write to a temporary file first so an interrupted write never leaves a truncated cache behind
+	std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "[PipelineCache] Unable to write file: " << tempFilename << "\n";
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	}
+	// POSIX rename replaces the old cache atomically; where it refuses to overwrite, the old one is removed and the rename retried
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(filename.c_str());
+		if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+			std::cout << "[PipelineCache] Unable to replace file: " << filename << "\n";
+	}
+}
+
+void PipelineCache::destroy(DeletionQueue& deletions)
+{
+	deletions.destroy(cache);
+	cache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::printReport() const
+{
+	std::cout << "[PipelineCache] " << (warm ? "warm" : "cold") << " start, pipeline compile time: " << compileMs << " ms\n";
+	if (warm && coldCompileMs > 0.0)
+		std::cout << "\t--cold compile time: " << coldCompileMs << " ms, saved: " << coldCompileMs - compileMs << " ms\n";
+}
+
+bool PipelineCache::validate(const FileHeader& header, const std::vector<char>& data) const
+{
+	if (std::memcmp(header.magic, PIPELINE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != PIPELINE_CACHE_VERSION ||
+		header.vendorID != properties.vendorID ||
+		header.deviceID != properties.deviceID ||
+		header.driverVersion != properties.driverVersion ||
+		std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+		header.checksum != fnv1a64(data.data(), data.size()))
+		return false;
+
+	// The driver's own header has to agree as well, some drivers do not check it themselves
+	struct
+	{
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	} driverHeader;
+
+	if (data.size() < sizeof(driverHeader))
+		return false;
+	std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+
+	return driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		driverHeader.vendorID == properties.vendorID &&
+		driverHeader.deviceID == properties.deviceID &&
+		std::memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DeletionQueue.h"
+
+#include <string>
+#include <vector>
+
+// vk::PipelineCache persisted to disk. The file is only accepted when it was written by the same
+// vendor, device, driver version and pipelineCacheUUID; anything else is dropped and rebuilt.
+class PipelineCache
+{
+public:
+	void load(vk::Device device, const vk::PhysicalDeviceProperties& properties, const std::string& filename);
+	void save();
+	void destroy(DeletionQueue& deletions);
+
+	vk::PipelineCache handle() const { return cache; }
+	bool isWarm() const { return warm; }
+
+	void addCompileTime(double milliseconds) { compileMs += milliseconds; }
+	void printReport() const;
+
+private:
+	struct FileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t checksum;
+		// Pipeline compile time measured on the last launch that started without a cache
+		double coldCompileMs;
+	};
+
+	bool validate(const FileHeader& header, const std::vector<char>& data) const;
+
+private:
+	vk::Device device;
+	vk::PhysicalDeviceProperties properties;
+	std::string filename;
+	vk::PipelineCache cache;
+
+	bool warm = false;
+	double compileMs = 0.0;
+	double coldCompileMs = 0.0;
+};
@@ -0,0 +1,279 @@
+#include "PipelineRegistry.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+template <typename Handle>
+static uint64_t handleBits(Handle handle)
+{
+	auto raw = static_cast<typename Handle::CType>(handle);
+	uint64_t bits = 0;
+	std::memcpy(&bits, &raw, sizeof(raw));
+	return bits;
+}
+
+uint64_t GraphicsPipelineDesc::hash() const
+{
+	uint64_t seed = fnv1a64(vertexShader);
+	hashCombine(seed, fnv1a64(fragmentShader));
+	for (const auto& binding : bindings)
+	{
+		hashCombine(seed, binding.binding);
+		hashCombine(seed, binding.stride);
+		hashCombine(seed, static_cast<uint64_t>(binding.inputRate));
+	}
+	for (const auto& attribute : attributes)
+	{
+		hashCombine(seed, attribute.location);
+		hashCombine(seed, attribute.binding);
+		hashCombine(seed, static_cast<uint64_t>(attribute.format));
+		hashCombine(seed, attribute.offset);
+	}
+	hashCombine(seed, static_cast<uint64_t>(topology));
+	hashCombine(seed, static_cast<uint64_t>(polygonMode));
+	hashCombine(seed, static_cast<uint64_t>(static_cast<VkCullModeFlags>(cullMode)));
+	hashCombine(seed, static_cast<uint64_t>(frontFace));
+	hashCombine(seed, blendEnable);
+	hashCombine(seed, static_cast<uint64_t>(srcColorBlendFactor));
+	hashCombine(seed, static_cast<uint64_t>(dstColorBlendFactor));
+	hashCombine(seed, static_cast<uint64_t>(colorBlendOp));
+	hashCombine(seed, static_cast<uint64_t>(srcAlphaBlendFactor));
+	hashCombine(seed, static_cast<uint64_t>(dstAlphaBlendFactor));
+	hashCombine(seed, static_cast<uint64_t>(alphaBlendOp));
+	hashCombine(seed, static_cast<uint64_t>(static_cast<VkColorComponentFlags>(colorWriteMask)));
+	hashCombine(seed, handleBits(layout));
+	hashCombine(seed, handleBits(renderPass));
+	hashCombine(seed, subpass);
+	return seed;
+}
+
+bool GraphicsPipelineDesc::operator==(const GraphicsPipelineDesc& other) const
+{
+	return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader &&
+		bindings == other.bindings && attributes == other.attributes &&
+		topology == other.topology && polygonMode == other.polygonMode &&
+		cullMode == other.cullMode && frontFace == other.frontFace &&
+		blendEnable == other.blendEnable &&
+		srcColorBlendFactor == other.srcColorBlendFactor && dstColorBlendFactor == other.dstColorBlendFactor &&
+		colorBlendOp == other.colorBlendOp &&
+		srcAlphaBlendFactor == other.srcAlphaBlendFactor && dstAlphaBlendFactor == other.dstAlphaBlendFactor &&
+		alphaBlendOp == other.alphaBlendOp && colorWriteMask == other.colorWriteMask &&
+		layout == other.layout && renderPass == other.renderPass && subpass == other.subpass;
+}
+
+void PipelineRegistry::init(vk::Device device, ShaderLibrary& shaders, vk::PipelineCache pipelineCache, uint32_t threadCount)
+{
+	this->device = device;
+	this->shaders = &shaders;
+	this->pipelineCache = pipelineCache;
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+	compilePool = std::make_unique<ThreadPool>(threadCount);
+}
+
+void PipelineRegistry::destroy(DeletionQueue& deletions)
+{
+	// The pool drains its queue before the workers exit
+	compilePool.reset();
+
+	for (auto& variant : variants)
+		deletions.destroy(variant.pipeline);
+	variants.clear();
+	lookup.clear();
+	pending = 0;
+}
+
+PipelineHandle PipelineRegistry::request(const GraphicsPipelineDesc& desc, PipelineHandle fallback)
+{
+	// Resolved before the variant is published, a missing shader throws without leaving it Pending forever
+	vk::ShaderModule vertexModule = shaders->get(desc.vertexShader);
+	vk::ShaderModule fragmentModule = shaders->get(desc.fragmentShader);
+
+	uint64_t hash = desc.hash();
+	PipelineHandle handle = INVALID_PIPELINE;
+	Variant* variant = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests++;
+
+		// Equal hashes are compared in full so a collision can never alias two pipelines
+		auto range = lookup.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (variants[it->second].desc == desc)
+				return it->second;
+		}
+
+		handle = static_cast<PipelineHandle>(variants.size());
+		variants.emplace_back();
+		variant = &variants.back();
+		variant->desc = desc;
+		variant->fallback = fallback;
+		variant->vertexModule = vertexModule;
+		variant->fragmentModule = fragmentModule;
+		lookup.emplace(hash, handle);
+		pending++;
+	}
+
+	compilePool->enqueue([this, variant]() { compile(*variant); });
+	return handle;
+}
+
+vk::Pipeline PipelineRegistry::get(PipelineHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (handle >= variants.size())
+		return VK_NULL_HANDLE;
+
+	const auto& variant = variants[handle];
+	if (variant.state == State::Ready)
+		return variant.pipeline;
+	if (variant.fallback < variants.size() && variants[variant.fallback].state == State::Ready)
+		return variants[variant.fallback].pipeline;
+	return VK_NULL_HANDLE;
+}
+
+bool PipelineRegistry::isReady(PipelineHandle handle) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return handle < variants.size() && variants[handle].state != State::Pending;
+}
+
+void PipelineRegistry::wait(PipelineHandle handle)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	compiled.wait(lock, [&]() { return handle >= variants.size() || variants[handle].state != State::Pending; });
+}
+
+void PipelineRegistry::waitAll()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	compiled.wait(lock, [&]() { return pending == 0; });
+}
+
+size_t PipelineRegistry::variantCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return variants.size();
+}
+
+size_t PipelineRegistry::pendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending;
+}
+
+double PipelineRegistry::compileMs() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return totalCompileMs;
+}
+
+void PipelineRegistry::compile(Variant& variant)
+{
+	// Only the compile thread touches the description and modules until the state leaves Pending
+	const auto& desc = variant.desc;
+
+	vk::PipelineShaderStageCreateInfo shaderStages[] =
+	{
+		vk::PipelineShaderStageCreateInfo()
+			.setStage(vk::ShaderStageFlagBits::eVertex)
+			.setModule(variant.vertexModule)
+			.setPName("main"),
+		vk::PipelineShaderStageCreateInfo()
+			.setStage(vk::ShaderStageFlagBits::eFragment)
+			.setModule(variant.fragmentModule)
+			.setPName("main")
+	};
+
+	auto vertexInputInfo = vk::PipelineVertexInputStateCreateInfo()
+		.setVertexBindingDescriptionCount(static_cast<uint32_t>(desc.bindings.size()))
+		.setPVertexBindingDescriptions(desc.bindings.data())
+		.setVertexAttributeDescriptionCount(static_cast<uint32_t>(desc.attributes.size()))
+		.setPVertexAttributeDescriptions(desc.attributes.data());
+
+	auto inputAssemblyState = vk::PipelineInputAssemblyStateCreateInfo()
+		.setTopology(desc.topology)
+		.setPrimitiveRestartEnable(VK_FALSE);
+
+	// Viewport and scissor are dynamic so a resize does not invalidate the pipeline
+	auto viewportState = vk::PipelineViewportStateCreateInfo()
+		.setViewportCount(1)
+		.setScissorCount(1);
+
+	auto rasterizationState = vk::PipelineRasterizationStateCreateInfo()
+		.setDepthClampEnable(VK_FALSE)
+		.setPolygonMode(desc.polygonMode)
+		.setLineWidth(1.0f)
+		.setCullMode(desc.cullMode)
+		.setFrontFace(desc.frontFace)
+		.setDepthBiasEnable(VK_FALSE);
+
+	auto multisampleState = vk::PipelineMultisampleStateCreateInfo()
+		.setSampleShadingEnable(VK_FALSE)
+		.setRasterizationSamples(vk::SampleCountFlagBits::e1)
+		.setMinSampleShading(1.0f);
+
+	auto colorBlendAttachmentState = vk::PipelineColorBlendAttachmentState()
+		.setColorWriteMask(desc.colorWriteMask)
+		.setBlendEnable(desc.blendEnable)
+		.setSrcColorBlendFactor(desc.srcColorBlendFactor)
+		.setDstColorBlendFactor(desc.dstColorBlendFactor)
+		.setColorBlendOp(desc.colorBlendOp)
+		.setSrcAlphaBlendFactor(desc.srcAlphaBlendFactor)
+		.setDstAlphaBlendFactor(desc.dstAlphaBlendFactor)
+		.setAlphaBlendOp(desc.alphaBlendOp);
+
+	auto colorBlendState = vk::PipelineColorBlendStateCreateInfo()
+		.setLogicOpEnable(VK_FALSE)
+		.setAttachmentCount(1)
+		.setPAttachments(&colorBlendAttachmentState);
+
+	vk::DynamicState dynamicStates[] = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+	auto dynamicState = vk::PipelineDynamicStateCreateInfo()
+		.setDynamicStateCount(2)
+		.setPDynamicStates(dynamicStates);
+
+	auto pipelineInfo = vk::GraphicsPipelineCreateInfo()
+		.setStageCount(2)
+		.setPStages(shaderStages)
+		.setPVertexInputState(&vertexInputInfo)
+		.setPInputAssemblyState(&inputAssemblyState)
+		.setPViewportState(&viewportState)
+		.setPRasterizationState(&rasterizationState)
+		.setPMultisampleState(&multisampleState)
+		.setPColorBlendState(&colorBlendState)
+		.setPDynamicState(&dynamicState)
+		.setLayout(desc.layout)
+		.setRenderPass(desc.renderPass)
+		.setSubpass(desc.subpass);
+
+	// The pipeline cache is internally synchronized, every compile thread shares it
+	auto compileStart = std::chrono::steady_clock::now();
+	vk::Pipeline pipeline;
+	State state = State::Ready;
+	try
+	{
+		pipeline = device.createGraphicsPipeline(pipelineCache, pipelineInfo).value;
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "[Error] Pipeline compile failed (" << desc.vertexShader << ", " << desc.fragmentShader << "): " << e.what() << "\n";
+		state = State::Failed;
+	}
+	double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		variant.pipeline = pipeline;
+		variant.state = state;
+		totalCompileMs += compileMs;
+		pending--;
+	}
+	compiled.notify_all();
+}
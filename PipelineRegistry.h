@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DeletionQueue.h"
+#include "ShaderLibrary.h"
+#include "ThreadPool.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Everything that distinguishes one graphics pipeline from another. Viewport and scissor are always dynamic.
+struct GraphicsPipelineDesc
+{
+	std::string vertexShader;
+	std::string fragmentShader;
+	std::vector<vk::VertexInputBindingDescription> bindings;
+	std::vector<vk::VertexInputAttributeDescription> attributes;
+	vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+	vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+	vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+	vk::FrontFace frontFace = vk::FrontFace::eClockwise;
+	bool blendEnable = false;
+	vk::BlendFactor srcColorBlendFactor = vk::BlendFactor::eOne;
+	vk::BlendFactor dstColorBlendFactor = vk::BlendFactor::eZero;
+	vk::BlendOp colorBlendOp = vk::BlendOp::eAdd;
+	vk::BlendFactor srcAlphaBlendFactor = vk::BlendFactor::eOne;
+	vk::BlendFactor dstAlphaBlendFactor = vk::BlendFactor::eZero;
+	vk::BlendOp alphaBlendOp = vk::BlendOp::eAdd;
+	vk::ColorComponentFlags colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+		vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+	vk::PipelineLayout layout;
+	vk::RenderPass renderPass;
+	uint32_t subpass = 0;
+
+	uint64_t hash() const;
+	bool operator==(const GraphicsPipelineDesc& other) const;
+};
+
+using PipelineHandle = uint32_t;
+const PipelineHandle INVALID_PIPELINE = UINT32_MAX;
+
+// Deduplicates pipeline descriptions and compiles each distinct one on a background thread pool against a
+// shared vk::PipelineCache. Requests return immediately; until a variant is ready, get() hands out its
+// fallback, or nothing, so frames can start while compilation is still running.
+class PipelineRegistry
+{
+public:
+	// threadCount of 0 leaves one hardware thread to the rest of the application
+	void init(vk::Device device, ShaderLibrary& shaders, vk::PipelineCache pipelineCache, uint32_t threadCount = 0);
+	// Waits for compiles still in flight before retiring every pipeline
+	void destroy(DeletionQueue& deletions);
+
+	// Must be called from the thread that owns the ShaderLibrary
+	PipelineHandle request(const GraphicsPipelineDesc& desc, PipelineHandle fallback = INVALID_PIPELINE);
+
+	// The variant if it is ready, otherwise its fallback if that is ready, otherwise null. Safe from any thread.
+	vk::Pipeline get(PipelineHandle handle) const;
+	bool isReady(PipelineHandle handle) const;
+	void wait(PipelineHandle handle);
+	void waitAll();
+
+	size_t variantCount() const;
+	size_t pendingCount() const;
+	size_t requestCount() const { return requests; }
+	// Summed over all compile threads
+	double compileMs() const;
+
+private:
+	enum class State
+	{
+		Pending,
+		Ready,
+		Failed
+	};
+
+	struct Variant
+	{
+		GraphicsPipelineDesc desc;
+		vk::ShaderModule vertexModule;
+		vk::ShaderModule fragmentModule;
+		PipelineHandle fallback = INVALID_PIPELINE;
+		State state = State::Pending;
+		vk::Pipeline pipeline;
+	};
+
+	void compile(Variant& variant);
+
+private:
+	vk::Device device;
+	ShaderLibrary* shaders = nullptr;
+	vk::PipelineCache pipelineCache;
+	std::unique_ptr<ThreadPool> compilePool;
+
+	mutable std::mutex mutex;
+	std::condition_variable compiled;
+	// A deque keeps variants in place while new ones are appended
+	std::deque<Variant> variants;
+	std::unordered_multimap<uint64_t, PipelineHandle> lookup;
+	size_t pending = 0;
+	size_t requests = 0;
+	double totalCompileMs = 0.0;
+};
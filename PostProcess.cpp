@@ -0,0 +1,420 @@
+#include "PostProcess.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+// Pass names of the first target's stages, later targets append their suffix
+static const char* const STAGE_NAMES[] = { "histogram", "bloom downsample", "bloom upsample", "tonemap", "output" };
+
+// Histogram bins followed by the adapted luminance and the exposure derived from it
+const vk::DeviceSize LUMINANCE_BUFFER_SIZE = 256 * sizeof(uint32_t) + 2 * sizeof(float);
+
+static uint32_t groupCount(uint32_t size, uint32_t groupSize)
+{
+	return (size + groupSize - 1) / groupSize;
+}
+
+// Blits copy values into these unchanged, sRGB formats encode on the way in
+static bool isUnormColor(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR8G8B8A8Unorm:
+	case vk::Format::eB8G8R8A8Unorm:
+	case vk::Format::eA8B8G8R8UnormPack32:
+	case vk::Format::eA2B10G10R10UnormPack32:
+	case vk::Format::eA2R10G10B10UnormPack32:
+	case vk::Format::eR16G16B16A16Unorm:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void PostProcess::init(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t apiVersion, MemoryAllocator& allocator,
+	ShaderLibrary& shaders, vk::PipelineCache pipelineCache, vk::Format outputFormat, uint32_t framesInFlight, const Settings& settings)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	this->settings = settings;
+	this->settings.bloomLevels = std::max(1u, settings.bloomLevels);
+
+	// Subgroup properties, vkGetPhysicalDeviceProperties2 and the SPIR-V 1.3 the subgroup shader needs are all 1.1
+	subgroupReduction = false;
+	if (apiVersion >= VK_API_VERSION_1_1)
+	{
+		auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+		const auto& subgroup = properties.get<vk::PhysicalDeviceSubgroupProperties>();
+		auto reduction = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eArithmetic;
+		subgroupReduction = (subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) &&
+			(subgroup.supportedOperations & reduction) == reduction;
+	}
+	// Shared memory is ordinary memory on CPU implementations, there the tile only adds a barrier to the sampler path
+	tiledDownsample = this->settings.tiledDownsample && physicalDevice.getProperties().deviceType != vk::PhysicalDeviceType::eCpu;
+	encodeSrgb = isUnormColor(outputFormat);
+
+	sampler = device.createSampler(vk::SamplerCreateInfo()
+		.setMagFilter(vk::Filter::eLinear)
+		.setMinFilter(vk::Filter::eLinear)
+		.setMipmapMode(vk::SamplerMipmapMode::eNearest)
+		.setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+		.setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+		.setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+		.setMaxLod(0.0f));
+
+	auto binding = [](uint32_t binding, vk::DescriptorType type)
+	{
+		return vk::DescriptorSetLayoutBinding()
+			.setBinding(binding)
+			.setDescriptorType(type)
+			.setDescriptorCount(1)
+			.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	};
+	vk::DescriptorSetLayoutBinding bindings[] =
+	{
+		binding(0, vk::DescriptorType::eCombinedImageSampler),
+		binding(1, vk::DescriptorType::eStorageImage),
+		binding(2, vk::DescriptorType::eStorageBuffer),
+		binding(3, vk::DescriptorType::eCombinedImageSampler)
+	};
+
+	auto setLayoutInfo = vk::DescriptorSetLayoutCreateInfo()
+		.setBindingCount(4)
+		.setPBindings(bindings);
+
+	setLayout = device.createDescriptorSetLayout(setLayoutInfo);
+	descriptors.init(device, framesInFlight, { vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 2),
+		vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 1), vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 1) });
+
+	auto pushConstantRange = vk::PushConstantRange()
+		.setStageFlags(vk::ShaderStageFlagBits::eCompute)
+		.setOffset(0)
+		.setSize(sizeof(PushConstants));
+
+	auto pipelineLayoutInfo = vk::PipelineLayoutCreateInfo()
+		.setSetLayoutCount(1)
+		.setPSetLayouts(&setLayout)
+		.setPushConstantRangeCount(1)
+		.setPPushConstantRanges(&pushConstantRange);
+
+	pipelineLayout = device.createPipelineLayout(pipelineLayoutInfo);
+
+	auto createComputePipeline = [&](const std::string& shader, const vk::SpecializationInfo* specialization)
+	{
+		auto stageInfo = vk::PipelineShaderStageCreateInfo()
+			.setStage(vk::ShaderStageFlagBits::eCompute)
+			.setModule(shaders.get(shader))
+			.setPName("main")
+			.setPSpecializationInfo(specialization);
+
+		auto pipelineInfo = vk::ComputePipelineCreateInfo()
+			.setStage(stageInfo)
+			.setLayout(pipelineLayout);
+
+		return device.createComputePipeline(pipelineCache, pipelineInfo).value;
+	};
+
+	// The subgroup and tiled variants are separate modules, so the fallbacks declare neither the capability nor the shared memory
+	VkBool32 encode = encodeSrgb;
+	auto encodeEntry = vk::SpecializationMapEntry(0, 0, sizeof(VkBool32));
+	auto encodeInfo = vk::SpecializationInfo(1, &encodeEntry, sizeof(VkBool32), &encode);
+
+	histogramPipeline = createComputePipeline("histogram_cs.spv", nullptr);
+	exposurePipeline = createComputePipeline(subgroupReduction ? "exposure_subgroup_cs.spv" : "exposure_cs.spv", nullptr);
+	downsamplePipeline = createComputePipeline(tiledDownsample ? "bloom_downsample_tiled_cs.spv" : "bloom_downsample_cs.spv", nullptr);
+	upsamplePipeline = createComputePipeline("bloom_upsample_cs.spv", nullptr);
+	tonemapPipeline = createComputePipeline("tonemap_cs.spv", &encodeInfo);
+}
+
+void PostProcess::destroy(DeletionQueue& deletions)
+{
+	if (!device)
+		return;
+
+	for (auto& target : targets)
+	{
+		deletions.destroy(target.buffer);
+		deletions.free(target.allocation);
+	}
+	targets.clear();
+
+	descriptors.destroy(deletions);
+	deletions.destroy(histogramPipeline);
+	deletions.destroy(exposurePipeline);
+	deletions.destroy(downsamplePipeline);
+	deletions.destroy(upsamplePipeline);
+	deletions.destroy(tonemapPipeline);
+	deletions.destroy(pipelineLayout);
+	deletions.destroy(setLayout);
+	deletions.destroy(sampler);
+}
+
+uint32_t PostProcess::addTarget(RenderGraph& graph, RenderResource hdr, RenderResource output, const std::string& suffix)
+{
+	this->graph = &graph;
+	uint32_t index = static_cast<uint32_t>(targets.size());
+
+	Target target;
+	target.hdr = hdr;
+	target.output = output;
+
+	// Each level is sampled by the dispatch producing the next, within a pass the graph only sees storage access
+	for (uint32_t level = 0; level < settings.bloomLevels; level++)
+	{
+		TransientImageDesc desc;
+		desc.format = HDR_FORMAT;
+		desc.scale = 1.0f / static_cast<float>(2u << level);
+		desc.usage = vk::ImageUsageFlagBits::eSampled;
+		target.bloom.push_back(graph.createImage("bloom " + std::to_string(level + 1) + suffix, desc));
+	}
+	TransientImageDesc ldrDesc;
+	ldrDesc.format = HDR_FORMAT;
+	target.ldr = graph.createImage("tonemapped" + suffix, ldrDesc);
+	target.luminance = graph.importBuffer("luminance" + suffix, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite);
+
+	auto bufferInfo = vk::BufferCreateInfo()
+		.setSize(LUMINANCE_BUFFER_SIZE)
+		.setUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst)
+		.setSharingMode(vk::SharingMode::eExclusive);
+
+	target.buffer = device.createBuffer(bufferInfo);
+	target.allocation = allocator->allocateBuffer(target.buffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	auto histogram = graph.addPass(STAGE_NAMES[0] + suffix, PassType::Compute, [this, index](vk::CommandBuffer commandBuffer)
+	{
+		recordHistogram(commandBuffer, targets[index]);
+	});
+	graph.read(histogram, hdr, ResourceAccess::Sampled);
+	graph.write(histogram, target.luminance, ResourceAccess::StorageWrite);
+
+	auto downsample = graph.addPass(STAGE_NAMES[1] + suffix, PassType::Compute, [this, index](vk::CommandBuffer commandBuffer)
+	{
+		recordDownsample(commandBuffer, targets[index]);
+	});
+	graph.read(downsample, hdr, ResourceAccess::Sampled);
+	for (auto level : target.bloom)
+		graph.write(downsample, level, ResourceAccess::StorageWrite, true);
+
+	// Accumulates into every level but the smallest, in place
+	auto upsample = graph.addPass(STAGE_NAMES[2] + suffix, PassType::Compute, [this, index](vk::CommandBuffer commandBuffer)
+	{
+		recordUpsample(commandBuffer, targets[index]);
+	});
+	for (size_t level = 0; level + 1 < target.bloom.size(); level++)
+		graph.write(upsample, target.bloom[level], ResourceAccess::StorageWrite);
+	graph.read(upsample, target.bloom.back(), ResourceAccess::StorageRead);
+
+	auto tonemap = graph.addPass(STAGE_NAMES[3] + suffix, PassType::Compute, [this, index](vk::CommandBuffer commandBuffer)
+	{
+		recordTonemap(commandBuffer, targets[index]);
+	});
+	graph.read(tonemap, hdr, ResourceAccess::Sampled);
+	graph.read(tonemap, target.bloom[0], ResourceAccess::Sampled);
+	graph.read(tonemap, target.luminance, ResourceAccess::StorageRead);
+	graph.write(tonemap, target.ldr, ResourceAccess::StorageWrite, true);
+
+	// Few targets can be written from compute, sRGB swapchains never; the blit also encodes to the output format
+	auto copy = graph.addPass(STAGE_NAMES[4] + suffix, PassType::Transfer, [this, index](vk::CommandBuffer commandBuffer)
+	{
+		recordOutput(commandBuffer, targets[index]);
+	});
+	graph.read(copy, target.ldr, ResourceAccess::TransferSrc);
+	graph.write(copy, output, ResourceAccess::TransferDst, true);
+
+	target.passes = { histogram, downsample, upsample, tonemap, copy };
+	targets.push_back(std::move(target));
+	return index;
+}
+
+void PostProcess::beginFrame(uint32_t frameSlot, double seconds)
+{
+	descriptors.beginFrame(frameSlot);
+	deltaSeconds = lastSeconds < 0.0 ? 0.0f : static_cast<float>(std::max(0.0, seconds - lastSeconds));
+	lastSeconds = seconds;
+}
+
+void PostProcess::printStats(const FrameProfiler& profiler) const
+{
+	std::cout << "[PostProcess] " << settings.bloomLevels << " bloom levels, "
+		<< (subgroupReduction ? "subgroup" : "shared-memory") << " exposure reduction, "
+		<< (tiledDownsample ? "tiled" : "scalar") << " downsample" << (encodeSrgb ? ", sRGB encoded in the tonemap" : "") << "\n";
+	if (!profiler.hasGpuTimings())
+		return;
+	for (auto stage : STAGE_NAMES)
+		std::cout << "\t--" << stage << ": " << profiler.averageGpuMs(stage) << " ms\n";
+}
+
+void PostProcess::recordHistogram(vk::CommandBuffer commandBuffer, Target& target)
+{
+	// Zero bins and luminance the first time, after that the exposure dispatch leaves the bins cleared
+	if (!target.cleared)
+	{
+		commandBuffer.fillBuffer(target.buffer, 0, VK_WHOLE_SIZE, 0);
+		auto clearBarrier = vk::MemoryBarrier()
+			.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+			vk::DependencyFlags(), clearBarrier, nullptr, nullptr);
+		target.cleared = true;
+	}
+
+	auto region = clampedRegion(target);
+	Bindings bindings;
+	bindings.source = graph->imageView(target.hdr);
+	bindings.luminance = target.buffer;
+	auto set = writeSet(bindings);
+
+	PushConstants constants = { { int32_t(region.width), int32_t(region.height) }, { int32_t(region.width), int32_t(region.height) }, 0.0f };
+	dispatch(commandBuffer, histogramPipeline, set, constants, groupCount(region.width, 16), groupCount(region.height, 8));
+	computeBarrier(commandBuffer);
+
+	constants.parameter = deltaSeconds;
+	dispatch(commandBuffer, exposurePipeline, set, constants, 1, 1);
+}
+
+void PostProcess::recordDownsample(vk::CommandBuffer commandBuffer, const Target& target)
+{
+	Bindings bindings;
+	bindings.source = graph->imageView(target.hdr);
+	auto sourceRegion = clampedRegion(target);
+
+	for (uint32_t level = 0; level < target.bloom.size(); level++)
+	{
+		auto region = bloomRegion(target, level);
+		bindings.destination = graph->imageView(target.bloom[level]);
+		auto set = writeSet(bindings);
+
+		PushConstants constants = { { int32_t(region.width), int32_t(region.height) },
+			{ int32_t(sourceRegion.width), int32_t(sourceRegion.height) }, level == 0 ? settings.bloomThreshold : -1.0f };
+		if (level > 0)
+			computeBarrier(commandBuffer);
+		dispatch(commandBuffer, downsamplePipeline, set, constants, groupCount(region.width, 8), groupCount(region.height, 8));
+
+		// The graph left every level in the general layout for storage access
+		bindings.source = bindings.destination;
+		bindings.sourceLayout = vk::ImageLayout::eGeneral;
+		sourceRegion = region;
+	}
+}
+
+void PostProcess::recordUpsample(vk::CommandBuffer commandBuffer, const Target& target)
+{
+	Bindings bindings;
+	bindings.sourceLayout = vk::ImageLayout::eGeneral;
+
+	for (uint32_t level = static_cast<uint32_t>(target.bloom.size()) - 1; level-- > 0;)
+	{
+		auto region = bloomRegion(target, level);
+		auto sourceRegion = bloomRegion(target, level + 1);
+		bindings.source = graph->imageView(target.bloom[level + 1]);
+		bindings.destination = graph->imageView(target.bloom[level]);
+		auto set = writeSet(bindings);
+
+		PushConstants constants = { { int32_t(region.width), int32_t(region.height) },
+			{ int32_t(sourceRegion.width), int32_t(sourceRegion.height) }, 0.0f };
+		if (level + 2 < target.bloom.size())
+			computeBarrier(commandBuffer);
+		dispatch(commandBuffer, upsamplePipeline, set, constants, groupCount(region.width, 8), groupCount(region.height, 8));
+	}
+}
+
+void PostProcess::recordTonemap(vk::CommandBuffer commandBuffer, const Target& target)
+{
+	auto region = clampedRegion(target);
+	auto bloomSize = bloomRegion(target, 0);
+
+	Bindings bindings;
+	bindings.source = graph->imageView(target.hdr);
+	bindings.destination = graph->imageView(target.ldr);
+	bindings.luminance = target.buffer;
+	bindings.bloom = graph->imageView(target.bloom[0]);
+	auto set = writeSet(bindings);
+
+	PushConstants constants = { { int32_t(region.width), int32_t(region.height) },
+		{ int32_t(bloomSize.width), int32_t(bloomSize.height) }, settings.bloomIntensity };
+	dispatch(commandBuffer, tonemapPipeline, set, constants, groupCount(region.width, 8), groupCount(region.height, 8));
+}
+
+void PostProcess::recordOutput(vk::CommandBuffer commandBuffer, const Target& target)
+{
+	auto region = clampedRegion(target);
+	auto subresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+	std::array<vk::Offset3D, 2> offsets = { vk::Offset3D(0, 0, 0), vk::Offset3D(int32_t(region.width), int32_t(region.height), 1) };
+
+	auto blit = vk::ImageBlit()
+		.setSrcSubresource(subresource)
+		.setSrcOffsets(offsets)
+		.setDstSubresource(subresource)
+		.setDstOffsets(offsets);
+
+	commandBuffer.blitImage(graph->image(target.ldr), vk::ImageLayout::eTransferSrcOptimal,
+		graph->image(target.output), vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eNearest);
+}
+
+vk::DescriptorSet PostProcess::writeSet(const Bindings& bindings)
+{
+	auto set = descriptors.allocate(setLayout);
+
+	auto sourceInfo = vk::DescriptorImageInfo(sampler, bindings.source, bindings.sourceLayout);
+	auto destinationInfo = vk::DescriptorImageInfo(vk::Sampler(), bindings.destination, vk::ImageLayout::eGeneral);
+	auto luminanceInfo = vk::DescriptorBufferInfo(bindings.luminance, 0, VK_WHOLE_SIZE);
+	auto bloomInfo = vk::DescriptorImageInfo(sampler, bindings.bloom, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+	auto write = [&](uint32_t binding, vk::DescriptorType type)
+	{
+		return vk::WriteDescriptorSet()
+			.setDstSet(set)
+			.setDstBinding(binding)
+			.setDescriptorCount(1)
+			.setDescriptorType(type);
+	};
+
+	std::vector<vk::WriteDescriptorSet> writes;
+	if (bindings.source)
+		writes.push_back(write(0, vk::DescriptorType::eCombinedImageSampler).setPImageInfo(&sourceInfo));
+	if (bindings.destination)
+		writes.push_back(write(1, vk::DescriptorType::eStorageImage).setPImageInfo(&destinationInfo));
+	if (bindings.luminance)
+		writes.push_back(write(2, vk::DescriptorType::eStorageBuffer).setPBufferInfo(&luminanceInfo));
+	if (bindings.bloom)
+		writes.push_back(write(3, vk::DescriptorType::eCombinedImageSampler).setPImageInfo(&bloomInfo));
+	device.updateDescriptorSets(writes, nullptr);
+	return set;
+}
+
+void PostProcess::dispatch(vk::CommandBuffer commandBuffer, vk::Pipeline pipeline, vk::DescriptorSet set, const PushConstants& constants,
+	uint32_t groupsX, uint32_t groupsY)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, set, nullptr);
+	commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &constants);
+	commandBuffer.dispatch(groupsX, groupsY, 1);
+}
+
+void PostProcess::computeBarrier(vk::CommandBuffer commandBuffer)
+{
+	auto barrier = vk::MemoryBarrier()
+		.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+		.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+		vk::DependencyFlags(), barrier, nullptr, nullptr);
+}
+
+vk::Extent2D PostProcess::bloomRegion(const Target& target, uint32_t level) const
+{
+	auto region = clampedRegion(target);
+	for (uint32_t i = 0; i <= level; i++)
+		region = vk::Extent2D(std::max(1u, region.width / 2), std::max(1u, region.height / 2));
+	return region;
+}
+
+vk::Extent2D PostProcess::clampedRegion(const Target& target) const
+{
+	// Targets smaller than the largest one use the top left corner of the graph's images
+	auto extent = graph->extent();
+	if (!target.region.width || !target.region.height)
+		return extent;
+	return vk::Extent2D(std::min(target.region.width, extent.width), std::min(target.region.height, extent.height));
+}
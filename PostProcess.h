@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+#include "Descriptors.h"
+#include "FrameProfiler.h"
+#include "MemoryAllocator.h"
+#include "RenderGraph.h"
+#include "ShaderLibrary.h"
+
+// Compute post-processing of a scene rendered into an HDR image. A luminance histogram drives the exposure,
+// which adapts over time; bright areas are blurred down a chain of half-resolution bloom levels and back up,
+// and the tonemapped result is copied into the target. Every stage is a render graph pass, so the graph places
+// the storage image transitions between them and each stage gets a GPU span under its pass name.
+class PostProcess
+{
+public:
+	static constexpr vk::Format HDR_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+
+	struct Settings
+	{
+		uint32_t bloomLevels = 5;
+		// Brightness where bloom starts, and how much of it is added back
+		float bloomThreshold = 1.0f;
+		float bloomIntensity = 0.05f;
+		// Stage the downsample's source texels in shared memory; off reads every tap through the sampler
+		bool tiledDownsample = true;
+	};
+
+	// Picks the subgroup reduction when apiVersion (the lower of the instance and device versions) is at least 1.1 and
+	// the device supports it, and the tiled downsample unless it is disabled or the device is a CPU implementation.
+	// Every output has outputFormat, UNORM ones get sRGB encoded by the tonemap.
+	void init(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t apiVersion, MemoryAllocator& allocator,
+		ShaderLibrary& shaders, vk::PipelineCache pipelineCache, vk::Format outputFormat, uint32_t framesInFlight,
+		const Settings& settings = Settings());
+	void destroy(DeletionQueue& deletions);
+
+	// Adds the stages reading hdr, which the scene pass writes before them, and ending in a copy into output
+	// (transfer destination). Returns the target's index; its passes come back from passes().
+	uint32_t addTarget(RenderGraph& graph, RenderResource hdr, RenderResource output, const std::string& suffix);
+	const std::vector<uint32_t>& passes(uint32_t target) const { return targets[target].passes; }
+
+	// Once per frame after the frame slot has been waited on; seconds is simulation time, it paces the adaptation
+	void beginFrame(uint32_t frameSlot, double seconds);
+	// Part of the graph extent the target's scene covers this frame
+	void setRegion(uint32_t target, vk::Extent2D region) { targets[target].region = region; }
+
+	// Average GPU time of each stage of the first target
+	void printStats(const FrameProfiler& profiler) const;
+
+private:
+	struct PushConstants
+	{
+		int32_t size[2];
+		int32_t sourceSize[2];
+		float parameter;
+	};
+
+	// Views left null are not written; each stage only uses some of the bindings
+	struct Bindings
+	{
+		vk::ImageView source;
+		vk::ImageLayout sourceLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		vk::ImageView destination;
+		vk::Buffer luminance;
+		vk::ImageView bloom;
+	};
+
+	struct Target
+	{
+		RenderResource hdr = INVALID_RESOURCE;
+		RenderResource output = INVALID_RESOURCE;
+		RenderResource ldr = INVALID_RESOURCE;
+		RenderResource luminance = INVALID_RESOURCE;
+		std::vector<RenderResource> bloom;
+		std::vector<uint32_t> passes;
+
+		// Histogram bins and the adapted luminance, carried from frame to frame
+		vk::Buffer buffer;
+		MemoryAllocation allocation;
+		bool cleared = false;
+		vk::Extent2D region;
+	};
+
+	void recordHistogram(vk::CommandBuffer commandBuffer, Target& target);
+	void recordDownsample(vk::CommandBuffer commandBuffer, const Target& target);
+	void recordUpsample(vk::CommandBuffer commandBuffer, const Target& target);
+	void recordTonemap(vk::CommandBuffer commandBuffer, const Target& target);
+	void recordOutput(vk::CommandBuffer commandBuffer, const Target& target);
+
+	vk::DescriptorSet writeSet(const Bindings& bindings);
+	void dispatch(vk::CommandBuffer commandBuffer, vk::Pipeline pipeline, vk::DescriptorSet set, const PushConstants& constants,
+		uint32_t groupsX, uint32_t groupsY);
+	// Orders the dispatches within a stage, the graph only places barriers between stages
+	void computeBarrier(vk::CommandBuffer commandBuffer);
+	// Region of bloom level i for the target
+	vk::Extent2D bloomRegion(const Target& target, uint32_t level) const;
+	vk::Extent2D clampedRegion(const Target& target) const;
+
+private:
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	RenderGraph* graph = nullptr;
+	Settings settings;
+	bool subgroupReduction = false;
+	bool tiledDownsample = false;
+	bool encodeSrgb = false;
+	float deltaSeconds = 0.0f;
+	double lastSeconds = -1.0;
+
+	vk::Sampler sampler;
+	vk::DescriptorSetLayout setLayout;
+	vk::PipelineLayout pipelineLayout;
+	vk::Pipeline histogramPipeline;
+	vk::Pipeline exposurePipeline;
+	vk::Pipeline downsamplePipeline;
+	vk::Pipeline upsamplePipeline;
+	vk::Pipeline tonemapPipeline;
+	// Image views change whenever the graph is resized, so sets are written fresh every frame
+	FrameDescriptorAllocator descriptors;
+
+	std::vector<Target> targets;
+};
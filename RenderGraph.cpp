@@ -0,0 +1,763 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iostream>
+
+const vk::AccessFlags WRITE_ACCESS = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+	vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+
+static vk::ImageAspectFlags aspectOf(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eD16Unorm:
+	case vk::Format::eX8D24UnormPack32:
+	case vk::Format::eD32Sfloat:
+		return vk::ImageAspectFlagBits::eDepth;
+	case vk::Format::eD16UnormS8Uint:
+	case vk::Format::eD24UnormS8Uint:
+	case vk::Format::eD32SfloatS8Uint:
+		return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+	case vk::Format::eS8Uint:
+		return vk::ImageAspectFlagBits::eStencil;
+	default:
+		return vk::ImageAspectFlagBits::eColor;
+	}
+}
+
+static vk::ImageUsageFlags imageUsageOf(ResourceAccess access)
+{
+	switch (access)
+	{
+	case ResourceAccess::ColorAttachment:
+		return vk::ImageUsageFlagBits::eColorAttachment;
+	case ResourceAccess::DepthAttachment:
+	case ResourceAccess::DepthRead:
+		return vk::ImageUsageFlagBits::eDepthStencilAttachment;
+	case ResourceAccess::Sampled:
+		return vk::ImageUsageFlagBits::eSampled;
+	case ResourceAccess::StorageRead:
+	case ResourceAccess::StorageWrite:
+		return vk::ImageUsageFlagBits::eStorage;
+	case ResourceAccess::TransferSrc:
+		return vk::ImageUsageFlagBits::eTransferSrc;
+	case ResourceAccess::TransferDst:
+		return vk::ImageUsageFlagBits::eTransferDst;
+	default:
+		return vk::ImageUsageFlags();
+	}
+}
+
+static bool isAttachment(vk::ImageLayout layout)
+{
+	return layout == vk::ImageLayout::eColorAttachmentOptimal || layout == vk::ImageLayout::eDepthStencilAttachmentOptimal ||
+		layout == vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+}
+
+void RenderGraph::init(vk::Device device, MemoryAllocator& allocator, DeletionQueue& deletions)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	this->deletions = &deletions;
+}
+
+void RenderGraph::destroy()
+{
+	if (!device)
+		return;
+
+	// Released by the owner's final flush, after anything retired earlier
+	retire(true);
+	for (auto& pass : passes)
+		deletions->destroy(pass.renderPass);
+	passes.clear();
+	resources.clear();
+}
+
+RenderResource RenderGraph::createImage(const std::string& name, const TransientImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.format = desc.format;
+	resource.desc = desc;
+	resource.usage = desc.usage;
+	resources.push_back(resource);
+	return static_cast<RenderResource>(resources.size() - 1);
+}
+
+RenderResource RenderGraph::importImage(const std::string& name, vk::Format format, vk::ImageLayout finalLayout,
+	vk::ImageLayout initialLayout, vk::PipelineStageFlags initialStage)
+{
+	Resource resource;
+	resource.name = name;
+	resource.imported = true;
+	resource.format = format;
+	resource.initialLayout = initialLayout;
+	resource.initialStage = initialStage;
+	resource.finalLayout = finalLayout;
+	resources.push_back(resource);
+	return static_cast<RenderResource>(resources.size() - 1);
+}
+
+RenderResource RenderGraph::importBuffer(const std::string& name, vk::PipelineStageFlags initialStage, vk::AccessFlags initialAccess)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = true;
+	resource.initialStage = initialStage;
+	resource.initialAccess = initialAccess;
+	resources.push_back(resource);
+	return static_cast<RenderResource>(resources.size() - 1);
+}
+
+void RenderGraph::markOutput(RenderResource resource)
+{
+	resources[resource].output = true;
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, PassType type, RecordFunction record)
+{
+	Pass pass;
+	pass.name = name;
+	pass.type = type;
+	pass.record = std::move(record);
+	passes.push_back(std::move(pass));
+	return static_cast<uint32_t>(passes.size() - 1);
+}
+
+void RenderGraph::read(uint32_t pass, RenderResource resource, ResourceAccess access)
+{
+	passes[pass].accesses.push_back({ resource, access, false, false });
+}
+
+void RenderGraph::write(uint32_t pass, RenderResource resource, ResourceAccess access, bool discard)
+{
+	passes[pass].accesses.push_back({ resource, access, true, discard });
+}
+
+void RenderGraph::setClear(uint32_t pass, RenderResource resource, const vk::ClearValue& clear)
+{
+	passes[pass].clears.push_back({ resource, clear });
+}
+
+void RenderGraph::setSecondaryContents(uint32_t pass)
+{
+	passes[pass].secondaryContents = true;
+}
+
+void RenderGraph::setSideEffects(uint32_t pass)
+{
+	passes[pass].sideEffects = true;
+}
+
+RenderGraph::Usage RenderGraph::usageOf(const Pass& pass, RenderResource resource) const
+{
+	vk::PipelineStageFlags shaderStages = pass.type == PassType::Compute ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eComputeShader)
+		: vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader;
+	vk::PipelineStageFlags depthStages = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+
+	Usage usage;
+	for (const auto& access : pass.accesses)
+	{
+		if (access.resource != resource)
+			continue;
+
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+		switch (access.access)
+		{
+		case ResourceAccess::ColorAttachment:
+			layout = vk::ImageLayout::eColorAttachmentOptimal;
+			usage.stages |= vk::PipelineStageFlagBits::eColorAttachmentOutput;
+			usage.access |= vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+			break;
+		case ResourceAccess::DepthAttachment:
+			layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+			usage.stages |= depthStages;
+			usage.access |= vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+			break;
+		case ResourceAccess::DepthRead:
+			layout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+			usage.stages |= depthStages | shaderStages;
+			usage.access |= vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eShaderRead;
+			break;
+		case ResourceAccess::Sampled:
+			layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+			usage.stages |= shaderStages;
+			usage.access |= vk::AccessFlagBits::eShaderRead;
+			break;
+		case ResourceAccess::StorageRead:
+			layout = vk::ImageLayout::eGeneral;
+			usage.stages |= shaderStages;
+			usage.access |= vk::AccessFlagBits::eShaderRead;
+			break;
+		case ResourceAccess::StorageWrite:
+			layout = vk::ImageLayout::eGeneral;
+			usage.stages |= shaderStages;
+			usage.access |= vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+			break;
+		case ResourceAccess::TransferSrc:
+			layout = vk::ImageLayout::eTransferSrcOptimal;
+			usage.stages |= vk::PipelineStageFlagBits::eTransfer;
+			usage.access |= vk::AccessFlagBits::eTransferRead;
+			break;
+		case ResourceAccess::TransferDst:
+			layout = vk::ImageLayout::eTransferDstOptimal;
+			usage.stages |= vk::PipelineStageFlagBits::eTransfer;
+			usage.access |= vk::AccessFlagBits::eTransferWrite;
+			break;
+		case ResourceAccess::IndirectRead:
+			usage.stages |= vk::PipelineStageFlagBits::eDrawIndirect;
+			usage.access |= vk::AccessFlagBits::eIndirectCommandRead;
+			break;
+		case ResourceAccess::VertexRead:
+			usage.stages |= vk::PipelineStageFlagBits::eVertexInput;
+			usage.access |= vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead;
+			break;
+		}
+
+		if (resources[resource].isImage)
+		{
+			if (usage.layout != vk::ImageLayout::eUndefined && usage.layout != layout)
+				throw std::runtime_error("[Error] Render graph pass " + pass.name + " uses " + resources[resource].name + " in two layouts");
+			usage.layout = layout;
+		}
+		usage.write = usage.write || access.write;
+	}
+	return usage;
+}
+
+bool RenderGraph::discards(const Pass& pass, RenderResource resource) const
+{
+	for (const auto& clear : pass.clears)
+	{
+		if (clear.resource == resource)
+			return true;
+	}
+
+	// Discarded only if nothing in the pass needs the old contents
+	bool discard = false;
+	for (const auto& access : pass.accesses)
+	{
+		if (access.resource != resource)
+			continue;
+		if (!access.write || !access.discard)
+			return false;
+		discard = true;
+	}
+	return discard;
+}
+
+bool RenderGraph::contentsNeededAfter(uint32_t position, RenderResource resource) const
+{
+	for (uint32_t i = position + 1; i < schedule.size(); i++)
+	{
+		const auto& pass = passes[schedule[i]];
+		bool uses = std::any_of(pass.accesses.begin(), pass.accesses.end(), [&](const Access& access) { return access.resource == resource; });
+		if (uses)
+			return !discards(pass, resource);
+	}
+	return resources[resource].imported || resources[resource].output;
+}
+
+void RenderGraph::cullPasses()
+{
+	// Walk back from the outputs, a pass survives if something still needs one of its writes
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t i = 0; i < resources.size(); i++)
+		needed[i] = resources[i].output;
+
+	for (size_t i = passes.size(); i-- > 0;)
+	{
+		auto& pass = passes[i];
+		bool alive = pass.sideEffects;
+		for (const auto& access : pass.accesses)
+			alive = alive || (access.write && needed[access.resource]);
+
+		pass.culled = !alive;
+		if (!alive)
+			continue;
+
+		for (const auto& access : pass.accesses)
+		{
+			if (discards(pass, access.resource))
+				needed[access.resource] = false;
+		}
+		for (const auto& access : pass.accesses)
+		{
+			if (!discards(pass, access.resource))
+				needed[access.resource] = true;
+		}
+	}
+
+	schedule.clear();
+	for (uint32_t i = 0; i < passes.size(); i++)
+	{
+		if (!passes[i].culled)
+			schedule.push_back(i);
+	}
+}
+
+std::vector<RenderGraph::State> RenderGraph::scheduleBarriers(const std::vector<State>& initial)
+{
+	auto states = initial;
+
+	for (auto passIndex : schedule)
+	{
+		auto& pass = passes[passIndex];
+		pass.barriers = Barriers();
+
+		std::vector<RenderResource> used;
+		for (const auto& access : pass.accesses)
+		{
+			if (std::find(used.begin(), used.end(), access.resource) == used.end())
+				used.push_back(access.resource);
+		}
+
+		for (auto resource : used)
+		{
+			auto usage = usageOf(pass, resource);
+			auto& state = states[resource];
+			auto& barriers = pass.barriers;
+
+			bool transition = resources[resource].isImage && usage.layout != state.layout;
+			if (transition || usage.write)
+			{
+				// Waits for the last write and for every read since, the write-after-read hazard
+				auto srcStages = state.writeStages | state.readStages;
+				if (transition)
+				{
+					barriers.images.push_back({ resource, discards(pass, resource) ? vk::ImageLayout::eUndefined : state.layout,
+						usage.layout, state.writeAccess, usage.access });
+					barriers.srcStages |= srcStages ? srcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+					barriers.dstStages |= usage.stages;
+				}
+				else if (srcStages)
+				{
+					barriers.srcStages |= srcStages;
+					barriers.dstStages |= usage.stages;
+					barriers.srcAccess |= state.writeAccess;
+					barriers.dstAccess |= usage.access;
+				}
+
+				state.layout = usage.layout;
+				if (usage.write)
+				{
+					state.writeStages = usage.stages;
+					state.writeAccess = usage.access & WRITE_ACCESS;
+					state.readStages = vk::PipelineStageFlags();
+					state.readAccess = vk::AccessFlags();
+				}
+				else
+				{
+					// Later reads elsewhere still have to wait for the transition
+					state.writeStages = usage.stages;
+					state.writeAccess = vk::AccessFlags();
+					state.readStages = usage.stages;
+					state.readAccess = usage.access;
+				}
+			}
+			else
+			{
+				// Reads in stages already synchronized with the last write need no barrier
+				bool covered = !(usage.stages & ~state.readStages) && !(usage.access & ~state.readAccess);
+				if (state.writeStages && !covered)
+				{
+					barriers.srcStages |= state.writeStages;
+					barriers.dstStages |= usage.stages;
+					barriers.srcAccess |= state.writeAccess;
+					barriers.dstAccess |= usage.access;
+				}
+				state.readStages |= usage.stages;
+				state.readAccess |= usage.access;
+			}
+		}
+	}
+
+	finalBarriers = Barriers();
+	for (RenderResource i = 0; i < resources.size(); i++)
+	{
+		const auto& resource = resources[i];
+		auto& state = states[i];
+		if (!resource.imported || !resource.isImage || resource.finalLayout == vk::ImageLayout::eUndefined ||
+			resource.finalLayout == state.layout)
+			continue;
+
+		auto srcStages = state.writeStages | state.readStages;
+		finalBarriers.images.push_back({ i, state.layout, resource.finalLayout, state.writeAccess, vk::AccessFlags() });
+		finalBarriers.srcStages |= srcStages ? srcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+		finalBarriers.dstStages |= vk::PipelineStageFlagBits::eBottomOfPipe;
+	}
+	return states;
+}
+
+void RenderGraph::compile(vk::Extent2D extent)
+{
+	graphExtent = extent;
+	cullPasses();
+
+	for (uint32_t position = 0; position < schedule.size(); position++)
+	{
+		for (const auto& access : passes[schedule[position]].accesses)
+		{
+			auto& resource = resources[access.resource];
+			resource.firstUse = std::min(resource.firstUse, position);
+			resource.lastUse = std::max(resource.lastUse, position);
+			resource.usage |= imageUsageOf(access.access);
+		}
+	}
+
+	createRenderPasses();
+	createTransients();
+}
+
+void RenderGraph::createRenderPasses()
+{
+	for (uint32_t position = 0; position < schedule.size(); position++)
+	{
+		auto& pass = passes[schedule[position]];
+		if (pass.type != PassType::Graphics)
+			continue;
+
+		std::vector<vk::AttachmentDescription> descriptions;
+		std::vector<vk::AttachmentReference> colorRefs;
+		vk::AttachmentReference depthRef;
+		bool hasDepth = false;
+
+		for (const auto& access : pass.accesses)
+		{
+			auto resource = access.resource;
+			auto usage = usageOf(pass, resource);
+			if (!isAttachment(usage.layout) || std::find(pass.attachments.begin(), pass.attachments.end(), resource) != pass.attachments.end())
+				continue;
+
+			auto clear = std::find_if(pass.clears.begin(), pass.clears.end(), [&](const Clear& c) { return c.resource == resource; });
+			auto loadOp = clear != pass.clears.end() ? vk::AttachmentLoadOp::eClear
+				: discards(pass, resource) ? vk::AttachmentLoadOp::eDontCare : vk::AttachmentLoadOp::eLoad;
+			// Read-only attachments are stored, dontCare would allow the contents to be trashed
+			auto storeOp = !usage.write || contentsNeededAfter(position, resource) ? vk::AttachmentStoreOp::eStore
+				: vk::AttachmentStoreOp::eDontCare;
+			bool stencil = static_cast<bool>(aspectOf(resources[resource].format) & vk::ImageAspectFlagBits::eStencil);
+
+			// The graph's barriers do every transition, the render pass keeps the layout
+			descriptions.push_back(vk::AttachmentDescription()
+				.setFormat(resources[resource].format)
+				.setSamples(resources[resource].desc.samples)
+				.setLoadOp(loadOp)
+				.setStoreOp(storeOp)
+				.setStencilLoadOp(stencil ? loadOp : vk::AttachmentLoadOp::eDontCare)
+				.setStencilStoreOp(stencil ? storeOp : vk::AttachmentStoreOp::eDontCare)
+				.setInitialLayout(usage.layout)
+				.setFinalLayout(usage.layout));
+
+			auto ref = vk::AttachmentReference()
+				.setAttachment(static_cast<uint32_t>(pass.attachments.size()))
+				.setLayout(usage.layout);
+			if (usage.layout == vk::ImageLayout::eColorAttachmentOptimal)
+				colorRefs.push_back(ref);
+			else
+			{
+				if (hasDepth)
+					throw std::runtime_error("[Error] Render graph pass " + pass.name + " has more than one depth attachment");
+				depthRef = ref;
+				hasDepth = true;
+			}
+
+			pass.attachments.push_back(resource);
+			pass.clearValues.push_back(clear != pass.clears.end() ? clear->value : vk::ClearValue());
+		}
+
+		if (pass.attachments.empty())
+			throw std::runtime_error("[Error] Render graph pass " + pass.name + " has no attachments");
+
+		auto subpass = vk::SubpassDescription()
+			.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+			.setColorAttachmentCount(static_cast<uint32_t>(colorRefs.size()))
+			.setPColorAttachments(colorRefs.data())
+			.setPDepthStencilAttachment(hasDepth ? &depthRef : nullptr);
+
+		auto renderPassInfo = vk::RenderPassCreateInfo()
+			.setAttachmentCount(static_cast<uint32_t>(descriptions.size()))
+			.setPAttachments(descriptions.data())
+			.setSubpassCount(1)
+			.setPSubpasses(&subpass);
+
+		pass.renderPass = device.createRenderPass(renderPassInfo);
+	}
+}
+
+void RenderGraph::createTransients()
+{
+	// Slots are filled in order of first use, so a slot's last occupant is the one to check for overlap
+	std::vector<RenderResource> transients;
+	for (RenderResource i = 0; i < resources.size(); i++)
+	{
+		if (!resources[i].imported && resources[i].firstUse != UINT32_MAX)
+			transients.push_back(i);
+		else if (resources[i].imported)
+			resources[i].extent = graphExtent;
+	}
+	std::sort(transients.begin(), transients.end(),
+		[&](RenderResource a, RenderResource b) { return resources[a].firstUse < resources[b].firstUse; });
+
+	transientBytes = 0;
+	for (auto index : transients)
+	{
+		auto& resource = resources[index];
+		resource.extent = vk::Extent2D()
+			.setWidth(std::max(1u, static_cast<uint32_t>(graphExtent.width * resource.desc.scale)))
+			.setHeight(std::max(1u, static_cast<uint32_t>(graphExtent.height * resource.desc.scale)));
+
+		auto imageInfo = vk::ImageCreateInfo()
+			.setImageType(vk::ImageType::e2D)
+			.setFormat(resource.format)
+			.setExtent(vk::Extent3D(resource.extent.width, resource.extent.height, 1))
+			.setMipLevels(1)
+			.setArrayLayers(1)
+			.setSamples(resource.desc.samples)
+			.setTiling(vk::ImageTiling::eOptimal)
+			.setUsage(resource.usage)
+			.setSharingMode(vk::SharingMode::eExclusive)
+			.setInitialLayout(vk::ImageLayout::eUndefined);
+
+		resource.image = device.createImage(imageInfo);
+		auto requirements = device.getImageMemoryRequirements(resource.image);
+		transientBytes += requirements.size;
+
+		resource.slot = UINT32_MAX;
+		for (uint32_t i = 0; i < slots.size() && resource.slot == UINT32_MAX; i++)
+		{
+			auto& slot = slots[i];
+			if (resources[slot.occupants.back()].lastUse < resource.firstUse &&
+				(slot.requirements.memoryTypeBits & requirements.memoryTypeBits))
+				resource.slot = i;
+		}
+		if (resource.slot == UINT32_MAX)
+		{
+			resource.slot = static_cast<uint32_t>(slots.size());
+			slots.emplace_back();
+			slots.back().requirements = requirements;
+		}
+
+		auto& slot = slots[resource.slot];
+		slot.occupants.push_back(index);
+		slot.requirements.size = std::max(slot.requirements.size, requirements.size);
+		slot.requirements.alignment = std::max(slot.requirements.alignment, requirements.alignment);
+		slot.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+	}
+
+	for (auto& slot : slots)
+	{
+		slot.allocation = allocator->allocate(slot.requirements, vk::MemoryPropertyFlagBits::eDeviceLocal, ResourceKind::Optimal);
+		for (auto index : slot.occupants)
+			device.bindImageMemory(resources[index].image, slot.allocation.memory, slot.allocation.offset);
+	}
+
+	for (auto index : transients)
+	{
+		auto& resource = resources[index];
+		auto viewInfo = vk::ImageViewCreateInfo()
+			.setImage(resource.image)
+			.setViewType(vk::ImageViewType::e2D)
+			.setFormat(resource.format)
+			.setSubresourceRange(vk::ImageSubresourceRange(aspectOf(resource.format), 0, 1, 0, 1));
+
+		resource.view = device.createImageView(viewInfo);
+	}
+
+	std::vector<State> initial(resources.size());
+	for (RenderResource i = 0; i < resources.size(); i++)
+	{
+		initial[i].layout = resources[i].initialLayout;
+		initial[i].writeStages = resources[i].initialStage;
+		initial[i].writeAccess = resources[i].initialAccess;
+	}
+
+	// A transient's first use waits for whatever last touched its memory: the previous occupant of the slot,
+	// or for the first occupant the last one of the previous frame, which may still be executing
+	auto finalStates = scheduleBarriers(initial);
+	for (const auto& slot : slots)
+	{
+		for (size_t i = 0; i < slot.occupants.size(); i++)
+		{
+			auto previous = slot.occupants[(i + slot.occupants.size() - 1) % slot.occupants.size()];
+			initial[slot.occupants[i]].writeStages = finalStates[previous].writeStages | finalStates[previous].readStages;
+			initial[slot.occupants[i]].writeAccess = finalStates[previous].writeAccess;
+		}
+	}
+	scheduleBarriers(initial);
+}
+
+void RenderGraph::setExtent(vk::Extent2D extent)
+{
+	bool resized = extent != graphExtent;
+	retire(resized);
+	graphExtent = extent;
+	if (resized)
+		createTransients();
+}
+
+void RenderGraph::bindImage(RenderResource resource, vk::Image image, vk::ImageView view, vk::Extent2D extent)
+{
+	resources[resource].image = image;
+	resources[resource].view = view;
+	resources[resource].extent = extent.width && extent.height ? extent : graphExtent;
+}
+
+vk::Framebuffer RenderGraph::framebuffer(uint32_t pass)
+{
+	std::vector<vk::ImageView> views;
+	for (auto resource : passes[pass].attachments)
+		views.push_back(resources[resource].view);
+
+	for (const auto& cached : framebuffers)
+	{
+		if (cached.pass == pass && cached.views == views)
+			return cached.framebuffer;
+	}
+
+	auto extent = resources[passes[pass].attachments[0]].extent;
+	auto framebufferInfo = vk::FramebufferCreateInfo()
+		.setRenderPass(passes[pass].renderPass)
+		.setAttachmentCount(static_cast<uint32_t>(views.size()))
+		.setPAttachments(views.data())
+		.setWidth(extent.width)
+		.setHeight(extent.height)
+		.setLayers(1);
+
+	auto framebuffer = device.createFramebuffer(framebufferInfo);
+	framebuffers.push_back({ pass, views, framebuffer });
+	return framebuffer;
+}
+
+void RenderGraph::retire(bool transients)
+{
+	// Frames in flight may still use these, the deletion queue holds them until those frames complete
+	for (const auto& cached : framebuffers)
+		deletions->destroy(cached.framebuffer);
+	framebuffers.clear();
+
+	if (!transients)
+		return;
+	for (auto& resource : resources)
+	{
+		if (resource.imported || !resource.image)
+			continue;
+		deletions->destroy(resource.view);
+		deletions->destroy(resource.image);
+		resource.view = VK_NULL_HANDLE;
+		resource.image = VK_NULL_HANDLE;
+	}
+	for (auto& slot : slots)
+		deletions->free(slot.allocation);
+	slots.clear();
+}
+
+bool RenderGraph::isBound(const Pass& pass) const
+{
+	for (const auto& access : pass.accesses)
+	{
+		const auto& resource = resources[access.resource];
+		if (resource.isImage && resource.imported && !resource.image)
+			return false;
+	}
+	return true;
+}
+
+void RenderGraph::recordBarriers(vk::CommandBuffer commandBuffer, const Barriers& barriers) const
+{
+	if (!barriers.srcStages)
+		return;
+
+	std::vector<vk::ImageMemoryBarrier> imageBarriers;
+	for (const auto& barrier : barriers.images)
+	{
+		const auto& resource = resources[barrier.resource];
+		if (!resource.image)
+			continue;
+		imageBarriers.push_back(vk::ImageMemoryBarrier()
+			.setSrcAccessMask(barrier.srcAccess)
+			.setDstAccessMask(barrier.dstAccess)
+			.setOldLayout(barrier.oldLayout)
+			.setNewLayout(barrier.newLayout)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setImage(resource.image)
+			.setSubresourceRange(vk::ImageSubresourceRange(aspectOf(resource.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS)));
+	}
+
+	std::vector<vk::MemoryBarrier> memoryBarriers;
+	if (barriers.srcAccess || barriers.dstAccess)
+	{
+		memoryBarriers.push_back(vk::MemoryBarrier()
+			.setSrcAccessMask(barriers.srcAccess)
+			.setDstAccessMask(barriers.dstAccess));
+	}
+
+	commandBuffer.pipelineBarrier(barriers.srcStages, barriers.dstStages, vk::DependencyFlags(), memoryBarriers, nullptr, imageBarriers);
+}
+
+void RenderGraph::execute(vk::CommandBuffer commandBuffer)
+{
+	for (auto passIndex : schedule)
+	{
+		auto& pass = passes[passIndex];
+		if (!pass.enabled || !isBound(pass))
+		{
+			recordBarriers(commandBuffer, pass.barriers);
+			continue;
+		}
+		// Spans outlive the pass in the profiler's history, so they get the profiler's copy of the name
+		if (profiler && !pass.spanName)
+			pass.spanName = profiler->internName(pass.name);
+		auto span = profiler ? profiler->beginGpuSpan(commandBuffer, pass.spanName) : UINT32_MAX;
+
+		recordBarriers(commandBuffer, pass.barriers);
+		if (pass.type == PassType::Graphics)
+		{
+			auto renderArea = vk::Rect2D()
+				.setOffset({ 0, 0 })
+				.setExtent(resources[pass.attachments[0]].extent);
+
+			auto renderPassBeginInfo = vk::RenderPassBeginInfo()
+				.setRenderPass(pass.renderPass)
+				.setFramebuffer(framebuffer(passIndex))
+				.setRenderArea(renderArea)
+				.setClearValueCount(static_cast<uint32_t>(pass.clearValues.size()))
+				.setPClearValues(pass.clearValues.data());
+
+			commandBuffer.beginRenderPass(renderPassBeginInfo,
+				pass.secondaryContents ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+			pass.record(commandBuffer);
+			commandBuffer.endRenderPass();
+		}
+		else
+			pass.record(commandBuffer);
+
+		if (profiler)
+			profiler->endGpuSpan(commandBuffer, span);
+	}
+
+	recordBarriers(commandBuffer, finalBarriers);
+}
+
+void RenderGraph::printStats() const
+{
+	uint32_t barrierCount = finalBarriers.srcStages ? 1 : 0;
+	for (auto passIndex : schedule)
+		barrierCount += passes[passIndex].barriers.srcStages ? 1 : 0;
+
+	vk::DeviceSize aliasedBytes = 0;
+	for (const auto& slot : slots)
+		aliasedBytes += slot.requirements.size;
+
+	std::cout << "[RenderGraph] " << schedule.size() << " of " << passes.size() << " passes scheduled, "
+		<< barrierCount << " barriers per frame\n";
+	for (const auto& pass : passes)
+	{
+		if (pass.culled)
+			std::cout << "\t--Culled: " << pass.name << "\n";
+	}
+	std::cout << "\t--Transient memory: " << aliasedBytes / (1024.0 * 1024.0) << " MB in " << slots.size() << " slots, "
+		<< transientBytes / (1024.0 * 1024.0) << " MB without aliasing\n";
+}
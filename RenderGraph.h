@@ -0,0 +1,244 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "FrameProfiler.h"
+#include "MemoryAllocator.h"
+
+using RenderResource = uint32_t;
+const RenderResource INVALID_RESOURCE = UINT32_MAX;
+
+enum class PassType
+{
+	Graphics,
+	Compute,
+	Transfer
+};
+
+// How a pass touches a resource; the layout, stages and access masks follow from it and the pass type
+enum class ResourceAccess
+{
+	ColorAttachment,
+	DepthAttachment,
+	DepthRead,
+	Sampled,
+	StorageRead,
+	StorageWrite,
+	TransferSrc,
+	TransferDst,
+	IndirectRead,
+	VertexRead
+};
+
+struct TransientImageDesc
+{
+	vk::Format format = vk::Format::eUndefined;
+	// Relative to the graph extent
+	float scale = 1.0f;
+	vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+	// Added to the usage the passes declare, for access within a pass the graph does not track
+	vk::ImageUsageFlags usage;
+};
+
+// Frame passes declared with the resources they read and write, compiled once into a fixed schedule.
+// compile() drops passes whose results nothing needs, derives the barriers and layout transitions between
+// passes and batches them into one vkCmdPipelineBarrier per pass, and gives each graphics pass a render pass
+// whose load and store ops skip contents nobody reads. Transient images live only within a frame, images
+// whose lifetimes do not overlap share memory. All passes go to one queue, in declaration order.
+class RenderGraph
+{
+public:
+	using RecordFunction = std::function<void(vk::CommandBuffer)>;
+
+	void init(vk::Device device, MemoryAllocator& allocator, DeletionQueue& deletions);
+	void destroy();
+	// Wraps every pass in a GPU span named after it
+	void setProfiler(FrameProfiler* profiler) { this->profiler = profiler; }
+
+	RenderResource createImage(const std::string& name, const TransientImageDesc& desc);
+	// Owned elsewhere, bound every frame and sized like the graph unless bound with an extent of its own. Each frame
+	// starts from initialLayout, the first use waits on initialStage, and the image is left in finalLayout unless that is undefined.
+	RenderResource importImage(const std::string& name, vk::Format format, vk::ImageLayout finalLayout,
+		vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined, vk::PipelineStageFlags initialStage = vk::PipelineStageFlagBits::eTopOfPipe);
+	// Buffers only order passes; their barriers are global memory barriers, so no handle is needed. Buffers carrying
+	// results from one frame to the next pass the stages and access of their last use, which the first use waits for.
+	RenderResource importBuffer(const std::string& name, vk::PipelineStageFlags initialStage = vk::PipelineStageFlags(),
+		vk::AccessFlags initialAccess = vk::AccessFlags());
+	// Kept along with every pass it depends on
+	void markOutput(RenderResource resource);
+
+	uint32_t addPass(const std::string& name, PassType type, RecordFunction record);
+	void read(uint32_t pass, RenderResource resource, ResourceAccess access);
+	// With discard the previous contents are neither loaded nor kept alive, their producers may be culled
+	void write(uint32_t pass, RenderResource resource, ResourceAccess access, bool discard = false);
+	// Clears an attachment the pass writes, which discards it too
+	void setClear(uint32_t pass, RenderResource resource, const vk::ClearValue& clear);
+	// The record function of a graphics pass executes secondary command buffers
+	void setSecondaryContents(uint32_t pass);
+	// Runs even when nothing reads what it writes
+	void setSideEffects(uint32_t pass);
+	// Disabled passes are skipped like those with an unbound image, for work whose target is missing this frame
+	void setEnabled(uint32_t pass, bool enabled) { passes[pass].enabled = enabled; }
+
+	void compile(vk::Extent2D extent);
+	// Retires every cached framebuffer, and the transient images if the extent changed.
+	// Call whenever imported views are recreated, their handles may be reused.
+	void setExtent(vk::Extent2D extent);
+	// This frame's image and view of an imported resource, before framebuffer() or execute(). A zero extent
+	// means the graph extent. Passes touching an imported image left unbound are skipped this frame, along with
+	// that image's transitions; their memory barriers are kept so the passes around them stay ordered.
+	void bindImage(RenderResource resource, vk::Image image, vk::ImageView view, vk::Extent2D extent = vk::Extent2D());
+
+	vk::RenderPass renderPass(uint32_t pass) const { return passes[pass].renderPass; }
+	vk::Framebuffer framebuffer(uint32_t pass);
+	bool isCulled(uint32_t pass) const { return passes[pass].culled; }
+	vk::Image image(RenderResource resource) const { return resources[resource].image; }
+	vk::ImageView imageView(RenderResource resource) const { return resources[resource].view; }
+	vk::Extent2D extent() const { return graphExtent; }
+
+	// Into the frame's primary command buffer, once per frame
+	void execute(vk::CommandBuffer commandBuffer);
+	void printStats() const;
+
+private:
+	struct Access
+	{
+		RenderResource resource;
+		ResourceAccess access;
+		bool write;
+		bool discard;
+	};
+
+	struct Usage
+	{
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+		vk::PipelineStageFlags stages;
+		vk::AccessFlags access;
+		bool write = false;
+	};
+
+	struct ImageBarrier
+	{
+		RenderResource resource;
+		vk::ImageLayout oldLayout;
+		vk::ImageLayout newLayout;
+		vk::AccessFlags srcAccess;
+		vk::AccessFlags dstAccess;
+	};
+
+	struct Barriers
+	{
+		vk::PipelineStageFlags srcStages;
+		vk::PipelineStageFlags dstStages;
+		vk::AccessFlags srcAccess;
+		vk::AccessFlags dstAccess;
+		std::vector<ImageBarrier> images;
+	};
+
+	struct Clear
+	{
+		RenderResource resource;
+		vk::ClearValue value;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		// Interned by the profiler on first execution
+		const char* spanName = nullptr;
+		PassType type;
+		RecordFunction record;
+		std::vector<Access> accesses;
+		std::vector<Clear> clears;
+		bool secondaryContents = false;
+		bool sideEffects = false;
+		bool enabled = true;
+
+		bool culled = false;
+		Barriers barriers;
+		vk::RenderPass renderPass;
+		std::vector<RenderResource> attachments;
+		std::vector<vk::ClearValue> clearValues;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		bool isImage = true;
+		bool imported = false;
+		bool output = false;
+		vk::Format format = vk::Format::eUndefined;
+		TransientImageDesc desc;
+		vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
+		vk::PipelineStageFlags initialStage;
+		vk::AccessFlags initialAccess;
+		vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined;
+
+		// Transients: usage gathered from every pass, lifetime in schedule positions and aliasing slot
+		vk::ImageUsageFlags usage;
+		uint32_t firstUse = UINT32_MAX;
+		uint32_t lastUse = 0;
+		uint32_t slot = UINT32_MAX;
+
+		vk::Image image;
+		vk::ImageView view;
+		vk::Extent2D extent;
+	};
+
+	// Where a resource stands between passes: the last write and the reads synchronized with it since
+	struct State
+	{
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+		vk::PipelineStageFlags writeStages;
+		vk::AccessFlags writeAccess;
+		vk::PipelineStageFlags readStages;
+		vk::AccessFlags readAccess;
+	};
+
+	struct Slot
+	{
+		std::vector<RenderResource> occupants;
+		vk::MemoryRequirements requirements;
+		MemoryAllocation allocation;
+	};
+
+	struct CachedFramebuffer
+	{
+		uint32_t pass;
+		std::vector<vk::ImageView> views;
+		vk::Framebuffer framebuffer;
+	};
+
+	Usage usageOf(const Pass& pass, RenderResource resource) const;
+	bool discards(const Pass& pass, RenderResource resource) const;
+	bool contentsNeededAfter(uint32_t position, RenderResource resource) const;
+	void cullPasses();
+	std::vector<State> scheduleBarriers(const std::vector<State>& initial);
+	void createRenderPasses();
+	void createTransients();
+	void retire(bool transients);
+	bool isBound(const Pass& pass) const;
+	void recordBarriers(vk::CommandBuffer commandBuffer, const Barriers& barriers) const;
+
+private:
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	FrameProfiler* profiler = nullptr;
+	DeletionQueue* deletions = nullptr;
+	vk::Extent2D graphExtent;
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	// Surviving passes in declaration order
+	std::vector<uint32_t> schedule;
+	Barriers finalBarriers;
+	std::vector<Slot> slots;
+	vk::DeviceSize transientBytes = 0;
+
+	std::vector<CachedFramebuffer> framebuffers;
+};
@@ -0,0 +1,176 @@
+#include "ShaderArchive.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+const char SHADER_ARCHIVE_MAGIC[4] = { 'V', 'K', 'S', 'A' };
+const uint32_t SHADER_ARCHIVE_VERSION = 1;
+const uint32_t SPIRV_MAGIC = 0x07230203;
+const uint64_t SHADER_ARCHIVE_ALIGNMENT = 16;
+
+ShaderArchive::~ShaderArchive()
+{
+	close();
+}
+
+bool ShaderArchive::open(const std::string& filename)
+{
+	close();
+
+	if (!file.open(filename))
+		return false;
+	data = file.data();
+	dataSize = file.size();
+
+	// Validate the table of contents once here so find() can trust it
+	Header header;
+	bool valid = dataSize >= sizeof(Header);
+	if (valid)
+	{
+		std::memcpy(&header, data, sizeof(header));
+		valid = std::memcmp(header.magic, SHADER_ARCHIVE_MAGIC, sizeof(header.magic)) == 0 &&
+			header.version == SHADER_ARCHIVE_VERSION &&
+			header.entryCount <= (dataSize - sizeof(Header)) / sizeof(Entry);
+	}
+	if (valid)
+	{
+		toc = reinterpret_cast<const Entry*>(data + sizeof(Header));
+		entries = header.entryCount;
+		for (size_t i = 0; valid && i < entries; i++)
+		{
+			const auto& entry = toc[i];
+			valid = entry.offset % 4 == 0 && entry.size % 4 == 0 && entry.size >= 4 &&
+				entry.offset <= dataSize && entry.size <= dataSize - entry.offset &&
+				(i == 0 || toc[i - 1].nameHash < entry.nameHash);
+		}
+	}
+	if (!valid)
+	{
+		std::cout << "[ShaderArchive] Discarding corrupt archive: " << filename << "\n";
+		close();
+		return false;
+	}
+	return true;
+}
+
+void ShaderArchive::close()
+{
+	file.close();
+	data = nullptr;
+	dataSize = 0;
+	toc = nullptr;
+	entries = 0;
+}
+
+ShaderArchive::Code ShaderArchive::find(const std::string& name) const
+{
+	if (!data)
+		return Code();
+
+	uint64_t hash = fnv1a64(name);
+	auto entry = std::lower_bound(toc, toc + entries, hash,
+		[](const Entry& entry, uint64_t hash) { return entry.nameHash < hash; });
+	if (entry == toc + entries || entry->nameHash != hash)
+		return Code();
+
+	// Blobs are 16 byte aligned within a page aligned mapping, so the words can be used in place
+	Code code;
+	code.words = reinterpret_cast<const uint32_t*>(data + entry->offset);
+	code.size = static_cast<size_t>(entry->size);
+	if (code.words[0] != SPIRV_MAGIC)
+	{
+		std::cout << "[ShaderArchive] Entry is not SPIR-V: " << name << "\n";
+		return Code();
+	}
+	return code;
+}
+
+bool ShaderArchive::pack(const std::string& filename, const std::vector<std::string>& inputs)
+{
+	struct Input
+	{
+		Entry entry;
+		std::string name;
+		std::vector<char> code;
+	};
+
+	std::vector<Input> files;
+	for (const auto& path : inputs)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			std::cout << "[Error] Unable to read file: " << path << "\n";
+			return false;
+		}
+
+		Input input;
+		input.name = path.substr(path.find_last_of("/\\") + 1);
+		input.code.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(input.code.data(), input.code.size());
+
+		uint32_t magic = 0;
+		if (input.code.size() >= 4)
+			std::memcpy(&magic, input.code.data(), sizeof(magic));
+		if (magic != SPIRV_MAGIC || input.code.size() % 4 != 0)
+		{
+			std::cout << "[Error] Not a SPIR-V binary: " << path << "\n";
+			return false;
+		}
+
+		input.entry.nameHash = fnv1a64(input.name);
+		input.entry.size = input.code.size();
+		files.push_back(std::move(input));
+	}
+
+	std::sort(files.begin(), files.end(), [](const Input& a, const Input& b) { return a.entry.nameHash < b.entry.nameHash; });
+	for (size_t i = 1; i < files.size(); i++)
+	{
+		if (files[i - 1].entry.nameHash == files[i].entry.nameHash)
+		{
+			std::cout << "[Error] Shader names collide or repeat: " << files[i - 1].name << ", " << files[i].name << "\n";
+			return false;
+		}
+	}
+
+	auto align = [](uint64_t offset) { return (offset + SHADER_ARCHIVE_ALIGNMENT - 1) & ~(SHADER_ARCHIVE_ALIGNMENT - 1); };
+	uint64_t offset = align(sizeof(Header) + files.size() * sizeof(Entry));
+	for (auto& input : files)
+	{
+		input.entry.offset = offset;
+		offset = align(offset + input.entry.size);
+	}
+
+	Header header;
+	std::memcpy(header.magic, SHADER_ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = SHADER_ARCHIVE_VERSION;
+	header.entryCount = static_cast<uint32_t>(files.size());
+	header.reserved = 0;
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "[Error] Unable to write file: " << filename << "\n";
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const auto& input : files)
+		file.write(reinterpret_cast<const char*>(&input.entry), sizeof(Entry));
+
+	const char padding[SHADER_ARCHIVE_ALIGNMENT] = {};
+	uint64_t written = sizeof(Header) + files.size() * sizeof(Entry);
+	for (const auto& input : files)
+	{
+		file.write(padding, static_cast<std::streamsize>(input.entry.offset - written));
+		file.write(input.code.data(), input.code.size());
+		written = input.entry.offset + input.entry.size;
+	}
+
+	std::cout << "[ShaderArchive] Packed " << files.size() << " shaders into " << filename << "\n";
+	return file.good();
+}
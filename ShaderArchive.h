@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Read-only view of a packed SPIR-V archive. The file is memory-mapped and shader code is handed out
+// as pointers into the mapping, so opening an archive costs one file open regardless of its size.
+//
+// Layout, native endianness:
+//   Header  { magic "VKSA", version, entryCount, reserved }
+//   Entry   { nameHash, offset, size } x entryCount, sorted by nameHash
+//   code    each blob 16 byte aligned
+// Entries are keyed by fnv1a64 of the shader's file name, e.g. "helloVK_vs.spv".
+class ShaderArchive
+{
+public:
+	struct Code
+	{
+		const uint32_t* words = nullptr;
+		size_t size = 0;
+
+		explicit operator bool() const { return words != nullptr; }
+	};
+
+	ShaderArchive() = default;
+	~ShaderArchive();
+	ShaderArchive(const ShaderArchive&) = delete;
+	ShaderArchive& operator=(const ShaderArchive&) = delete;
+
+	bool open(const std::string& filename);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+	size_t entryCount() const { return entries; }
+
+	// Stays valid until close(); empty when the archive has no such shader
+	Code find(const std::string& name) const;
+
+	// Packs the given .spv files into an archive, named by their file names
+	static bool pack(const std::string& filename, const std::vector<std::string>& inputs);
+
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	struct Entry
+	{
+		uint64_t nameHash;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+private:
+	MappedFile file;
+	const uint8_t* data = nullptr;
+	size_t dataSize = 0;
+	const Entry* toc = nullptr;
+	size_t entries = 0;
+};
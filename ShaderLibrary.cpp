@@ -0,0 +1,68 @@
+#include "ShaderLibrary.h"
+#include "Hash.h"
+
+#include <fstream>
+#include <iostream>
+
+void ShaderLibrary::init(vk::Device device, const std::string& archivePath, const std::string& shaderDirectory)
+{
+	this->device = device;
+	this->shaderDirectory = shaderDirectory;
+
+	if (!archivePath.empty() && archive.open(archivePath))
+		std::cout << "[Shaders] Mapped " << archive.entryCount() << " shaders from " << archivePath << "\n";
+	else
+		std::cout << "[Shaders] No shader archive, loading loose files from " << shaderDirectory << "\n";
+}
+
+void ShaderLibrary::destroy(DeletionQueue& deletions)
+{
+	for (auto& module : modules)
+		deletions.destroy(module.second);
+	modules.clear();
+	archive.close();
+}
+
+vk::ShaderModule ShaderLibrary::get(const std::string& name)
+{
+	uint64_t hash = fnv1a64(name);
+	auto cached = modules.find(hash);
+	if (cached != modules.end())
+		return cached->second;
+
+	vk::ShaderModule module;
+	if (auto code = archive.find(name))
+	{
+		// Straight from the mapping, the driver takes its own copy
+		auto createInfo = vk::ShaderModuleCreateInfo()
+			.setCodeSize(code.size)
+			.setPCode(code.words);
+		module = device.createShaderModule(createInfo);
+	}
+	else
+		module = createFromFile(name);
+
+	modules.emplace(hash, module);
+	return module;
+}
+
+vk::ShaderModule ShaderLibrary::createFromFile(const std::string& name)
+{
+	std::string filename = shaderDirectory + name;
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error("[Error] Unable to read file: " + filename);
+
+	// uint32_t storage keeps the code aligned for pCode
+	size_t fileSize = (size_t)file.tellg();
+	std::vector<uint32_t> code((fileSize + 3) / 4);
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(code.data()), fileSize);
+
+	auto createInfo = vk::ShaderModuleCreateInfo()
+		.setCodeSize(fileSize)
+		.setPCode(code.data());
+
+	return device.createShaderModule(createInfo);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DeletionQueue.h"
+#include "ShaderArchive.h"
+
+#include <string>
+#include <unordered_map>
+
+// Owns every vk::ShaderModule the application creates. Modules are looked up by file name, created once and
+// shared by all pipelines that use them. Code comes from the packed archive when it is present and falls back
+// to loose .spv files in the shader directory otherwise.
+class ShaderLibrary
+{
+public:
+	void init(vk::Device device, const std::string& archivePath, const std::string& shaderDirectory);
+	void destroy(DeletionQueue& deletions);
+
+	// Throws when the shader is in neither the archive nor the shader directory
+	vk::ShaderModule get(const std::string& name);
+
+	size_t moduleCount() const { return modules.size(); }
+
+private:
+	vk::ShaderModule createFromFile(const std::string& name);
+
+private:
+	vk::Device device;
+	ShaderArchive archive;
+	std::string shaderDirectory;
+	std::unordered_map<uint64_t, vk::ShaderModule> modules;
+};
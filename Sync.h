@@ -0,0 +1,11 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+// A semaphore a queue submission has to wait on; value is ignored for binary semaphores
+struct SemaphoreWait
+{
+	vk::Semaphore semaphore;
+	uint64_t value = 0;
+	vk::PipelineStageFlags stage;
+};
@@ -0,0 +1,571 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+const size_t KTX2_HEADER_SIZE = 80;
+
+// Fields following the identifier, all uint32_t
+enum Ktx2Field
+{
+	KTX2_VK_FORMAT,
+	KTX2_TYPE_SIZE,
+	KTX2_PIXEL_WIDTH,
+	KTX2_PIXEL_HEIGHT,
+	KTX2_PIXEL_DEPTH,
+	KTX2_LAYER_COUNT,
+	KTX2_FACE_COUNT,
+	KTX2_LEVEL_COUNT,
+	KTX2_SUPERCOMPRESSION,
+	KTX2_FIELD_COUNT
+};
+
+struct Ktx2Level
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+struct FormatBlock
+{
+	vk::Format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytes;
+};
+
+const FormatBlock FORMAT_BLOCKS[] =
+{
+	{ vk::Format::eR8Unorm, 1, 1, 1 },
+	{ vk::Format::eR8G8Unorm, 1, 1, 2 },
+	{ vk::Format::eR8G8B8A8Unorm, 1, 1, 4 },
+	{ vk::Format::eR8G8B8A8Srgb, 1, 1, 4 },
+	{ vk::Format::eB8G8R8A8Unorm, 1, 1, 4 },
+	{ vk::Format::eB8G8R8A8Srgb, 1, 1, 4 },
+	{ vk::Format::eR16G16B16A16Sfloat, 1, 1, 8 },
+	{ vk::Format::eR32G32B32A32Sfloat, 1, 1, 16 },
+	{ vk::Format::eBc1RgbUnormBlock, 4, 4, 8 },
+	{ vk::Format::eBc1RgbSrgbBlock, 4, 4, 8 },
+	{ vk::Format::eBc1RgbaUnormBlock, 4, 4, 8 },
+	{ vk::Format::eBc1RgbaSrgbBlock, 4, 4, 8 },
+	{ vk::Format::eBc2UnormBlock, 4, 4, 16 },
+	{ vk::Format::eBc2SrgbBlock, 4, 4, 16 },
+	{ vk::Format::eBc3UnormBlock, 4, 4, 16 },
+	{ vk::Format::eBc3SrgbBlock, 4, 4, 16 },
+	{ vk::Format::eBc4UnormBlock, 4, 4, 8 },
+	{ vk::Format::eBc4SnormBlock, 4, 4, 8 },
+	{ vk::Format::eBc5UnormBlock, 4, 4, 16 },
+	{ vk::Format::eBc5SnormBlock, 4, 4, 16 },
+	{ vk::Format::eBc6HUfloatBlock, 4, 4, 16 },
+	{ vk::Format::eBc6HSfloatBlock, 4, 4, 16 },
+	{ vk::Format::eBc7UnormBlock, 4, 4, 16 },
+	{ vk::Format::eBc7SrgbBlock, 4, 4, 16 },
+	{ vk::Format::eAstc4x4UnormBlock, 4, 4, 16 },
+	{ vk::Format::eAstc4x4SrgbBlock, 4, 4, 16 },
+	{ vk::Format::eAstc5x4UnormBlock, 5, 4, 16 },
+	{ vk::Format::eAstc5x4SrgbBlock, 5, 4, 16 },
+	{ vk::Format::eAstc5x5UnormBlock, 5, 5, 16 },
+	{ vk::Format::eAstc5x5SrgbBlock, 5, 5, 16 },
+	{ vk::Format::eAstc6x5UnormBlock, 6, 5, 16 },
+	{ vk::Format::eAstc6x5SrgbBlock, 6, 5, 16 },
+	{ vk::Format::eAstc6x6UnormBlock, 6, 6, 16 },
+	{ vk::Format::eAstc6x6SrgbBlock, 6, 6, 16 },
+	{ vk::Format::eAstc8x5UnormBlock, 8, 5, 16 },
+	{ vk::Format::eAstc8x5SrgbBlock, 8, 5, 16 },
+	{ vk::Format::eAstc8x6UnormBlock, 8, 6, 16 },
+	{ vk::Format::eAstc8x6SrgbBlock, 8, 6, 16 },
+	{ vk::Format::eAstc8x8UnormBlock, 8, 8, 16 },
+	{ vk::Format::eAstc8x8SrgbBlock, 8, 8, 16 },
+	{ vk::Format::eAstc10x5UnormBlock, 10, 5, 16 },
+	{ vk::Format::eAstc10x5SrgbBlock, 10, 5, 16 },
+	{ vk::Format::eAstc10x6UnormBlock, 10, 6, 16 },
+	{ vk::Format::eAstc10x6SrgbBlock, 10, 6, 16 },
+	{ vk::Format::eAstc10x8UnormBlock, 10, 8, 16 },
+	{ vk::Format::eAstc10x8SrgbBlock, 10, 8, 16 },
+	{ vk::Format::eAstc10x10UnormBlock, 10, 10, 16 },
+	{ vk::Format::eAstc10x10SrgbBlock, 10, 10, 16 },
+	{ vk::Format::eAstc12x10UnormBlock, 12, 10, 16 },
+	{ vk::Format::eAstc12x10SrgbBlock, 12, 10, 16 },
+	{ vk::Format::eAstc12x12UnormBlock, 12, 12, 16 },
+	{ vk::Format::eAstc12x12SrgbBlock, 12, 12, 16 },
+};
+
+static uint32_t fullMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		count++;
+	return count;
+}
+
+void TextureStreamer::init(vk::Device device, vk::PhysicalDevice physicalDevice, MemoryAllocator& allocator, UploadManager& uploader,
+	BindlessDescriptors& bindless, DeletionQueue& deletions, uint32_t framesInFlight, vk::DeviceSize budget)
+{
+	this->device = device;
+	this->physicalDevice = physicalDevice;
+	this->allocator = &allocator;
+	this->uploader = &uploader;
+	this->bindless = &bindless;
+	this->deletions = &deletions;
+	this->framesInFlight = framesInFlight;
+	this->budget = budget;
+
+	loader = std::make_unique<ThreadPool>(1);
+}
+
+void TextureStreamer::destroy()
+{
+	stopping = true;
+	loader.reset();
+
+	// Released by the owner's final flush
+	for (auto& texture : textures)
+		retire(*texture);
+	textures.clear();
+	streamQueue.clear();
+	mipQueue.clear();
+}
+
+TextureHandle TextureStreamer::load(const std::string& filename)
+{
+	TextureHandle handle = static_cast<TextureHandle>(textures.size());
+	textures.push_back(std::make_unique<Texture>());
+
+	auto texture = textures.back().get();
+	texture->name = filename;
+	loader->enqueue([this, texture]() { loadFile(*texture); });
+	return handle;
+}
+
+TextureHandle TextureStreamer::create(uint32_t width, uint32_t height, vk::Format format, const void* pixels, vk::DeviceSize size)
+{
+	TextureHandle handle = static_cast<TextureHandle>(textures.size());
+	textures.push_back(std::make_unique<Texture>());
+
+	auto& texture = *textures.back();
+	texture.name = "texture " + std::to_string(handle);
+	if (!setFormat(texture, format) || texture.blockWidth != 1 || width == 0 || height == 0 ||
+		size < vk::DeviceSize(width) * height * texture.blockBytes)
+		throw std::runtime_error("[Error] Invalid pixel data for " + texture.name);
+
+	texture.pixels.assign(static_cast<const uint8_t*>(pixels), static_cast<const uint8_t*>(pixels) + size);
+	texture.levels.push_back({ texture.pixels.data(), vk::DeviceSize(width) * height * texture.blockBytes, width, height });
+	texture.generateMips = texture.generateMips && fullMipCount(width, height) > 1;
+	texture.pagedLevels = 1;
+	texture.state = State::Ready;
+
+	// Nothing to page in, so it starts streaming with the next update
+	texture.lastUsed = frame;
+	texture.queued = true;
+	streamQueue.push_back(handle);
+	return handle;
+}
+
+bool TextureStreamer::setFormat(Texture& texture, vk::Format format)
+{
+	auto block = std::find_if(std::begin(FORMAT_BLOCKS), std::end(FORMAT_BLOCKS),
+		[&](const FormatBlock& block) { return block.format == format; });
+	if (block == std::end(FORMAT_BLOCKS))
+	{
+		std::cout << "[Textures] " << texture.name << ": unsupported format " << vk::to_string(format) << "\n";
+		return false;
+	}
+
+	auto features = physicalDevice.getFormatProperties(format).optimalTilingFeatures;
+	if (!(features & vk::FormatFeatureFlagBits::eSampledImage))
+	{
+		std::cout << "[Textures] " << texture.name << ": " << vk::to_string(format) << " cannot be sampled on this device\n";
+		return false;
+	}
+
+	texture.format = format;
+	texture.blockWidth = block->width;
+	texture.blockHeight = block->height;
+	texture.blockBytes = block->bytes;
+
+	// Only a candidate, the source decides whether it has a mip chain of its own
+	auto blitFeatures = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst |
+		vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	texture.generateMips = block->width == 1 && (features & blitFeatures) == blitFeatures;
+	return true;
+}
+
+void TextureStreamer::loadFile(Texture& texture)
+{
+	auto fail = [&](const char* reason)
+	{
+		if (reason)
+			std::cout << "[Textures] " << texture.name << ": " << reason << "\n";
+		texture.file.close();
+		texture.state = State::Failed;
+	};
+
+	if (stopping)
+		return fail(nullptr);
+	if (!texture.file.open(texture.name))
+		return fail("unable to open file");
+
+	const uint8_t* data = texture.file.data();
+	size_t dataSize = texture.file.size();
+	if (dataSize < KTX2_HEADER_SIZE || std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		return fail("not a KTX2 file");
+
+	uint32_t header[KTX2_FIELD_COUNT];
+	std::memcpy(header, data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+
+	uint32_t width = header[KTX2_PIXEL_WIDTH];
+	uint32_t height = header[KTX2_PIXEL_HEIGHT];
+	if (header[KTX2_PIXEL_DEPTH] != 0 || header[KTX2_LAYER_COUNT] > 1 || header[KTX2_FACE_COUNT] != 1 || width == 0 || height == 0)
+		return fail("only single 2D images are supported");
+	if (header[KTX2_SUPERCOMPRESSION] != 0)
+		return fail("supercompressed data is not supported");
+	if (!setFormat(texture, static_cast<vk::Format>(header[KTX2_VK_FORMAT])))
+		return fail(nullptr);
+
+	// A level count of 0 asks the loader to generate the mip chain
+	uint32_t levelCount = std::max(1u, header[KTX2_LEVEL_COUNT]);
+	if (levelCount > fullMipCount(width, height) || KTX2_HEADER_SIZE + levelCount * sizeof(Ktx2Level) > dataSize)
+		return fail("corrupt level index");
+
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		Ktx2Level entry;
+		std::memcpy(&entry, data + KTX2_HEADER_SIZE + i * sizeof(Ktx2Level), sizeof(entry));
+
+		Level level;
+		level.width = std::max(1u, width >> i);
+		level.height = std::max(1u, height >> i);
+		level.size = vk::DeviceSize((level.width + texture.blockWidth - 1) / texture.blockWidth) *
+			((level.height + texture.blockHeight - 1) / texture.blockHeight) * texture.blockBytes;
+		if (entry.byteOffset > dataSize || entry.byteLength > dataSize - entry.byteOffset || entry.byteLength < level.size)
+			return fail("corrupt level data");
+
+		level.data = data + entry.byteOffset;
+		texture.levels.push_back(level);
+	}
+	texture.generateMips = texture.generateMips && header[KTX2_LEVEL_COUNT] == 0 && fullMipCount(width, height) > 1;
+	texture.state = State::Ready;
+
+	// Coarse levels are tiny and stream first, so they are paged in first too
+	for (uint32_t i = levelCount; i-- > 0;)
+	{
+		if (stopping)
+			return;
+		texture.file.prefetch(static_cast<size_t>(texture.levels[i].data - data), static_cast<size_t>(texture.levels[i].size));
+		texture.pagedLevels = levelCount - i;
+	}
+}
+
+uint32_t TextureStreamer::use(TextureHandle handle)
+{
+	auto& texture = *textures[handle];
+	texture.lastUsed = frame;
+
+	auto state = texture.state.load();
+	if (!texture.queued && state != State::Resident && state != State::Failed)
+	{
+		texture.queued = true;
+		streamQueue.push_back(handle);
+	}
+
+	if (texture.bindlessIndex != UINT32_MAX)
+		return texture.bindlessIndex;
+	if (fallback != INVALID_TEXTURE && textures[fallback]->bindlessIndex != UINT32_MAX)
+		return textures[fallback]->bindlessIndex;
+	// Only before the fallback's first update
+	return 0;
+}
+
+void TextureStreamer::update()
+{
+	frame++;
+
+	std::vector<TextureHandle> queue;
+	queue.swap(streamQueue);
+	for (auto handle : queue)
+	{
+		auto& texture = *textures[handle];
+		auto state = texture.state.load();
+
+		// Textures that went unused before their streaming started are dropped until used again
+		bool keep = state == State::Loading || state == State::Streaming ||
+			(state == State::Ready && texture.lastUsed + framesInFlight > frame);
+		if (state == State::Ready && keep && !startStreaming(texture))
+		{
+			streamQueue.push_back(handle);
+			continue;
+		}
+		if (texture.state == State::Streaming)
+			streamLevels(handle);
+
+		if (keep && texture.state != State::Resident)
+			streamQueue.push_back(handle);
+		else
+			texture.queued = false;
+	}
+}
+
+bool TextureStreamer::startStreaming(Texture& texture)
+{
+	uint32_t sourceLevels = static_cast<uint32_t>(texture.levels.size());
+
+	// Unused textures go first; only when that is not enough are the finest levels left out
+	uint32_t baseLevel = 0;
+	while (true)
+	{
+		vk::DeviceSize estimate = 0;
+		if (texture.generateMips)
+			estimate = texture.levels[0].size * 4 / 3;
+		for (uint32_t i = baseLevel; i < sourceLevels && !texture.generateMips; i++)
+			estimate += texture.levels[i].size;
+
+		while (resident + estimate > budget && evictOne(texture))
+			;
+		if (resident + estimate <= budget)
+			break;
+		if (texture.generateMips || baseLevel + 1 >= sourceLevels)
+			return false;
+		baseLevel++;
+	}
+
+	const auto& base = texture.levels[baseLevel];
+	uint32_t mipCount = texture.generateMips ? fullMipCount(base.width, base.height) : sourceLevels - baseLevel;
+
+	auto usage = vk::ImageUsageFlags(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+	if (texture.generateMips)
+		usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+	auto imageInfo = vk::ImageCreateInfo()
+		.setImageType(vk::ImageType::e2D)
+		.setFormat(texture.format)
+		.setExtent(vk::Extent3D(base.width, base.height, 1))
+		.setMipLevels(mipCount)
+		.setArrayLayers(1)
+		.setSamples(vk::SampleCountFlagBits::e1)
+		.setTiling(vk::ImageTiling::eOptimal)
+		.setUsage(usage)
+		.setSharingMode(vk::SharingMode::eExclusive)
+		.setInitialLayout(vk::ImageLayout::eUndefined);
+
+	texture.image = device.createImage(imageInfo);
+	texture.allocation = allocator->allocateImage(texture.image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	texture.mipCount = mipCount;
+	texture.baseLevel = baseLevel;
+	texture.residentLevel = mipCount;
+	texture.rowsUploaded = 0;
+	texture.state = State::Streaming;
+	resident += texture.allocation.size;
+
+	if (baseLevel > 0)
+		std::cout << "[Textures] " << texture.name << ": over budget, streaming from level " << baseLevel << "\n";
+	return true;
+}
+
+bool TextureStreamer::evictOne(const Texture& keep)
+{
+	// Least recently used first, and never anything a frame still in flight may have sampled
+	Texture* victim = nullptr;
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		auto& texture = *textures[i];
+		auto state = texture.state.load();
+		if (&texture == &keep || i == fallback || (state != State::Resident && state != State::Streaming))
+			continue;
+		if (texture.lastUsed + framesInFlight > frame)
+			continue;
+		if (!victim || texture.lastUsed < victim->lastUsed)
+			victim = &texture;
+	}
+	if (!victim)
+		return false;
+
+	retire(*victim);
+	victim->state = State::Ready;
+	evictions++;
+	return true;
+}
+
+void TextureStreamer::streamLevels(TextureHandle handle)
+{
+	auto& texture = *textures[handle];
+	uint32_t sourceLevels = static_cast<uint32_t>(texture.levels.size());
+
+	bool completed = false;
+	while (texture.residentLevel > 0)
+	{
+		// Generated chains only upload their top level
+		uint32_t level = texture.generateMips ? 0 : texture.residentLevel - 1;
+		uint32_t sourceLevel = texture.baseLevel + level;
+		if (sourceLevel < sourceLevels - texture.pagedLevels.load())
+			break;
+
+		const auto& source = texture.levels[sourceLevel];
+		uint32_t blockRows = (source.height + texture.blockHeight - 1) / texture.blockHeight;
+		vk::DeviceSize rowBytes = vk::DeviceSize((source.width + texture.blockWidth - 1) / texture.blockWidth) * texture.blockBytes;
+		uint32_t rows = static_cast<uint32_t>(std::min<vk::DeviceSize>(blockRows - texture.rowsUploaded,
+			uploader->imageStagingAvailable() / rowBytes));
+		if (rows == 0)
+			break;
+
+		uint32_t y = texture.rowsUploaded * texture.blockHeight;
+
+		UploadManager::ImageRegion region;
+		region.image = texture.image;
+		region.mipLevel = level;
+		region.offset = vk::Offset3D(0, static_cast<int32_t>(y), 0);
+		region.extent = vk::Extent3D(source.width, std::min(rows * texture.blockHeight, source.height - y), 1);
+		region.first = texture.rowsUploaded == 0;
+		region.last = texture.rowsUploaded + rows == blockRows;
+		region.finalLayout = texture.generateMips ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::eShaderReadOnlyOptimal;
+
+		auto size = rows * rowBytes;
+		if (!uploader->uploadImage(region, source.data + texture.rowsUploaded * rowBytes, size))
+			break;
+		streamedBytes += size;
+		texture.rowsUploaded += rows;
+		if (!region.last)
+			break;
+
+		texture.rowsUploaded = 0;
+		texture.residentLevel = level;
+		completed = true;
+		if (texture.generateMips)
+		{
+			texture.residentLevel = 0;
+			mipQueue.push_back(handle);
+		}
+	}
+
+	// Draws recorded this frame already see the new levels: the copies go out before the graphics submission
+	if (completed)
+		updateView(texture);
+	if (texture.residentLevel == 0)
+	{
+		texture.state = State::Resident;
+		// Evicted textures stream back from here, the mapping is still open
+		texture.rowsUploaded = 0;
+	}
+}
+
+void TextureStreamer::updateView(Texture& texture)
+{
+	// Frames in flight may still sample the old view through its slot, so both are retired instead of rewritten
+	deletions->destroy(texture.view);
+	if (texture.bindlessIndex != UINT32_MAX)
+		bindless->remove(BindlessType::SampledImage, texture.bindlessIndex);
+
+	auto viewInfo = vk::ImageViewCreateInfo()
+		.setImage(texture.image)
+		.setViewType(vk::ImageViewType::e2D)
+		.setFormat(texture.format)
+		.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor,
+			texture.residentLevel, texture.mipCount - texture.residentLevel, 0, 1));
+
+	texture.view = device.createImageView(viewInfo);
+	texture.bindlessIndex = bindless->addImage(texture.view);
+}
+
+void TextureStreamer::retire(Texture& texture)
+{
+	if (texture.bindlessIndex != UINT32_MAX)
+		bindless->remove(BindlessType::SampledImage, texture.bindlessIndex);
+	deletions->destroy(texture.view);
+	deletions->destroy(texture.image);
+	deletions->free(texture.allocation);
+	resident -= texture.allocation.size;
+
+	texture.view = VK_NULL_HANDLE;
+	texture.image = VK_NULL_HANDLE;
+	texture.allocation = MemoryAllocation();
+	texture.bindlessIndex = UINT32_MAX;
+	texture.mipCount = 0;
+	texture.residentLevel = 0;
+	texture.rowsUploaded = 0;
+}
+
+void TextureStreamer::recordMipGeneration(vk::CommandBuffer commandBuffer)
+{
+	for (auto handle : mipQueue)
+	{
+		auto& texture = *textures[handle];
+		// Evicted in the same frame; its image is kept alive but nothing will sample it
+		if (!texture.image)
+			continue;
+
+		auto levelRange = [](uint32_t level, uint32_t count)
+		{
+			return vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, count, 0, 1);
+		};
+
+		// Level 0 arrives in transfer src layout from the upload
+		auto barrier = vk::ImageMemoryBarrier()
+			.setSrcAccessMask(vk::AccessFlags())
+			.setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setOldLayout(vk::ImageLayout::eUndefined)
+			.setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setImage(texture.image)
+			.setSubresourceRange(levelRange(1, texture.mipCount - 1));
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+			vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+		int32_t width = static_cast<int32_t>(texture.levels[0].width);
+		int32_t height = static_cast<int32_t>(texture.levels[0].height);
+		for (uint32_t level = 1; level < texture.mipCount; level++)
+		{
+			int32_t levelWidth = std::max(1, width / 2);
+			int32_t levelHeight = std::max(1, height / 2);
+
+			auto blit = vk::ImageBlit()
+				.setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, 1))
+				.setSrcOffsets({ { vk::Offset3D(0, 0, 0), vk::Offset3D(width, height, 1) } })
+				.setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1))
+				.setDstOffsets({ { vk::Offset3D(0, 0, 0), vk::Offset3D(levelWidth, levelHeight, 1) } });
+
+			commandBuffer.blitImage(texture.image, vk::ImageLayout::eTransferSrcOptimal,
+				texture.image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+				.setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+				.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+				.setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+				.setSubresourceRange(levelRange(level, 1));
+
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+				vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+			width = levelWidth;
+			height = levelHeight;
+		}
+
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
+			.setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+			.setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+			.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+			.setSubresourceRange(levelRange(0, texture.mipCount));
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader,
+			vk::DependencyFlags(), nullptr, nullptr, barrier);
+	}
+	mipQueue.clear();
+}
+
+void TextureStreamer::printStats() const
+{
+	uint32_t residentCount = 0;
+	for (const auto& texture : textures)
+	{
+		if (texture->state == State::Resident)
+			residentCount++;
+	}
+
+	std::cout << "[Textures] " << residentCount << " of " << textures.size() << " resident, "
+		<< (resident >> 10) << " KiB of " << (budget >> 10) << " KiB budget"
+		<< ", streamed: " << (streamedBytes >> 10) << " KiB, evictions: " << evictions << "\n";
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "Descriptors.h"
+#include "MappedFile.h"
+#include "MemoryAllocator.h"
+#include "ThreadPool.h"
+#include "UploadManager.h"
+
+using TextureHandle = uint32_t;
+const TextureHandle INVALID_TEXTURE = UINT32_MAX;
+
+// Streams 2D textures into device-local images under a memory budget.
+// KTX2 files (uncompressed, BCn or ASTC, no supercompression) are memory-mapped and paged in on a loader
+// thread, coarsest level first. Levels are then copied through the upload staging ring, also coarsest
+// first and in row chunks sized to the staging left each frame, so a texture is usable at low resolution
+// right away and sharpens as the finer levels land. Sources without a mip chain get theirs generated on
+// the GPU with blits. When a texture would exceed the budget, textures unused for a few frames are evicted
+// and stream back in when used again; if that is not enough its finest levels are left out.
+class TextureStreamer
+{
+public:
+	void init(vk::Device device, vk::PhysicalDevice physicalDevice, MemoryAllocator& allocator, UploadManager& uploader,
+		BindlessDescriptors& bindless, DeletionQueue& deletions, uint32_t framesInFlight, vk::DeviceSize budget);
+	void destroy();
+
+	// The file is opened and paged in on the loader thread, streaming starts once the texture is used
+	TextureHandle load(const std::string& filename);
+	// Tightly packed uncompressed pixels, copied; streams right away and gets its mips generated on the GPU
+	TextureHandle create(uint32_t width, uint32_t height, vk::Format format, const void* pixels, vk::DeviceSize size);
+	// Stands in for textures that have no resident level yet
+	void setFallback(TextureHandle texture) { fallback = texture; }
+
+	// Bindless image index covering the texture's resident levels, or the fallback's.
+	// Marks the texture as used this frame. Call after update(), not from recording jobs.
+	uint32_t use(TextureHandle texture);
+
+	// Between UploadManager::beginFrame and flush: evicts over budget and streams as many levels
+	// as this frame's remaining staging holds
+	void update();
+	// Into the graphics primary after UploadManager::recordAcquire, before anything samples textures
+	void recordMipGeneration(vk::CommandBuffer commandBuffer);
+
+	vk::DeviceSize residentBytes() const { return resident; }
+	void printStats() const;
+
+private:
+	enum class State
+	{
+		Loading,
+		Ready,
+		Streaming,
+		Resident,
+		Failed
+	};
+
+	struct Level
+	{
+		const uint8_t* data = nullptr;
+		vk::DeviceSize size = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	struct Texture
+	{
+		std::string name;
+		std::atomic<State> state{ State::Loading };
+
+		// Written by the loader before state leaves Loading
+		MappedFile file;
+		std::vector<uint8_t> pixels;
+		vk::Format format = vk::Format::eUndefined;
+		uint32_t blockWidth = 1;
+		uint32_t blockHeight = 1;
+		uint32_t blockBytes = 4;
+		// Source levels, finest first; a single one when mips are generated
+		std::vector<Level> levels;
+		bool generateMips = false;
+		// Source levels from the coarsest end that are paged in and safe to copy without blocking on I/O
+		std::atomic<uint32_t> pagedLevels{ 0 };
+
+		// Image level i holds source level baseLevel + i; levels below residentLevel are still missing
+		vk::Image image;
+		MemoryAllocation allocation;
+		vk::ImageView view;
+		uint32_t bindlessIndex = UINT32_MAX;
+		uint32_t mipCount = 0;
+		uint32_t baseLevel = 0;
+		uint32_t residentLevel = 0;
+		uint32_t rowsUploaded = 0;
+
+		uint64_t lastUsed = 0;
+		bool queued = false;
+	};
+
+	void loadFile(Texture& texture);
+	bool setFormat(Texture& texture, vk::Format format);
+	bool startStreaming(Texture& texture);
+	bool evictOne(const Texture& keep);
+	void streamLevels(TextureHandle handle);
+	void updateView(Texture& texture);
+	void retire(Texture& texture);
+
+private:
+	vk::Device device;
+	vk::PhysicalDevice physicalDevice;
+	MemoryAllocator* allocator = nullptr;
+	UploadManager* uploader = nullptr;
+	BindlessDescriptors* bindless = nullptr;
+	DeletionQueue* deletions = nullptr;
+	uint32_t framesInFlight = 1;
+	vk::DeviceSize budget = 0;
+	vk::DeviceSize resident = 0;
+	uint64_t frame = 0;
+
+	std::vector<std::unique_ptr<Texture>> textures;
+	std::vector<TextureHandle> streamQueue;
+	std::vector<TextureHandle> mipQueue;
+	TextureHandle fallback = INVALID_TEXTURE;
+	std::unique_ptr<ThreadPool> loader;
+	// Files still queued when shutting down are skipped rather than paged in
+	std::atomic<bool> stopping{ false };
+
+	uint32_t evictions = 0;
+	vk::DeviceSize streamedBytes = 0;
+};
@@ -0,0 +1,77 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (uint32_t i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back([task = std::move(task)](uint32_t) { task(); });
+	}
+	condition.notify_one();
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+	uint32_t remaining = count;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			tasks.push_back([&, i](uint32_t worker)
+			{
+				job(i, worker);
+				std::lock_guard<std::mutex> doneLock(doneMutex);
+				if (--remaining == 0)
+					doneCondition.notify_one();
+			});
+		}
+	}
+	condition.notify_all();
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	doneCondition.wait(lock, [&]() { return remaining == 0; });
+}
+
+void ThreadPool::workerLoop(uint32_t worker)
+{
+	while (true)
+	{
+		std::function<void(uint32_t)> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task(worker);
+	}
+}
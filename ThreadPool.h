@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// threadCount of 0 uses one thread per hardware thread
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	uint32_t size() const { return static_cast<uint32_t>(workers.size()); }
+
+	void enqueue(std::function<void()> task);
+	// Runs job(i, worker) for every i in [0, count) across the workers and returns once all of them finished.
+	// worker is the index in [0, size()) of the thread running it, for state each thread keeps to itself.
+	void parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& job);
+
+private:
+	void workerLoop(uint32_t worker);
+
+private:
+	std::vector<std::thread> workers;
+	// Each task gets the index of the worker running it
+	std::deque<std::function<void(uint32_t)>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+};
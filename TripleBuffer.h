@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the latest value from one producer thread to one consumer thread. The producer fills
+// back() and publishes it; acquire() swaps the newest published value into front(), which then stays put until
+// the next acquire, so the consumer reads it in place. Values published between two acquires are replaced, not queued.
+template <typename T>
+class TripleBuffer
+{
+public:
+	// Producer side; the slot holds stale contents and has to be written in full
+	T& back() { return slots[backIndex]; }
+	void publish()
+	{
+		// The fresh bit tells the consumer the middle slot holds a value it has not seen
+		backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Consumer side; false when nothing new was published, front() is then unchanged
+	bool acquire()
+	{
+		if (!(middle.load(std::memory_order_acquire) & FRESH))
+			return false;
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+	const T& front() const { return slots[frontIndex]; }
+
+private:
+	static constexpr uint32_t INDEX = 3;
+	static constexpr uint32_t FRESH = 4;
+
+	T slots[3];
+	// Each side owns one slot, the third is exchanged through here
+	alignas(64) std::atomic<uint32_t> middle{ 1 };
+	alignas(64) uint32_t backIndex = 0;
+	alignas(64) uint32_t frontIndex = 2;
+};
@@ -0,0 +1,283 @@
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cstring>
+
+const vk::DeviceSize STAGING_COPY_ALIGNMENT = 16;
+
+void UploadManager::init(vk::Device device, MemoryAllocator& allocator, vk::Queue queue, uint32_t queueFamily, uint32_t ownerFamily,
+	uint32_t framesInFlight, vk::DeviceSize stagingSize)
+{
+	this->device = device;
+	this->allocator = &allocator;
+	this->queue = queue;
+	this->queueFamily = queueFamily;
+	this->ownerFamily = ownerFamily;
+
+	staging.init(allocator, device, stagingSize, framesInFlight, vk::BufferUsageFlagBits::eTransferSrc);
+
+	auto commandPoolInfo = vk::CommandPoolCreateInfo()
+		.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+		.setQueueFamilyIndex(queueFamily);
+
+	for (uint32_t i = 0; i < framesInFlight; i++)
+	{
+		FrameResources frame;
+		frame.commandPool = device.createCommandPool(commandPoolInfo);
+
+		auto allocInfo = vk::CommandBufferAllocateInfo()
+			.setCommandPool(frame.commandPool)
+			.setLevel(vk::CommandBufferLevel::ePrimary)
+			.setCommandBufferCount(1);
+
+		frame.commandBuffer = device.allocateCommandBuffers(allocInfo)[0];
+		frame.semaphore = device.createSemaphore(vk::SemaphoreCreateInfo());
+		frames.push_back(frame);
+	}
+}
+
+void UploadManager::destroy(DeletionQueue& deletions)
+{
+	for (auto& frame : frames)
+	{
+		deletions.destroy(frame.semaphore);
+		deletions.destroy(frame.commandPool);
+	}
+	frames.clear();
+	staging.destroy(deletions);
+	pending.clear();
+}
+
+void UploadManager::uploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size,
+	std::shared_ptr<const void> keepAlive, bool concurrent)
+{
+	if (size == 0)
+		return;
+
+	PendingUpload upload = { dst, dstOffset, static_cast<const char*>(data), size, 0, keepAlive, concurrent };
+
+	// Copy straight into staging when possible, the caller's memory is then free to go immediately
+	if (frameOpen && pending.empty())
+	{
+		auto range = staging.allocate(size, STAGING_COPY_ALIGNMENT);
+		if (range.buffer)
+		{
+			std::memcpy(range.mapped, data, size);
+			copies.push_back({ dst, vk::BufferCopy(range.offset, dstOffset, size), concurrent });
+			return;
+		}
+	}
+
+	if (!keepAlive)
+	{
+		auto owned = std::make_shared<std::vector<char>>(upload.data, upload.data + size);
+		upload.data = owned->data();
+		upload.keepAlive = owned;
+	}
+	pending.push_back(upload);
+	pendingBytes += size;
+}
+
+bool UploadManager::uploadImage(const ImageRegion& region, const void* data, vk::DeviceSize size)
+{
+	if (!frameOpen || size > imageStagingAvailable())
+		return false;
+
+	auto range = staging.allocate(size, STAGING_COPY_ALIGNMENT);
+	if (!range.buffer)
+		return false;
+
+	std::memcpy(range.mapped, data, size);
+	imageCopies.push_back({ region, range.offset });
+	return true;
+}
+
+vk::DeviceSize UploadManager::imageStagingAvailable() const
+{
+	auto reserved = pendingBytes + STAGING_COPY_ALIGNMENT;
+	auto remaining = staging.remaining();
+	return remaining > reserved ? remaining - reserved : 0;
+}
+
+void UploadManager::beginFrame(uint32_t frameSlot)
+{
+	this->frameSlot = frameSlot;
+	staging.beginFrame(frameSlot);
+	device.resetCommandPool(frames[frameSlot].commandPool, vk::CommandPoolResetFlags());
+	frameOpen = true;
+}
+
+bool UploadManager::flush(std::vector<SemaphoreWait>& waits, vk::PipelineStageFlags waitStages)
+{
+	frameOpen = false;
+
+	while (!pending.empty())
+	{
+		auto& upload = pending.front();
+
+		auto available = staging.remaining();
+		if (available <= STAGING_COPY_ALIGNMENT)
+			break;
+
+		auto chunk = std::min(upload.size - upload.consumed, available - STAGING_COPY_ALIGNMENT);
+		auto range = staging.allocate(chunk, STAGING_COPY_ALIGNMENT);
+		if (!range.buffer)
+			break;
+
+		std::memcpy(range.mapped, upload.data + upload.consumed, chunk);
+		copies.push_back({ upload.dst, vk::BufferCopy(range.offset, upload.dstOffset + upload.consumed, chunk), upload.concurrent });
+
+		upload.consumed += chunk;
+		pendingBytes -= chunk;
+		if (upload.consumed == upload.size)
+			pending.pop_front();
+	}
+
+	if (copies.empty() && imageCopies.empty())
+		return false;
+
+	staging.flush(device);
+
+	auto& frame = frames[frameSlot];
+	auto beginInfo = vk::CommandBufferBeginInfo()
+		.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+	frame.commandBuffer.begin(beginInfo);
+
+	auto levelRange = [](const ImageRegion& region)
+	{
+		return vk::ImageSubresourceRange(region.aspect, region.mipLevel, 1, 0, 1);
+	};
+
+	std::vector<vk::ImageMemoryBarrier> transferBarriers;
+	for (const auto& copy : imageCopies)
+	{
+		if (!copy.region.first)
+			continue;
+
+		transferBarriers.push_back(vk::ImageMemoryBarrier()
+			.setSrcAccessMask(vk::AccessFlags())
+			.setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setOldLayout(vk::ImageLayout::eUndefined)
+			.setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+			.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+			.setImage(copy.region.image)
+			.setSubresourceRange(levelRange(copy.region)));
+	}
+	if (!transferBarriers.empty())
+	{
+		frame.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+			vk::DependencyFlags(), nullptr, nullptr, transferBarriers);
+	}
+
+	std::vector<vk::BufferCopy> regions;
+	for (size_t i = 0; i < copies.size(); i++)
+	{
+		regions.push_back(copies[i].region);
+		if (i + 1 == copies.size() || copies[i + 1].dst != copies[i].dst)
+		{
+			frame.commandBuffer.copyBuffer(staging.handle(), copies[i].dst, regions);
+			regions.clear();
+		}
+	}
+
+	for (const auto& copy : imageCopies)
+	{
+		auto imageCopy = vk::BufferImageCopy()
+			.setBufferOffset(copy.stagingOffset)
+			.setImageSubresource(vk::ImageSubresourceLayers(copy.region.aspect, copy.region.mipLevel, 0, 1))
+			.setImageOffset(copy.region.offset)
+			.setImageExtent(copy.region.extent);
+
+		frame.commandBuffer.copyBufferToImage(staging.handle(), copy.region.image, vk::ImageLayout::eTransferDstOptimal, imageCopy);
+	}
+
+	// Completed levels move to their final layout; the semaphore orders everything after that for the consumer
+	std::vector<vk::ImageMemoryBarrier> imageReleaseBarriers;
+	for (const auto& copy : imageCopies)
+	{
+		if (!copy.region.last)
+			continue;
+
+		bool transfer = queueFamily != ownerFamily;
+		auto barrier = vk::ImageMemoryBarrier()
+			.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setDstAccessMask(vk::AccessFlags())
+			.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+			.setNewLayout(copy.region.finalLayout)
+			.setSrcQueueFamilyIndex(transfer ? queueFamily : VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex(transfer ? ownerFamily : VK_QUEUE_FAMILY_IGNORED)
+			.setImage(copy.region.image)
+			.setSubresourceRange(levelRange(copy.region));
+		imageReleaseBarriers.push_back(barrier);
+
+		if (transfer)
+		{
+			barrier.setSrcAccessMask(vk::AccessFlags())
+				.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead);
+			imageAcquireBarriers.push_back(barrier);
+		}
+	}
+	imageCopies.clear();
+
+	// Exclusive buffers written from another family have to be released here and acquired by the owner
+	std::vector<vk::BufferMemoryBarrier> releaseBarriers;
+	if (queueFamily != ownerFamily)
+	{
+		for (const auto& copy : copies)
+		{
+			if (copy.concurrent)
+				continue;
+
+			auto barrier = vk::BufferMemoryBarrier()
+				.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+				.setDstAccessMask(vk::AccessFlags())
+				.setSrcQueueFamilyIndex(queueFamily)
+				.setDstQueueFamilyIndex(ownerFamily)
+				.setBuffer(copy.dst)
+				.setOffset(copy.region.dstOffset)
+				.setSize(copy.region.size);
+			releaseBarriers.push_back(barrier);
+
+			// The destination may be read in any way by the owner, so the acquire covers all of them
+			barrier.setSrcAccessMask(vk::AccessFlags())
+				.setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead |
+					vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead);
+			acquireBarriers.push_back(barrier);
+		}
+	}
+	if (!releaseBarriers.empty() || !imageReleaseBarriers.empty())
+	{
+		frame.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+			vk::DependencyFlags(), nullptr, releaseBarriers, imageReleaseBarriers);
+	}
+
+	frame.commandBuffer.end();
+	copies.clear();
+
+	auto submitInfo = vk::SubmitInfo()
+		.setCommandBufferCount(1)
+		.setPCommandBuffers(&frame.commandBuffer)
+		.setSignalSemaphoreCount(1)
+		.setPSignalSemaphores(&frame.semaphore);
+
+	queue.submit(1, &submitInfo, VK_NULL_HANDLE);
+
+	waits.push_back({ frame.semaphore, 0, waitStages });
+	return true;
+}
+
+void UploadManager::recordAcquire(vk::CommandBuffer commandBuffer)
+{
+	if (acquireBarriers.empty() && imageAcquireBarriers.empty())
+		return;
+
+	// The source scope has to take in the stages the submission's semaphore wait blocks, or the acquire and layout
+	// transition are not ordered after the copies. Those differ with async culling, so every stage is taken.
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+		vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader |
+		vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+		vk::DependencyFlags(), nullptr, acquireBarriers, imageAcquireBarriers);
+	acquireBarriers.clear();
+	imageAcquireBarriers.clear();
+}
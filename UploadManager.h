@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "MemoryAllocator.h"
+#include "Sync.h"
+
+// Streams data into device-local buffers through a persistently mapped staging ring.
+// All copies queued during a frame go out in a single submission that signals a semaphore
+// the frame's graphics submission waits on. Uploads that don't fit into the frame's staging
+// segment continue in the following frames.
+// When the copies run on a dedicated transfer family, exclusive destination buffers are released
+// to the owner family in the copy submission and acquired again through recordAcquire.
+class UploadManager
+{
+public:
+	// One chunk of an image mip level. The first chunk moves the level from undefined to transfer dst,
+	// the last one to finalLayout, handing it to the owner family on the way when that differs.
+	struct ImageRegion
+	{
+		vk::Image image;
+		vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+		uint32_t mipLevel = 0;
+		vk::Offset3D offset;
+		vk::Extent3D extent;
+		bool first = true;
+		bool last = true;
+		vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	};
+
+	void init(vk::Device device, MemoryAllocator& allocator, vk::Queue queue, uint32_t queueFamily, uint32_t ownerFamily,
+		uint32_t framesInFlight, vk::DeviceSize stagingSize);
+	void destroy(DeletionQueue& deletions);
+
+	// The source is copied when the upload has to be deferred, unless keepAlive owns it.
+	// Buffers created with concurrent sharing need no ownership transfer and pass concurrent = true.
+	void uploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size,
+		std::shared_ptr<const void> keepAlive = nullptr, bool concurrent = false);
+
+	// Only between beginFrame and flush, and never deferred: returns false when the data doesn't fit into
+	// this frame's staging, the caller then retries with a smaller region or in a later frame
+	bool uploadImage(const ImageRegion& region, const void* data, vk::DeviceSize size);
+	// Staging still free this frame once pending buffer uploads are accounted for
+	vk::DeviceSize imageStagingAvailable() const;
+
+	// Call once the frame slot's previous submission has completed
+	void beginFrame(uint32_t frameSlot);
+	// Submits this frame's copies and appends the semaphore the consumer has to wait on at waitStages
+	bool flush(std::vector<SemaphoreWait>& waits, vk::PipelineStageFlags waitStages);
+	// Records the owner-side half of this frame's ownership transfers, into a submission that waits on the flush
+	void recordAcquire(vk::CommandBuffer commandBuffer);
+
+	bool idle() const { return pending.empty(); }
+	vk::DeviceSize bytesInFlight() const { return pendingBytes; }
+
+private:
+	struct PendingUpload
+	{
+		vk::Buffer dst;
+		vk::DeviceSize dstOffset;
+		const char* data;
+		vk::DeviceSize size;
+		vk::DeviceSize consumed;
+		std::shared_ptr<const void> keepAlive;
+		bool concurrent;
+	};
+
+	struct StagedCopy
+	{
+		vk::Buffer dst;
+		vk::BufferCopy region;
+		bool concurrent;
+	};
+
+	struct StagedImageCopy
+	{
+		ImageRegion region;
+		vk::DeviceSize stagingOffset;
+	};
+
+	struct FrameResources
+	{
+		vk::CommandPool commandPool;
+		vk::CommandBuffer commandBuffer;
+		vk::Semaphore semaphore;
+	};
+
+private:
+	vk::Device device;
+	MemoryAllocator* allocator = nullptr;
+	vk::Queue queue;
+	uint32_t queueFamily = 0;
+	uint32_t ownerFamily = 0;
+
+	BufferRing staging;
+	std::vector<FrameResources> frames;
+	uint32_t frameSlot = 0;
+	// Staging space may only be handed out between beginFrame and flush
+	bool frameOpen = false;
+
+	std::deque<PendingUpload> pending;
+	vk::DeviceSize pendingBytes = 0;
+	std::vector<StagedCopy> copies;
+	std::vector<StagedImageCopy> imageCopies;
+	std::vector<vk::BufferMemoryBarrier> acquireBarriers;
+	std::vector<vk::ImageMemoryBarrier> imageAcquireBarriers;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <array>
+
+struct Vertex
+{
+	glm::vec2 pos;
+	glm::vec3 color;
+
+	static vk::VertexInputBindingDescription bindingDescription()
+	{
+		return vk::VertexInputBindingDescription()
+			.setBinding(0)
+			.setStride(sizeof(Vertex))
+			.setInputRate(vk::VertexInputRate::eVertex);
+	}
+
+	static std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions()
+	{
+		return
+		{
+			vk::VertexInputAttributeDescription()
+				.setLocation(0)
+				.setBinding(0)
+				.setFormat(vk::Format::eR32G32Sfloat)
+				.setOffset(offsetof(Vertex, pos)),
+			vk::VertexInputAttributeDescription()
+				.setLocation(1)
+				.setBinding(0)
+				.setFormat(vk::Format::eR32G32B32Sfloat)
+				.setOffset(offsetof(Vertex, color))
+		};
+	}
+};
@@ -0,0 +1,264 @@
+#include "Window.h"
+
+#include <algorithm>
+#include <iostream>
+
+void Window::create(const std::string& title, int width, int height, RefreshFunction refresh)
+{
+	this->title = title;
+	this->refresh = std::move(refresh);
+
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+	handle = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+	if (!handle)
+		throw std::runtime_error("[Error] Failed to create window " + title);
+
+	int framebufferSize[2] = {};
+	glfwGetFramebufferSize(handle, &framebufferSize[0], &framebufferSize[1]);
+	framebufferWidth = framebufferSize[0];
+	framebufferHeight = framebufferSize[1];
+
+	glfwSetWindowUserPointer(handle, this);
+	glfwSetFramebufferSizeCallback(handle, [](GLFWwindow* handle, int width, int height)
+	{
+		auto window = static_cast<Window*>(glfwGetWindowUserPointer(handle));
+		window->framebufferWidth = width;
+		window->framebufferHeight = height;
+		window->swapchainOutOfDate = true;
+	});
+	// Some platforms block in glfwPollEvents for the whole of a live resize, keep drawing from the refresh callback
+	glfwSetWindowRefreshCallback(handle, [](GLFWwindow* handle)
+	{
+		auto window = static_cast<Window*>(glfwGetWindowUserPointer(handle));
+		if (window->refresh)
+			window->refresh();
+	});
+}
+
+void Window::createSurface(vk::Instance instance)
+{
+	if (glfwCreateWindowSurface((VkInstance)instance, handle, nullptr, (VkSurfaceKHR*)&windowSurface) != VK_SUCCESS)
+	{
+		throw std::runtime_error("[Error] Failed to create window surface");
+	}
+}
+
+void Window::init(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t graphicsFamily, uint32_t presentFamily,
+	uint32_t framesInFlight, vk::PresentModeKHR requestedMode, vk::ImageUsageFlags extraUsage, vk::Format requiredFormat)
+{
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	queueFamilyIndices[0] = graphicsFamily;
+	queueFamilyIndices[1] = presentFamily;
+	this->requestedMode = requestedMode;
+	requestedUsage = vk::ImageUsageFlagBits::eColorAttachment | extraUsage;
+	this->requiredFormat = requiredFormat;
+
+	// The present family was picked for the first window's surface, the others have to be reachable from it too
+	if (!physicalDevice.getSurfaceSupportKHR(presentFamily, windowSurface))
+		throw std::runtime_error("[Error] " + title + " cannot be presented from queue family " + std::to_string(presentFamily));
+
+	createSwapchain(VK_NULL_HANDLE);
+	createImageViews();
+
+	for (uint32_t i = 0; i < framesInFlight; i++)
+		imageAvailableSemaphores.push_back(device.createSemaphore(vk::SemaphoreCreateInfo()));
+	for (size_t i = 0; i < images.size(); i++)
+		renderFinishedSemaphores.push_back(device.createSemaphore(vk::SemaphoreCreateInfo()));
+	imageFrameValues.assign(images.size(), 0);
+}
+
+void Window::retire(DeletionQueue& deletions)
+{
+	for (auto semaphore : renderFinishedSemaphores)
+		deletions.destroy(semaphore);
+	for (auto semaphore : imageAvailableSemaphores)
+		deletions.destroy(semaphore);
+	for (auto imageView : imageViews)
+		deletions.destroy(imageView);
+	deletions.destroy(windowSwapchain);
+	renderFinishedSemaphores.clear();
+	imageAvailableSemaphores.clear();
+	imageViews.clear();
+	windowSwapchain = VK_NULL_HANDLE;
+}
+
+void Window::destroy(vk::Instance instance)
+{
+	if (windowSurface)
+		instance.destroySurfaceKHR(windowSurface);
+	windowSurface = VK_NULL_HANDLE;
+	if (handle)
+		glfwDestroyWindow(handle);
+	handle = nullptr;
+}
+
+bool Window::recreate(DeletionQueue& deletions)
+{
+	if (minimized())
+		return false;
+
+	// Frames still in flight keep using the old objects; the queue releases them once those frames have completed.
+	// The surface format does not depend on the extent, so the graph's render passes and the pipelines remain compatible.
+	for (auto imageView : imageViews)
+		deletions.destroy(imageView);
+	for (auto semaphore : renderFinishedSemaphores)
+		deletions.destroy(semaphore);
+	imageViews.clear();
+	renderFinishedSemaphores.clear();
+
+	auto oldSwapchain = windowSwapchain;
+	createSwapchain(oldSwapchain);
+	deletions.destroy(oldSwapchain);
+	createImageViews();
+
+	for (size_t i = 0; i < images.size(); i++)
+		renderFinishedSemaphores.push_back(device.createSemaphore(vk::SemaphoreCreateInfo()));
+	imageFrameValues.assign(images.size(), 0);
+
+	swapchainOutOfDate = false;
+	return true;
+}
+
+bool Window::acquire(uint32_t frameSlot)
+{
+	if (swapchainOutOfDate || minimized())
+		return false;
+
+	try
+	{
+		auto acquired = device.acquireNextImageKHR(windowSwapchain, UINT64_MAX, imageAvailableSemaphores[frameSlot], VK_NULL_HANDLE);
+		imageIndex = acquired.value;
+		// A suboptimal image was still acquired and its semaphore signaled, so this frame goes ahead
+		if (acquired.result == vk::Result::eSuboptimalKHR)
+			swapchainOutOfDate = true;
+	}
+	catch (const vk::OutOfDateKHRError&)
+	{
+		swapchainOutOfDate = true;
+		return false;
+	}
+	return true;
+}
+
+void Window::presented(vk::Result result)
+{
+	if (result == vk::Result::eSuboptimalKHR || result == vk::Result::eErrorOutOfDateKHR)
+		swapchainOutOfDate = true;
+}
+
+void Window::createSwapchain(vk::SwapchainKHR oldSwapchain)
+{
+	auto capabilities = physicalDevice.getSurfaceCapabilitiesKHR(windowSurface);
+	auto formats = physicalDevice.getSurfaceFormatsKHR(windowSurface);
+	auto presentModes = physicalDevice.getSurfacePresentModesKHR(windowSurface);
+
+	auto surfaceFormat = selectSurfaceFormat(formats);
+	mode = selectPresentMode(presentModes);
+	auto extent = selectExtent(capabilities);
+
+	uint32_t imageCount = capabilities.minImageCount + 1;
+	if (capabilities.maxImageCount > 0)
+		imageCount = std::min(imageCount, capabilities.maxImageCount);
+
+	// Anything beyond rendering, such as capture copies, is only an extra; usage() tells what was granted
+	imageUsage = requestedUsage & capabilities.supportedUsageFlags;
+
+	bool identical = (queueFamilyIndices[0] == queueFamilyIndices[1]);
+
+	auto createInfo = vk::SwapchainCreateInfoKHR()
+		.setSurface(windowSurface)
+		.setMinImageCount(imageCount)
+		.setImageFormat(surfaceFormat.format)
+		.setImageColorSpace(surfaceFormat.colorSpace)
+		.setImageExtent(extent)
+		.setImageArrayLayers(1)
+		.setImageUsage(imageUsage)
+		.setImageSharingMode(identical ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent)
+		.setQueueFamilyIndexCount(identical ? 0 : 2)
+		.setPQueueFamilyIndices(identical ? nullptr : queueFamilyIndices)
+		.setPreTransform(capabilities.currentTransform)
+		.setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
+		.setPresentMode(mode)
+		.setClipped(VK_TRUE)
+		.setOldSwapchain(oldSwapchain);
+
+	windowSwapchain = device.createSwapchainKHR(createInfo);
+	imageFormat = surfaceFormat.format;
+	imageExtent = extent;
+	images = device.getSwapchainImagesKHR(windowSwapchain);
+}
+
+void Window::createImageViews()
+{
+	auto subresourceRange = vk::ImageSubresourceRange()
+		.setAspectMask(vk::ImageAspectFlagBits::eColor)
+		.setBaseMipLevel(0)
+		.setLevelCount(1)
+		.setBaseArrayLayer(0)
+		.setLayerCount(1);
+
+	for (const auto& image : images)
+	{
+		auto createInfo = vk::ImageViewCreateInfo()
+			.setImage(image)
+			.setViewType(vk::ImageViewType::e2D)
+			.setFormat(imageFormat)
+			.setSubresourceRange(subresourceRange);
+
+		imageViews.push_back(device.createImageView(createInfo));
+	}
+}
+
+vk::SurfaceFormatKHR Window::selectSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& formats)
+{
+	// Windows after the first render through the same render passes and pipelines, so their format is fixed
+	if (requiredFormat != vk::Format::eUndefined)
+	{
+		for (const auto& format : formats)
+		{
+			if (format.format == requiredFormat)
+				return format;
+		}
+		throw std::runtime_error("[Error] " + title + " does not support " + vk::to_string(requiredFormat) + ", the format of the first window");
+	}
+
+	for (const auto& format : formats)
+	{
+		if (format.format == vk::Format::eB8G8R8A8Srgb && format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)
+			return format;
+	}
+	return formats[0];
+}
+
+vk::PresentModeKHR Window::selectPresentMode(const std::vector<vk::PresentModeKHR>& modes)
+{
+	if (std::find(modes.begin(), modes.end(), requestedMode) != modes.end())
+		return requestedMode;
+
+	// Only warn once, this runs again on every swapchain recreation
+	if (!presentModeWarned)
+		std::cout << "[Warning] Present mode " << vk::to_string(requestedMode) << " is not supported by " << title << ", falling back to FIFO\n";
+	presentModeWarned = true;
+	return vk::PresentModeKHR::eFifo;
+}
+
+vk::Extent2D Window::selectExtent(const vk::SurfaceCapabilitiesKHR& capabilities)
+{
+	if (capabilities.currentExtent.width != UINT32_MAX)
+		return capabilities.currentExtent;
+
+	auto actualExtent = vk::Extent2D()
+		.setWidth(static_cast<uint32_t>(framebufferWidth.load()))
+		.setHeight(static_cast<uint32_t>(framebufferHeight.load()));
+
+	actualExtent.width = std::max(
+		capabilities.minImageExtent.width,
+		std::min(capabilities.maxImageExtent.width, actualExtent.width));
+	actualExtent.height = std::max(
+		capabilities.minImageExtent.height,
+		std::min(capabilities.maxImageExtent.height, actualExtent.height));
+
+	return actualExtent;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "DeletionQueue.h"
+
+// One GLFW window with its surface, swapchain and presentation semaphores. Windows share the device, and
+// every window's image is rendered in the same submission and presented by one batched vkQueuePresentKHR,
+// so only acquiring, recording the scene pass and the swapchain itself scale with the number of windows.
+// GLFW calls stay on the main thread; everything after create() may run on the render thread.
+class Window
+{
+public:
+	// Called from the refresh callback, so rendering continues while the window is being resized
+	using RefreshFunction = std::function<void()>;
+
+	void create(const std::string& title, int width, int height, RefreshFunction refresh);
+	void createSurface(vk::Instance instance);
+	// Picks requiredFormat if set, or the preferred sRGB format. Extra usage the surface does not support is
+	// dropped, usage() tells what was granted.
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, uint32_t graphicsFamily, uint32_t presentFamily,
+		uint32_t framesInFlight, vk::PresentModeKHR requestedMode, vk::ImageUsageFlags extraUsage, vk::Format requiredFormat = vk::Format::eUndefined);
+	// Queues the swapchain with its views and semaphores for the owner's final flush
+	void retire(DeletionQueue& deletions);
+	// After that flush: the surface and the window itself
+	void destroy(vk::Instance instance);
+
+	// Replaces the swapchain; the old one goes to the deletion queue, frames in flight may still present from it.
+	// Returns false while the window is minimized.
+	bool recreate(DeletionQueue& deletions);
+
+	// False when nothing was acquired: minimized, or out of date and waiting to be recreated
+	bool acquire(uint32_t frameSlot);
+	// Call after the submission that signals renderFinished(); the image is in use until frameValue completes
+	void submitted(uint64_t frameValue) { imageFrameValues[imageIndex] = frameValue; }
+	void presented(vk::Result result);
+
+	// Main thread only, unlike the state queries below
+	bool shouldClose() const { return glfwWindowShouldClose(handle); }
+	bool minimized() const { return framebufferWidth == 0 || framebufferHeight == 0; }
+	bool outOfDate() const { return swapchainOutOfDate; }
+	void invalidate() { swapchainOutOfDate = true; }
+
+	vk::SurfaceKHR surface() const { return windowSurface; }
+	vk::SwapchainKHR swapchain() const { return windowSwapchain; }
+	vk::Format format() const { return imageFormat; }
+	vk::Extent2D extent() const { return imageExtent; }
+	vk::ImageUsageFlags usage() const { return imageUsage; }
+	vk::PresentModeKHR presentMode() const { return mode; }
+
+	// Of the image acquired this frame
+	uint32_t acquiredImage() const { return imageIndex; }
+	vk::Image image() const { return images[imageIndex]; }
+	vk::ImageView imageView() const { return imageViews[imageIndex]; }
+	uint64_t imageFrameValue() const { return imageFrameValues[imageIndex]; }
+	vk::Semaphore imageAvailable(uint32_t frameSlot) const { return imageAvailableSemaphores[frameSlot]; }
+	vk::Semaphore renderFinished() const { return renderFinishedSemaphores[imageIndex]; }
+
+private:
+	void createSwapchain(vk::SwapchainKHR oldSwapchain);
+	void createImageViews();
+	vk::SurfaceFormatKHR selectSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& formats);
+	vk::PresentModeKHR selectPresentMode(const std::vector<vk::PresentModeKHR>& modes);
+	vk::Extent2D selectExtent(const vk::SurfaceCapabilitiesKHR& capabilities);
+
+private:
+	std::string title;
+	GLFWwindow* handle = nullptr;
+	RefreshFunction refresh;
+
+	vk::PhysicalDevice physicalDevice;
+	vk::Device device;
+	uint32_t queueFamilyIndices[2] = {};
+	vk::PresentModeKHR requestedMode = vk::PresentModeKHR::eFifo;
+	vk::ImageUsageFlags requestedUsage;
+	vk::Format requiredFormat = vk::Format::eUndefined;
+	bool presentModeWarned = false;
+
+	vk::SurfaceKHR windowSurface;
+	vk::SwapchainKHR windowSwapchain;
+	vk::Format imageFormat = vk::Format::eUndefined;
+	vk::Extent2D imageExtent;
+	vk::ImageUsageFlags imageUsage;
+	vk::PresentModeKHR mode = vk::PresentModeKHR::eFifo;
+	std::vector<vk::Image> images;
+	std::vector<vk::ImageView> imageViews;
+	// Set on resize, out-of-date or suboptimal; the swapchain is rebuilt before the next acquire
+	std::atomic<bool> swapchainOutOfDate{ false };
+	// Kept by the framebuffer size callback, glfwGetFramebufferSize may only be called on the main thread
+	std::atomic<int> framebufferWidth{ 0 };
+	std::atomic<int> framebufferHeight{ 0 };
+
+	// Acquire semaphores are per frame slot; a present-wait semaphore can only be reused once its image is
+	// acquired again, so those are per image
+	std::vector<vk::Semaphore> imageAvailableSemaphores;
+	std::vector<vk::Semaphore> renderFinishedSemaphores;
+	std::vector<uint64_t> imageFrameValues;
+	uint32_t imageIndex = 0;
+};
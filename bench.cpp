@@ -0,0 +1,272 @@
+#include "Application.h"
+
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+
+// Renders a fixed set of scenes offscreen and writes their timings as JSON. With a baseline written by an
+// earlier run, every metric that got worse by more than the threshold is reported and the exit code is 1.
+
+struct BenchScene
+{
+	std::string name;
+	uint32_t triangles;
+	uint32_t draws;
+	uint32_t instances;
+	uint32_t framesInFlight;
+	// Bloom, exposure and tonemapping after the scene pass
+	bool postProcess = false;
+};
+
+struct BenchResult
+{
+	BenchScene scene;
+	FrameReport report;
+	bool failed = false;
+};
+
+// How a metric regresses; differences below noiseFloor are never reported
+struct BenchMetric
+{
+	const char* key;
+	bool higherIsBetter;
+	double noiseFloor;
+};
+
+const std::vector<BenchScene> defaultScenes =
+{
+	{ "minimal", 0, 1, 0, 2 },
+	{ "triangles-64k", 65536, 4, 0, 2 },
+	{ "draws-10k", 0, 10000, 0, 2 },
+	{ "draws-10k-fif1", 0, 10000, 0, 1 },
+	{ "draws-10k-fif3", 0, 10000, 0, 3 },
+	{ "instances-100k", 0, 1, 100000, 2 },
+	{ "instances-100k-triangles-256", 256, 1, 100000, 2 },
+	{ "postprocess", 0, 1, 0, 2, true }
+};
+
+const BenchMetric benchMetrics[] =
+{
+	{ "fps", true, 0.0 },
+	{ "cpuMsPerFrame", false, 0.01 },
+	{ "recordNsPerDraw", false, 1.0 },
+	{ "submitMs", false, 0.01 },
+	{ "presentMs", false, 0.01 },
+	{ "peakDeviceBytes", false, 0.0 }
+};
+
+static std::map<std::string, double> metricsOf(const FrameReport& report)
+{
+	return
+	{
+		{ "fps", report.framesPerSecond },
+		{ "cpuMsPerFrame", report.cpuMsPerFrame },
+		{ "gpuMsPerFrame", report.gpuMsPerFrame },
+		{ "recordNsPerDraw", report.recordNsPerDraw },
+		{ "submitMs", report.submitMs },
+		{ "presentMs", report.presentMs },
+		{ "peakDeviceBytes", static_cast<double>(report.peakDeviceBytes) }
+	};
+}
+
+static void writeJson(std::ostream& out, const std::vector<BenchResult>& results, uint32_t frames)
+{
+	// Enough digits that byte counts survive the round trip through a baseline
+	auto precision = out.precision(15);
+	out << "{\n\t\"frames\": " << frames << ",\n\t\"scenes\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const auto& result = results[i];
+		out << "\t\t{ \"name\": \"" << result.scene.name << "\""
+			<< ", \"triangles\": " << result.scene.triangles
+			<< ", \"draws\": " << result.scene.draws
+			<< ", \"instances\": " << result.scene.instances
+			<< ", \"framesInFlight\": " << result.scene.framesInFlight
+			<< ", \"postProcess\": " << (result.scene.postProcess ? 1 : 0);
+		if (result.failed)
+			out << ", \"failed\": true";
+		else
+		{
+			for (const auto& metric : metricsOf(result.report))
+				out << ", \"" << metric.first << "\": " << metric.second;
+		}
+		out << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "\t]\n}\n";
+	out.precision(precision);
+}
+
+// Only reads back what writeJson produces: flat scene objects of named numbers
+static std::map<std::string, std::map<std::string, double>> readBaseline(const std::string& filename)
+{
+	std::map<std::string, std::map<std::string, double>> baseline;
+	std::ifstream file(filename);
+	if (!file)
+		return baseline;
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	std::string text = contents.str();
+
+	std::regex objectPattern("\\{[^{}]*\"name\"\\s*:\\s*\"([^\"]+)\"[^{}]*\\}");
+	std::regex numberPattern("\"(\\w+)\"\\s*:\\s*(-?[0-9][0-9.eE+-]*)");
+	for (auto it = std::sregex_iterator(text.begin(), text.end(), objectPattern); it != std::sregex_iterator(); ++it)
+	{
+		std::string object = (*it)[0];
+		auto& metrics = baseline[(*it)[1]];
+		for (auto number = std::sregex_iterator(object.begin(), object.end(), numberPattern); number != std::sregex_iterator(); ++number)
+			metrics[(*number)[1]] = std::stod((*number)[2]);
+	}
+	return baseline;
+}
+
+static uint32_t compare(const std::vector<BenchResult>& results, const std::map<std::string, std::map<std::string, double>>& baseline,
+	double threshold)
+{
+	uint32_t regressions = 0;
+	for (const auto& result : results)
+	{
+		auto base = baseline.find(result.scene.name);
+		if (base == baseline.end())
+		{
+			std::cout << "[Bench] " << result.scene.name << ": no baseline\n";
+			continue;
+		}
+		if (result.failed)
+		{
+			std::cout << "[Bench] REGRESSION " << result.scene.name << ": failed to run\n";
+			regressions++;
+			continue;
+		}
+
+		auto current = metricsOf(result.report);
+		for (const auto& metric : benchMetrics)
+		{
+			auto previous = base->second.find(metric.key);
+			if (previous == base->second.end())
+				continue;
+
+			double before = previous->second;
+			double after = current[metric.key];
+			double change = before != 0.0 ? (after - before) / before : 0.0;
+			bool worse = metric.higherIsBetter ? change < -threshold : change > threshold;
+			if (!worse || std::abs(after - before) <= metric.noiseFloor)
+				continue;
+
+			std::cout << "[Bench] REGRESSION " << result.scene.name << " " << metric.key << ": " << before << " -> " << after
+				<< " (" << (change > 0.0 ? "+" : "") << change * 100.0 << "%)\n";
+			regressions++;
+		}
+	}
+	return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+	AppOptions base;
+	base.headless = true;
+	base.headlessFrames = 300;
+	// Software drivers give stable numbers on any machine, pass --device to measure real hardware
+	base.devicePreference = "cpu";
+	base.deviceCachePath = "";
+
+	std::vector<BenchScene> scenes = defaultScenes;
+	std::vector<std::string> filter;
+	std::string outputPath = "bench_results.json";
+	std::string baselinePath;
+	double threshold = 0.10;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--frames" && i + 1 < argc)
+			base.headlessFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg == "--device" && i + 1 < argc)
+			base.devicePreference = argv[++i];
+		else if (arg == "--scene" && i + 1 < argc)
+			filter.push_back(argv[++i]);
+		else if (arg == "--output" && i + 1 < argc)
+			outputPath = argv[++i];
+		else if (arg == "--baseline" && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (arg == "--threshold" && i + 1 < argc)
+			threshold = std::stod(argv[++i]) / 100.0;
+		// --custom <triangles> <draws> <instances> <frames in flight> runs that scene alone
+		else if (arg == "--custom" && i + 4 < argc)
+		{
+			BenchScene scene;
+			scene.triangles = static_cast<uint32_t>(std::stoul(argv[++i]));
+			scene.draws = static_cast<uint32_t>(std::stoul(argv[++i]));
+			scene.instances = static_cast<uint32_t>(std::stoul(argv[++i]));
+			scene.framesInFlight = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+			scene.name = "custom-" + std::to_string(scene.triangles) + "-" + std::to_string(scene.draws) + "-" +
+				std::to_string(scene.instances) + "-" + std::to_string(scene.framesInFlight);
+			scenes = { scene };
+		}
+		else
+		{
+			std::cout << "Usage: " << argv[0] << " [--frames N] [--device cpu|index|name] [--scene name]... [--custom T D I F]\n"
+				<< "\t[--output results.json] [--baseline baseline.json] [--threshold percent]\n";
+			return 2;
+		}
+	}
+
+	if (!filter.empty())
+	{
+		scenes.erase(std::remove_if(scenes.begin(), scenes.end(), [&](const BenchScene& scene)
+		{
+			return std::find(filter.begin(), filter.end(), scene.name) == filter.end();
+		}), scenes.end());
+	}
+
+	std::vector<BenchResult> results;
+	for (const auto& scene : scenes)
+	{
+		std::cout << "[Bench] " << scene.name << ": " << scene.triangles << " triangles, " << scene.draws << " draws, "
+			<< scene.instances << " instances, " << scene.framesInFlight << " frames in flight"
+			<< (scene.postProcess ? ", post-processed" : "") << "\n";
+
+		auto options = base;
+		options.meshTriangles = scene.triangles;
+		options.drawCount = scene.draws;
+		options.instanceCount = scene.instances;
+		options.framesInFlight = scene.framesInFlight;
+		options.postProcess = scene.postProcess;
+
+		BenchResult result;
+		result.scene = scene;
+		try
+		{
+			Application app("Vulkan-Try bench", 1280, 720, options);
+			result.failed = app.run() != 0;
+			result.report = app.report();
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << "[Error] " << scene.name << ": " << e.what() << "\n";
+			result.failed = true;
+		}
+		results.push_back(result);
+	}
+
+	std::ofstream output(outputPath);
+	writeJson(output, results, base.headlessFrames);
+	writeJson(std::cout, results, base.headlessFrames);
+	std::cout << "[Bench] Wrote " << results.size() << " scenes to " << outputPath << "\n";
+
+	bool failed = std::any_of(results.begin(), results.end(), [](const BenchResult& result) { return result.failed; });
+	if (!baselinePath.empty())
+	{
+		auto baseline = readBaseline(baselinePath);
+		if (baseline.empty())
+		{
+			std::cout << "[Error] No baseline scenes in " << baselinePath << "\n";
+			return 1;
+		}
+		uint32_t regressions = compare(results, baseline, threshold);
+		std::cout << "[Bench] " << regressions << " regressions beyond " << threshold * 100.0 << "% against " << baselinePath << "\n";
+		failed = failed || regressions > 0;
+	}
+	return failed ? 1 : 0;
+}
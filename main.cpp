@@ -1,7 +1,97 @@
 #include "Application.h"
+#include "ShaderArchive.h"
 
-int main()
+#include <algorithm>
+#include <cstring>
+
+int main(int argc, char* argv[])
 {
-    Application app("Vulkan-Try", 1280, 720);
+    // --pack-shaders <archive> <spv>... builds a shader archive and exits
+    if (argc >= 3 && !std::strcmp(argv[1], "--pack-shaders"))
+    {
+        std::vector<std::string> inputs(argv + 3, argv + argc);
+        return ShaderArchive::pack(argv[2], inputs) ? 0 : 1;
+    }
+
+    AppOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--headless"))
+            options.headless = true;
+        else if (!std::strcmp(argv[i], "--frames") && i + 1 < argc)
+            options.headlessFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (!std::strcmp(argv[i], "--device") && i + 1 < argc)
+            options.devicePreference = argv[++i];
+        else if (!std::strcmp(argv[i], "--device-cache") && i + 1 < argc)
+            options.deviceCachePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--frames-in-flight") && i + 1 < argc)
+            options.framesInFlight = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        else if (!std::strcmp(argv[i], "--pipeline-cache") && i + 1 < argc)
+            options.pipelineCachePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--materials") && i + 1 < argc)
+            options.materialCount = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        else if (!std::strcmp(argv[i], "--compile-threads") && i + 1 < argc)
+            options.compileThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (!std::strcmp(argv[i], "--shader-archive") && i + 1 < argc)
+            options.shaderArchivePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--texture") && i + 1 < argc)
+            options.texturePaths.push_back(argv[++i]);
+        else if (!std::strcmp(argv[i], "--texture-budget") && i + 1 < argc)
+            options.textureBudget = static_cast<vk::DeviceSize>(std::stoull(argv[++i])) << 20;
+        else if (!std::strcmp(argv[i], "--draws") && i + 1 < argc)
+            options.drawCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (!std::strcmp(argv[i], "--triangles") && i + 1 < argc)
+            options.meshTriangles = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (!std::strcmp(argv[i], "--mesh") && i + 1 < argc)
+            options.meshPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--record-threads") && i + 1 < argc)
+            options.recordThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (!std::strcmp(argv[i], "--instances") && i + 1 < argc)
+            options.instanceCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (!std::strcmp(argv[i], "--no-async-compute"))
+            options.asyncCompute = false;
+        else if (!std::strcmp(argv[i], "--no-transfer-queue"))
+            options.dedicatedTransfer = false;
+        else if (!std::strcmp(argv[i], "--windows") && i + 1 < argc)
+            options.windowCount = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        else if (!std::strcmp(argv[i], "--no-render-thread"))
+            options.renderThread = false;
+        else if (!std::strcmp(argv[i], "--no-post-process"))
+            options.postProcess = false;
+        else if (!std::strcmp(argv[i], "--no-tiled-downsample"))
+            options.tiledDownsample = false;
+        else if (!std::strcmp(argv[i], "--sim-rate") && i + 1 < argc)
+            options.simulationRate = std::stod(argv[++i]);
+        else if (!std::strcmp(argv[i], "--present") && i + 1 < argc)
+        {
+            std::string policy = argv[++i];
+            if (policy == "immediate")
+                options.presentPolicy = PresentPolicy::Immediate;
+            else if (policy == "mailbox")
+                options.presentPolicy = PresentPolicy::Mailbox;
+            else if (policy == "fifo")
+                options.presentPolicy = PresentPolicy::Fifo;
+            else if (policy == "fifo-relaxed")
+                options.presentPolicy = PresentPolicy::FifoRelaxed;
+            else
+                std::cout << "[Warning] Unknown present policy " << policy << ", expected immediate, mailbox, fifo or fifo-relaxed\n";
+        }
+        else if (!std::strcmp(argv[i], "--pacing"))
+            options.framePacing = true;
+        else if (!std::strcmp(argv[i], "--pacing-margin") && i + 1 < argc)
+            options.pacingMarginMs = std::stod(argv[++i]);
+        else if (!std::strcmp(argv[i], "--no-profiling"))
+            options.profiling = false;
+        else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc)
+            options.traceOutput = argv[++i];
+        else if (!std::strcmp(argv[i], "--csv") && i + 1 < argc)
+            options.csvOutput = argv[++i];
+        else if (!std::strcmp(argv[i], "--capture") && i + 1 < argc)
+            options.captureDirectory = argv[++i];
+        else if (!std::strcmp(argv[i], "--capture-raw"))
+            options.captureFormat = CaptureFormat::Raw;
+    }
+
+    Application app("Vulkan-Try", 1280, 720, options);
     return app.run();
-}
\ No newline at end of file
+}
@@ -0,0 +1,47 @@
+#include "MeshCooker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Cooks Wavefront OBJ files into the binary mesh format the application maps with --mesh
+int main(int argc, char* argv[])
+{
+	std::string output;
+	std::vector<std::string> inputs;
+	uint32_t cacheSize = 16;
+	bool usage = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!std::strcmp(argv[i], "-o") && i + 1 < argc)
+			output = argv[++i];
+		else if (!std::strcmp(argv[i], "--cache-size") && i + 1 < argc)
+			cacheSize = std::max(3u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		else if (argv[i][0] != '-')
+			inputs.push_back(argv[i]);
+		else
+			usage = true;
+	}
+
+	if (usage || output.empty() || inputs.empty())
+	{
+		std::cout << "Usage: " << argv[0] << " -o output.vkm [--cache-size entries] input.obj...\n";
+		return 2;
+	}
+
+	MeshCooker cooker;
+	cooker.setCacheSize(cacheSize);
+	for (const auto& input : inputs)
+	{
+		if (!cooker.loadObj(input))
+			return 1;
+	}
+	if (!cooker.write(output))
+		return 1;
+
+	cooker.printStats();
+	std::cout << "[MeshCook] Wrote " << output << "\n";
+	return 0;
+}
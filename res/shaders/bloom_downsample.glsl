@@ -0,0 +1,59 @@
+// Bloom downsample, built with TILED defined for the shared-memory variant and without it for four bilinear
+// fetches per pixel; only the tiled module declares shared memory.
+
+#include "postprocess.glsl"
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 1, rgba16f) uniform writeonly image2D destination;
+
+#ifdef TILED
+// An 8x8 tile of output pixels reads 16x16 source texels plus a one texel border
+const int TILE = 18;
+shared vec3 tile[TILE][TILE];
+#endif
+
+// Each output pixel averages the 4x4 source texels around its 2x2 footprint with weights 1 3 3 1 per axis.
+// The first level also cuts everything below the threshold, only what is left blooms.
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	vec3 color = vec3(0.0);
+
+#ifdef TILED
+	ivec2 origin = ivec2(gl_WorkGroupID.xy) * 16 - 1;
+	for (uint i = gl_LocalInvocationIndex; i < TILE * TILE; i += 64)
+	{
+		ivec2 texel = clamp(origin + ivec2(i % TILE, i / TILE), ivec2(0), sourceSize - 1);
+		tile[i / TILE][i % TILE] = texelFetch(source, texel, 0).rgb;
+	}
+	barrier();
+
+	const float weights[4] = float[](1.0, 3.0, 3.0, 1.0);
+	ivec2 base = ivec2(gl_LocalInvocationID.xy) * 2;
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+			color += tile[base.y + y][base.x + x] * (weights[x] * weights[y]);
+	}
+	color /= 64.0;
+#else
+	// Each fetch lands between a pair of texels weighted 1 and 3 and covers a quarter of the kernel
+	vec2 center = vec2(pixel * 2);
+	color += sampleSource(center + vec2(0.25, 0.25));
+	color += sampleSource(center + vec2(1.75, 0.25));
+	color += sampleSource(center + vec2(0.25, 1.75));
+	color += sampleSource(center + vec2(1.75, 1.75));
+	color *= 0.25;
+#endif
+
+	if (any(greaterThanEqual(pixel, size)))
+		return;
+
+	if (parameter >= 0.0)
+	{
+		float brightness = max(color.r, max(color.g, color.b));
+		color *= max(brightness - parameter, 0.0) / max(brightness, 1e-4);
+	}
+	imageStore(destination, pixel, vec4(color, 1.0));
+}
@@ -0,0 +1,73 @@
+// Averages the histogram into the adapted scene luminance and clears the bins for the next frame.
+// One group of 128 invocations, each owning two bins.
+
+#include "postprocess.glsl"
+
+layout(local_size_x = 128) in;
+
+// Middle grey the average is exposed to, and how fast the eye adapts per second
+const float KEY_VALUE = 0.18;
+const float ADAPTATION_RATE = 1.5;
+
+shared float weightedSums[128];
+shared float counts[128];
+
+void main()
+{
+	uint index = gl_LocalInvocationIndex;
+	uint low = bins[index];
+	uint high = bins[index + 128];
+	bins[index] = 0;
+	bins[index + 128] = 0;
+
+	// Black pixels count for neither the sum nor the pixel count
+	float weighted = float(low) * float(index) + float(high) * float(index + 128);
+	float count = float(index == 0 ? 0 : low) + float(high);
+
+#ifdef SUBGROUP_ARITHMETIC
+	weighted = subgroupAdd(weighted);
+	count = subgroupAdd(count);
+	if (subgroupElect())
+	{
+		weightedSums[gl_SubgroupID] = weighted;
+		counts[gl_SubgroupID] = count;
+	}
+	barrier();
+	if (index != 0)
+		return;
+	for (uint i = 1; i < gl_NumSubgroups; i++)
+	{
+		weighted += weightedSums[i];
+		count += counts[i];
+	}
+#else
+	weightedSums[index] = weighted;
+	counts[index] = count;
+	barrier();
+	for (uint stride = 64; stride > 0; stride /= 2)
+	{
+		if (index < stride)
+		{
+			weightedSums[index] += weightedSums[index + stride];
+			counts[index] += counts[index + stride];
+		}
+		barrier();
+	}
+	if (index != 0)
+		return;
+	weighted = weightedSums[0];
+	count = counts[0];
+#endif
+
+	if (count == 0.0)
+		return;
+	float averageBin = weighted / count;
+	float target = exp2((averageBin - 1.0) / 254.0 * LOG_LUMINANCE_RANGE + MIN_LOG_LUMINANCE);
+
+	// The buffer starts out zeroed, the first frame takes the measured value as is
+	float adapted = averageLuminance > 0.0
+		? averageLuminance + (target - averageLuminance) * (1.0 - exp(-parameter * ADAPTATION_RATE))
+		: target;
+	averageLuminance = adapted;
+	exposure = KEY_VALUE / max(adapted, 1e-4);
+}
@@ -1,23 +1,26 @@
 #version 450
 
-layout(location = 0) out vec3 color;
+layout(location = 0) in vec2 inPos;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec4 instancePositionScale;
+layout(location = 3) in vec4 instanceColor;
 
-vec3 colors[3] = vec3[]
-(
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
-);
+layout(set = 1, binding = 0) uniform FrameConstants
+{
+	mat4 viewProj;
+} frame;
 
-vec2 pos[3] = vec2[]
-(
-	vec2(0.0, -0.5),
-	vec2(0.5, 0.5),
-	vec2(-0.5, 0.5)
-);
+// Bound with a dynamic offset per draw
+layout(set = 1, binding = 1) uniform ObjectConstants
+{
+	mat4 model;
+} object;
+
+layout(location = 0) out vec3 color;
 
 void main()
 {
-	color = colors[gl_VertexIndex];
-	gl_Position = vec4(pos[gl_VertexIndex], 0.0, 1.0);
-}
\ No newline at end of file
+	color = inColor * instanceColor.rgb;
+	vec2 pos = (object.model * vec4(inPos, 0.0, 1.0)).xy;
+	gl_Position = frame.viewProj * vec4(pos * instancePositionScale.w + instancePositionScale.xy, instancePositionScale.z, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 1) uniform texture2D textures[];
+layout(set = 0, binding = 2) uniform sampler samplers[];
+
+layout(push_constant) uniform DrawConstants
+{
+	uint materialBuffer;
+	uint material;
+	uint textureIndex;
+	uint samplerIndex;
+} draw;
+
+layout(location = 0) in vec3 color;
+layout(location = 1) in vec2 uv;
+
+layout(location = 0) out vec4 FragColor;
+
+void main()
+{
+	vec4 texel = texture(sampler2D(textures[draw.textureIndex], samplers[draw.samplerIndex]), uv);
+	FragColor = vec4(color * texel.rgb, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 inPos;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec4 instancePositionScale;
+layout(location = 3) in vec4 instanceColor;
+
+// Every storage buffer of the bindless set aliases this declaration, the draw picks one by index
+layout(std430, set = 0, binding = 0) readonly buffer Materials
+{
+	vec4 tint[];
+} materials[];
+
+layout(set = 1, binding = 0) uniform FrameConstants
+{
+	mat4 viewProj;
+} frame;
+
+// Bound with a dynamic offset per draw
+layout(set = 1, binding = 1) uniform ObjectConstants
+{
+	mat4 model;
+} object;
+
+layout(push_constant) uniform DrawConstants
+{
+	uint materialBuffer;
+	uint material;
+	uint textureIndex;
+	uint samplerIndex;
+} draw;
+
+layout(location = 0) out vec3 color;
+layout(location = 1) out vec2 uv;
+
+void main()
+{
+	uv = inPos * 0.5 + 0.5;
+	color = inColor * instanceColor.rgb * materials[draw.materialBuffer].tint[draw.material].rgb;
+	vec2 pos = (object.model * vec4(inPos, 0.0, 1.0)).xy;
+	gl_Position = frame.viewProj * vec4(pos * instancePositionScale.w + instancePositionScale.xy, instancePositionScale.z, 1.0);
+}
@@ -0,0 +1,35 @@
+// Shared by the post-processing stages, which all use one descriptor set layout and push constant block
+
+layout(set = 0, binding = 0) uniform sampler2D source;
+layout(std430, set = 0, binding = 2) buffer Luminance
+{
+	uint bins[256];
+	float averageLuminance;
+	float exposure;
+};
+
+layout(push_constant) uniform PostParams
+{
+	// Region written, or read by the histogram; the images may be larger when targets differ in size
+	ivec2 size;
+	// Region of the source image the stage reads from
+	ivec2 sourceSize;
+	// Bloom threshold, frame time or bloom intensity, depending on the stage
+	float parameter;
+};
+
+// Log2 luminance range covered by bins 1 to 255, bin 0 holds black pixels
+const float MIN_LOG_LUMINANCE = -10.0;
+const float LOG_LUMINANCE_RANGE = 12.0;
+
+float luminance(vec3 color)
+{
+	return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Bilinear fetch at a position in source texels, kept inside the source region
+vec3 sampleSource(vec2 position)
+{
+	position = clamp(position, vec2(0.5), vec2(sourceSize) - 0.5);
+	return textureLod(source, position / vec2(textureSize(source, 0)), 0.0).rgb;
+}